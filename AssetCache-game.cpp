@@ -0,0 +1,50 @@
+//AssetCache getters for the game's own asset types (kept separate so the show-* tools can link AssetCache without them):
+
+#include "AssetCache.hpp"
+
+#include "BoneAnimation.hpp"
+#include "Sound.hpp"
+#include "WalkMesh.hpp"
+
+static void release_bone_animation(BoneAnimation &animation) {
+	glDeleteBuffers(1, &animation.buffer);
+	animation.buffer = 0;
+}
+
+std::shared_ptr< BoneAnimation const > AssetCache::bone_animation(std::string const &filename) {
+	return get< BoneAnimation >("banims", filename, [](std::string const &path) {
+		return new BoneAnimation(path);
+	}, [](BoneAnimation const &animation) {
+		return gl_buffer_bytes(animation.buffer)
+			+ animation.bones.size() * sizeof(BoneAnimation::Bone)
+			+ animation.frame_bones.size() * sizeof(BoneAnimation::PoseBone);
+	}, release_bone_animation);
+}
+
+GLuint AssetCache::vao_for_program(std::shared_ptr< BoneAnimation const > const &animation, GLuint program) {
+	return vao_for_program(animation.get(), program, [&]() { return animation->make_vao_for_program(program); });
+}
+
+std::shared_ptr< WalkMeshes const > AssetCache::walkmeshes(std::string const &filename) {
+	return get< WalkMeshes >("walkmesh", filename, [](std::string const &path) {
+		return new WalkMeshes(path);
+	}, [](WalkMeshes const &walkmeshes_) {
+		size_t total = 0;
+		for (auto const &nm : walkmeshes_.meshes) {
+			WalkMesh const &mesh = nm.second;
+			total += mesh.vertices.size() * sizeof(glm::vec3)
+				+ mesh.normals.size() * sizeof(glm::vec3)
+				+ mesh.triangles.size() * sizeof(glm::uvec3)
+				+ mesh.next_vertex.size() * (sizeof(glm::uvec2) + sizeof(uint32_t));
+		}
+		return total;
+	});
+}
+
+std::shared_ptr< Sound::Sample const > AssetCache::sample(std::string const &filename) {
+	return get< Sound::Sample >("sample", filename, [](std::string const &path) {
+		return new Sound::Sample(path);
+	}, [](Sound::Sample const &sample_) {
+		return sample_.data.size() * sizeof(float);
+	});
+}
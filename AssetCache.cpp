@@ -0,0 +1,145 @@
+#include "AssetCache.hpp"
+
+#include "Mesh.hpp"
+#include "MeshArena.hpp"
+#include "TextRendering.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+AssetCache assets;
+
+AssetCache::AssetCache() : entries(std::make_shared< Entries >()) {
+}
+
+std::string AssetCache::canonical_path(std::string const &filename) {
+	std::error_code ec;
+	std::filesystem::path path = std::filesystem::weakly_canonical(filename, ec);
+	if (ec) return filename; //(the load will report the problem)
+	return path.string();
+}
+
+bool AssetCache::gl_alive() {
+	return SDL_GL_GetCurrentContext() != nullptr;
+}
+
+void AssetCache::release_gl(std::vector< GLuint > const &vaos) {
+	if (vaos.empty() || !gl_alive()) return;
+	glDeleteVertexArrays(GLsizei(vaos.size()), vaos.data());
+}
+
+size_t AssetCache::gl_buffer_bytes(GLuint buffer) {
+	if (buffer == 0) return 0;
+	GLint size = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	return size_t(size);
+}
+
+//-------------------------
+
+static void release_meshes(MeshBuffer &meshes) {
+	meshes.free_buffers();
+}
+
+static size_t meshes_bytes(MeshBuffer const &meshes) {
+	size_t gl_bytes;
+	if (meshes.in_arena()) {
+		//(just this buffer's part of its arena block)
+		gl_bytes = size_t(meshes.arena.vertex_count) * size_t(meshes.Position.stride) + size_t(meshes.arena.index_units) * MeshArena::IndexAlign;
+	} else {
+		gl_bytes = AssetCache::gl_buffer_bytes(meshes.buffer) + AssetCache::gl_buffer_bytes(meshes.index_buffer);
+	}
+	return gl_bytes + meshes.meshes.size() * sizeof(std::map< std::string, Mesh >::value_type);
+}
+
+std::shared_ptr< MeshBuffer const > AssetCache::meshes(std::string const &filename) {
+	return get< MeshBuffer >("meshes", filename, [](std::string const &path) {
+		return new MeshBuffer(path);
+	}, meshes_bytes, release_meshes);
+}
+
+std::shared_ptr< MeshBuffer const > AssetCache::find_meshes(std::string const &filename) const {
+	return find< MeshBuffer >(key("meshes", canonical_path(filename)));
+}
+
+std::shared_ptr< MeshBuffer const > AssetCache::add_meshes(std::string const &filename, std::unique_ptr< MeshBuffer > &&buffer) {
+	std::string path = canonical_path(filename);
+	std::string k = key("meshes", path);
+	if (std::shared_ptr< MeshBuffer > found = find< MeshBuffer >(k)) {
+		//(loaded twice, e.g. once directly and once through MeshLoader; keep the first)
+		release_meshes(*buffer);
+		return found;
+	}
+	return add< MeshBuffer >("meshes", path, k, buffer.release(), meshes_bytes, release_meshes);
+}
+
+//-------------------------
+
+static void release_font(TextRenderer &font) {
+	for (auto const &ch : font.Characters) {
+		glDeleteTextures(1, &ch.second.TextureID);
+	}
+	font.Characters.clear();
+}
+
+std::shared_ptr< TextRenderer > AssetCache::font(std::string const &filename, uint32_t size) {
+	std::string path = canonical_path(filename);
+	std::string sized = path + " @" + std::to_string(size);
+	std::string k = key("font", sized);
+	if (std::shared_ptr< TextRenderer > found = find< TextRenderer >(k)) return found;
+	return add< TextRenderer >("font", sized, k, new TextRenderer(path, size), [](TextRenderer const &font) {
+		//glyph textures are one byte per pixel:
+		size_t total = 0;
+		for (auto const &ch : font.Characters) {
+			total += size_t(ch.second.Size.x) * size_t(ch.second.Size.y);
+		}
+		return total;
+	}, release_font);
+}
+
+//-------------------------
+
+GLuint AssetCache::vao_for_program(void const *asset, GLuint program, std::function< GLuint() > const &make) {
+	auto f = std::find_if(entries->begin(), entries->end(), [asset](Entries::value_type const &kv) {
+		return kv.second.asset.lock().get() == asset;
+	});
+	if (f == entries->end()) {
+		throw std::runtime_error("vao_for_program() called with an asset that isn't in the cache.");
+	}
+	for (auto const &pv : f->second.vaos) {
+		if (pv.first == program) return pv.second;
+	}
+	GLuint vao = make();
+	f->second.vaos.emplace_back(program, vao);
+	return vao;
+}
+
+GLuint AssetCache::vao_for_program(std::shared_ptr< MeshBuffer const > const &meshes_, GLuint program) {
+	//(arena buffers share -- and so don't own -- their block's vertex arrays)
+	if (meshes_->in_arena()) return meshes_->make_vao_for_program(program);
+	return vao_for_program(meshes_.get(), program, [&]() { return meshes_->make_vao_for_program(program); });
+}
+
+//-------------------------
+
+void AssetCache::report(std::ostream &out) const {
+	size_t total = 0;
+	for (auto const &kv : *entries) {
+		Entry const &entry = kv.second;
+		long handles = entry.asset.use_count();
+		if (handles == 0) continue;
+		size_t bytes = entry.bytes();
+		total += bytes;
+		out << std::setw(8) << entry.type << " x" << handles << " " << std::setw(10) << bytes << " bytes  " << entry.path;
+		if (!entry.vaos.empty()) out << " (" << entry.vaos.size() << " vertex arrays)";
+		out << '\n';
+	}
+	out << "Total: " << total << " bytes in " << entries->size() << " assets";
+	out << " (mesh arena: " << mesh_arena.used_bytes() << " of " << mesh_arena.capacity_bytes() << " bytes in use)." << std::endl;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+/*
+ * AssetCache shares loaded assets between everything that uses them, so
+ *  that (e.g.) WormMode and TutorialMode don't each load -- and upload --
+ *  their own copy of the same animation file.
+ *
+ * Assets are keyed by type and canonical path (so "dist/../dist/blob.banims"
+ *  and "dist/blob.banims" are one asset) and handed out as std::shared_ptr
+ *  handles. An asset stays loaded while any handle to it is held; dropping
+ *  the last handle frees it, along with its OpenGL objects and any vertex
+ *  arrays made for it with vao_for_program(). Asking again later loads the
+ *  file again.
+ *
+ *   std::shared_ptr< BoneAnimation const > blob_banims;
+ *   GLuint blob_banims_vao = 0;
+ *   Load< void > load_blob_banims(LoadTagDefault, [](){
+ *       blob_banims = assets.bone_animation(data_path("blob.banims"));
+ *       blob_banims_vao = assets.vao_for_program(blob_banims, bone_lit_color_texture_program->program);
+ *   });
+ *
+ * Mesh files loaded in the background by MeshLoader end up here too, so a
+ *  file queued by two modes is only read once.
+ *
+ * report() lists each asset with its handle count and (estimated) bytes of
+ *  CPU and GPU memory; F4 prints it (see main.cpp).
+ *
+ * Use from the main (GL) thread only.
+ *
+ */
+
+#include "GL.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct MeshBuffer;
+struct BoneAnimation;
+struct WalkMeshes;
+class TextRenderer;
+namespace Sound {
+	struct Sample;
+}
+
+struct AssetCache {
+	AssetCache();
+
+	//get a handle to an asset, loading it if it isn't already loaded:
+	// note: will throw if the file fails to load.
+	std::shared_ptr< MeshBuffer const > meshes(std::string const &filename);
+	std::shared_ptr< BoneAnimation const > bone_animation(std::string const &filename);
+	std::shared_ptr< WalkMeshes const > walkmeshes(std::string const &filename);
+	//(Sound::play() doesn't hold a handle, so keep one for as long as the sample may be playing)
+	std::shared_ptr< Sound::Sample const > sample(std::string const &filename);
+	//(fonts are shared per size; drawing text changes a TextRenderer, so handles aren't const)
+	std::shared_ptr< TextRenderer > font(std::string const &filename, uint32_t size);
+
+	//a vertex array linking a cached asset to a program, made on first request and kept with the asset:
+	GLuint vao_for_program(std::shared_ptr< MeshBuffer const > const &meshes, GLuint program);
+	GLuint vao_for_program(std::shared_ptr< BoneAnimation const > const &animation, GLuint program);
+
+	//for MeshLoader: the cached buffer for a file (or nullptr if it isn't loaded)..
+	std::shared_ptr< MeshBuffer const > find_meshes(std::string const &filename) const;
+	//..and adding a buffer it has loaded (and uploaded):
+	std::shared_ptr< MeshBuffer const > add_meshes(std::string const &filename, std::unique_ptr< MeshBuffer > &&buffer);
+
+	//print one line per asset (type, handles, bytes, path) and the total:
+	// (main.cpp prints this with the render stats dump, on F4)
+	void report(std::ostream &out) const;
+
+	//-- internals --
+	struct Entry {
+		char const *type = "";
+		std::string path;
+		std::weak_ptr< void const > asset;
+		std::function< size_t() > bytes; //(measured when asked, since e.g. fonts grow as glyphs get used)
+		std::vector< std::pair< GLuint, GLuint > > vaos; //(program, vertex array)
+	};
+	using Entries = std::map< std::string, Entry >; //by key()
+	//(shared with handles' deleters, which erase their entry -- unless the cache itself is already gone)
+	std::shared_ptr< Entries > entries;
+
+	static std::string canonical_path(std::string const &filename);
+	static std::string key(char const *type, std::string const &path) { return std::string(type) + ':' + path; }
+
+	//the live handle for a key, if any:
+	template< typename T >
+	std::shared_ptr< T > find(std::string const &k) const {
+		auto f = entries->find(k);
+		if (f == entries->end()) return nullptr;
+		return std::const_pointer_cast< T >(std::static_pointer_cast< T const >(f->second.asset.lock()));
+	}
+
+	//take ownership of a loaded asset; 'release' frees its OpenGL objects (if any) when the last handle goes:
+	template< typename T >
+	std::shared_ptr< T > add(char const *type, std::string const &path, std::string const &k, T *asset,
+		std::function< size_t(T const &) > const &bytes, void (*release)(T &) = nullptr) {
+		std::weak_ptr< Entries > weak_entries = entries;
+		std::shared_ptr< T > handle(asset, [weak_entries, k, release](T *dying) {
+			std::vector< GLuint > vaos;
+			if (std::shared_ptr< Entries > live = weak_entries.lock()) {
+				auto f = live->find(k);
+				if (f != live->end() && f->second.asset.expired()) {
+					for (auto const &pv : f->second.vaos) vaos.emplace_back(pv.second);
+					live->erase(f);
+				}
+			}
+			release_gl(vaos);
+			if (release && gl_alive()) release(*dying);
+			delete dying;
+		});
+		Entry &entry = (*entries)[k];
+		entry.type = type;
+		entry.path = path;
+		entry.asset = handle;
+		entry.bytes = [asset, bytes]() { return bytes(*asset); };
+		entry.vaos.clear();
+		return handle;
+	}
+
+	//find or load:
+	template< typename T >
+	std::shared_ptr< T > get(char const *type, std::string const &filename, std::function< T *(std::string const &) > const &load,
+		std::function< size_t(T const &) > const &bytes, void (*release)(T &) = nullptr) {
+		std::string path = canonical_path(filename);
+		std::string k = key(type, path);
+		if (std::shared_ptr< T > found = find< T >(k)) return found;
+		return add< T >(type, path, k, load(path), bytes, release);
+	}
+
+	GLuint vao_for_program(void const *asset, GLuint program, std::function< GLuint() > const &make);
+
+	//is there a GL context to free things in? (handles held by globals are dropped after it is deleted)
+	static bool gl_alive();
+	static void release_gl(std::vector< GLuint > const &vaos);
+	//bytes in a GL buffer (queried, since MeshBuffer and BoneAnimation free their CPU copies once uploaded):
+	static size_t gl_buffer_bytes(GLuint buffer);
+};
+
+extern AssetCache assets;
@@ -1,5 +1,7 @@
 #include "BoneLitColorTextureProgram.hpp"
 
+#include "LightClusters.hpp"
+#include "UniformBlocks.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -11,9 +13,8 @@ Load< BoneLitColorTextureProgram > bone_lit_color_texture_program(LoadTagEarly,
 	//----- build the pipeline template -----
 	bone_lit_color_texture_program_pipeline.program = ret->program;
 
-	bone_lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	bone_lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	bone_lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//object matrices come from the 'Object' block:
+	bone_lit_color_texture_program_pipeline.Object_block = ret->Object_block;
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -40,9 +41,7 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
+		+ UniformBlocks::ObjectGLSL +
 		"uniform mat4x3 BONES[" + std::to_string(MaxBones) + "];\n"
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
@@ -54,6 +53,7 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 		"out vec3 normal;\n"
 		"out vec4 color;\n"
 		"out vec2 texCoord;\n"
+		"out vec4 clipPosition;\n"
 		"void main() {\n"
 //Considering (just) the Add/Mul counts:
 /*  Variation (1): mul = 4*(12+3) = 60,  add = 4*9 + 3*3 = 45
@@ -85,6 +85,7 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 		"		+ mat3(BONES[BoneIndices.w]) * Normal * BoneWeights.w\n"
 		"		);\n"
 		"	gl_Position = OBJECT_TO_CLIP * vec4(blended_Position, 1.0);\n"
+		"	clipPosition = gl_Position;\n"
 		"	position = OBJECT_TO_LIGHT * vec4(blended_Position, 1.0);\n"
 		"	normal = NORMAL_TO_LIGHT * blended_Normal;\n"
 		"	color = Color;\n"
@@ -94,17 +95,22 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 		//fragment shader:
 		"#version 330\n"
 		"uniform sampler2D TEX;\n"
+		+ UniformBlocks::LightGLSL
+		+ LightClusters::GLSL +
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
 		"in vec2 texCoord;\n"
+		"in vec4 clipPosition;\n"
 		"out vec4 fragColor;\n"
 		"void main() {\n"
 		"	vec3 n = normalize(normal);\n"
-		"	vec3 l = normalize(vec3(0.1, 0.1, 1.0));\n"
+		"	vec3 l = -LIGHT_DIRECTION;\n"
 		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
-		//simple hemispherical lighting model:
-		"	vec3 light = mix(vec3(0.0,0.0,0.1), vec3(1.0,1.0,0.95), dot(n,l)*0.5+0.5);\n"
+		//simple hemispherical lighting model (with a bit of blue ambient) using the frame's light direction and energy:
+		"	vec3 light = mix(vec3(0.0,0.0,0.1), LIGHT_ENERGY, dot(n,l)*0.5+0.5);\n"
+		//plus the scene's own lights:
+		"	light += clustered_lighting(position, n, clipPosition);\n"
 		"	fragColor = vec4(light*albedo.rgb, albedo.a);\n"
 		"}\n"
 	);
@@ -120,13 +126,16 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 	BoneIndices_uvec4 = glGetAttribLocation(program, "BoneIndices");
 
 	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
 	BONES_mat4x3_array = glGetUniformLocation(program, "BONES");
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
+	//look up the indices of uniform blocks, and connect them to their binding points:
+	Light_block = glGetUniformBlockIndex(program, "Light");
+	Object_block = glGetUniformBlockIndex(program, "Object");
+	UniformBlocks::bind_blocks(program);
+	LightClusters::bind_samplers(program);
+
 	//set TEX to always refer to texture binding zero:
 	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
 
@@ -19,11 +19,11 @@ struct BoneLitColorTextureProgram {
 	GLuint BoneWeights_vec4 = -1U;
 	GLuint BoneIndices_uvec4 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
+	//Uniform block indices (see UniformBlocks.hpp):
+	GLuint Light_block = -1U;
+	GLuint Object_block = -1U; //per-object matrices
 
+	//Uniform (per-invocation variable) locations:
 	GLuint BONES_mat4x3_array = -1U;
 
 	enum : uint32_t {
@@ -38,4 +38,5 @@ extern Load< BoneLitColorTextureProgram > bone_lit_color_texture_program;
 
 //For convenient scene-graph setup, copy this object:
 // NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// NOTE: lighting comes from the 'Light' uniform block, so set it with uniform_blocks->set_light().
 extern Scene::Drawable::Pipeline bone_lit_color_texture_program_pipeline;
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "DrawLines.hpp"
 #include "PathFont.hpp"
 #include "ColorProgram.hpp"
+#include "GPUProfiler.hpp"
+#include "RenderStats.hpp"
 
 #include "gl_errors.hpp"
 
@@ -135,6 +137,8 @@ void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor_in, g
 DrawLines::~DrawLines() {
 	if (attribs.empty()) return;
 
+	GPUProfiler::Scope scope("lines");
+
 	//based on DrawSprites.cpp :
 
 	//upload vertices to vertex_buffer:
@@ -154,6 +158,12 @@ DrawLines::~DrawLines() {
 	//run the OpenGL pipeline:
 	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
 
+	//count the work for the performance HUD:
+	render_stats.frame.upload_bytes += attribs.size() * sizeof(attribs[0]);
+	render_stats.frame.program_binds += 1;
+	render_stats.frame.vao_binds += 1;
+	render_stats.frame.draws += 1;
+
 	//reset vertex array to none:
 	glBindVertexArray(0);
 
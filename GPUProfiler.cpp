@@ -0,0 +1,109 @@
+#include "GPUProfiler.hpp"
+
+#include <cstring>
+
+GPUProfiler gpu_profiler;
+
+GPUProfiler::Scope::Scope(char const *name) : marker(gpu_profiler.begin(name)) {
+	if (marker != -1U) start = std::chrono::high_resolution_clock::now();
+}
+
+GPUProfiler::Scope::~Scope() {
+	if (marker == -1U) return;
+	auto now = std::chrono::high_resolution_clock::now();
+	gpu_profiler.end(marker, std::chrono::duration< float, std::milli >(now - start).count());
+}
+
+void GPUProfiler::init() {
+	initialized = true;
+
+	//timer queries are core in 3.3, but the counter may still have no bits:
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	gpu_timing = (bits > 0);
+}
+
+GLuint GPUProfiler::Frame::get_query() {
+	if (used_queries == queries.size()) {
+		queries.emplace_back(0);
+		glGenQueries(1, &queries.back());
+	}
+	return queries[used_queries++];
+}
+
+uint32_t GPUProfiler::begin(char const *name) {
+	if (!active) return -1U;
+	if (!initialized) init();
+
+	//find (or add) the pass:
+	uint32_t pass = 0;
+	while (pass < results.size() && std::strcmp(results[pass].name, name) != 0) ++pass;
+	if (pass == results.size()) {
+		results.emplace_back();
+		results.back().name = name;
+	}
+
+	Frame &frame = frames[current];
+	Marker marker;
+	marker.pass = pass;
+	marker.begin_query = marker.end_query = 0;
+	marker.cpu_ms = 0.0f;
+	if (gpu_timing) {
+		marker.begin_query = frame.get_query();
+		marker.end_query = frame.get_query();
+		glQueryCounter(marker.begin_query, GL_TIMESTAMP);
+	}
+	frame.markers.emplace_back(marker);
+	return uint32_t(frame.markers.size() - 1);
+}
+
+void GPUProfiler::end(uint32_t index, float cpu_ms) {
+	Marker &marker = frames[current].markers[index];
+	if (marker.end_query != 0) glQueryCounter(marker.end_query, GL_TIMESTAMP);
+	marker.cpu_ms = cpu_ms;
+}
+
+void GPUProfiler::end_frame() {
+	//the oldest frame's queries have had Latency frames to finish:
+	current = (current + 1) % Latency;
+	read_back(frames[current]);
+}
+
+void GPUProfiler::read_back(Frame &frame) {
+	if (frame.markers.empty()) return;
+
+	//don't wait on queries that aren't done (drop the frame instead):
+	bool ready = true;
+	for (auto const &marker : frame.markers) {
+		if (marker.end_query == 0) continue;
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(marker.end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			ready = false;
+			break;
+		}
+	}
+
+	if (ready) {
+		for (auto &pass : results) {
+			pass.cpu_ms = pass.gpu_ms = 0.0f;
+			pass.scopes = 0;
+		}
+		for (auto const &marker : frame.markers) {
+			Pass &pass = results[marker.pass];
+			pass.cpu_ms += marker.cpu_ms;
+			pass.scopes += 1;
+			if (marker.end_query != 0) {
+				GLuint64 begin_ns = 0, end_ns = 0;
+				glGetQueryObjectui64v(marker.begin_query, GL_QUERY_RESULT, &begin_ns);
+				glGetQueryObjectui64v(marker.end_query, GL_QUERY_RESULT, &end_ns);
+				if (end_ns > begin_ns) pass.gpu_ms += float(end_ns - begin_ns) * 1e-6f;
+			}
+		}
+	} else {
+		dropped += 1;
+	}
+
+	frame.markers.clear();
+	frame.used_queries = 0;
+}
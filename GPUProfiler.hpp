@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+ * GPUProfiler measures how long named render passes take, on the GPU (with
+ *  timer queries) and on the CPU (time spent issuing the GL calls).
+ *
+ * Wrap a pass in a Scope:
+ *
+ *   {
+ *       GPUProfiler::Scope scope("scene");
+ *       ...GL calls...
+ *   }
+ *
+ * Each scope drops a GL_TIMESTAMP query (glQueryCounter) at its start and
+ *  end. Timestamps -- unlike GL_TIME_ELAPSED queries -- may nest and
+ *  overlap, so scopes can be used anywhere. Scopes with the same name in one
+ *  frame add up.
+ *
+ * GPU results arrive late, so queries are kept for Latency frames before
+ *  end_frame() reads them back; results that still aren't ready then are
+ *  dropped rather than waited for, so profiling never stalls the pipeline.
+ *
+ * Implementations without a timestamp counter (GL_QUERY_COUNTER_BITS of 0)
+ *  still get CPU timings; 'gpu_timing' is false there.
+ *
+ * Scopes do nothing unless 'active' is set (main.cpp sets it while the
+ *  performance HUD is showing -- see RenderStats).
+ *
+ */
+
+#include "GL.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GPUProfiler {
+	//frames between issuing queries and reading them back:
+	enum : uint32_t { Latency = 4 };
+
+	//time scopes only while this is set:
+	bool active = false;
+
+	//timestamp queries work (checked on first use):
+	bool gpu_timing = false;
+
+	//time one pass (name should be a string literal, or at least outlive the profiler):
+	struct Scope {
+		explicit Scope(char const *name);
+		~Scope();
+		uint32_t marker; //-1U if not recording
+		std::chrono::high_resolution_clock::time_point start;
+	};
+
+	//finish the current frame's markers and read back the frame from Latency frames ago:
+	void end_frame();
+
+	//timings of the most recently read-back frame, one entry per pass name, in the order passes first appeared:
+	struct Pass {
+		char const *name = "";
+		float cpu_ms = 0.0f; //time inside the pass's scopes, on the CPU
+		float gpu_ms = 0.0f; //..and on the GPU (zero if !gpu_timing)
+		uint32_t scopes = 0; //number of scopes with this name that frame
+	};
+	std::vector< Pass > results;
+	uint32_t dropped = 0; //frames whose queries weren't ready after Latency frames
+
+	//-- internals --
+	bool initialized = false;
+	void init();
+
+	struct Marker {
+		uint32_t pass; //index in 'results'
+		GLuint begin_query, end_query;
+		float cpu_ms;
+	};
+	struct Frame {
+		std::vector< Marker > markers;
+		std::vector< GLuint > queries; //pool of query objects, reused every Latency frames
+		uint32_t used_queries = 0;
+		GLuint get_query();
+	};
+	Frame frames[Latency];
+	uint32_t current = 0; //frame receiving markers
+
+	uint32_t begin(char const *name);
+	void end(uint32_t marker, float cpu_ms);
+	void read_back(Frame &frame);
+};
+
+extern GPUProfiler gpu_profiler;
@@ -0,0 +1,279 @@
+#include "LevelStreamer.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+LevelStreamer::LevelStreamer(std::string const &filename, Scene::Drawable::Pipeline const &pipeline_, std::string const &walkmesh_name_)
+	: walkmesh({}, {}, {}), previous_walkmesh({}, {}, {}), pipeline(pipeline_), walkmesh_name(walkmesh_name_) {
+
+	if (!(filename.size() >= 6 && filename.substr(filename.size() - 6) == ".cells")) {
+		throw std::runtime_error("Level cells file '" + filename + "' should end in '.cells'.");
+	}
+	prefix = filename.substr(0, filename.size() - 6);
+
+	std::ifstream file(filename, std::ios::binary);
+
+	std::vector< float > grid;
+	read_chunk(file, "grd0", &grid);
+	if (grid.size() != 1 || !(grid[0] > 0.0f)) {
+		throw std::runtime_error("Level cells file '" + filename + "' has an invalid grid chunk.");
+	}
+	cell_size = grid[0];
+
+	std::vector< glm::ivec2 > coords;
+	read_chunk(file, "cel0", &coords);
+	cells.resize(coords.size());
+	for (size_t i = 0; i < coords.size(); ++i) {
+		cells[i].coord = coords[i];
+	}
+
+	if (file.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in level cells file '" << filename << "'" << std::endl;
+	}
+
+	load_radius = 1.5f * cell_size;
+	unload_radius = 2.5f * cell_size;
+
+	loader = std::thread(&LevelStreamer::loader_main, this);
+}
+
+LevelStreamer::~LevelStreamer() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	loader.join();
+
+	for (auto &cell : cells) {
+		unload_cell(cell);
+	}
+}
+
+void LevelStreamer::loader_main() {
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		wake.wait(lock, [this]() { return quit || !to_read.empty(); });
+		if (quit) break;
+		uint32_t index = to_read.front();
+		to_read.pop_front();
+
+		//read without holding the lock (the main thread leaves Reading cells alone):
+		lock.unlock();
+		read_cell(cells[index]);
+		lock.lock();
+
+		cells[index].state = Cell::Read;
+		done.notify_all();
+	}
+}
+
+void LevelStreamer::read_cell(Cell &cell) const {
+	std::string base = prefix + "-cell-" + std::to_string(cell.coord.x) + "-" + std::to_string(cell.coord.y);
+	try {
+		cell.scene.reset(new Scene());
+		cell.mesh_refs.clear();
+		//drawables need GL objects, so just note which meshes go where for now:
+		cell.scene->load(base + ".scene", [&cell](Scene &, Scene::Transform *transform, std::string const &mesh_name) {
+			cell.mesh_refs.emplace_back(transform, mesh_name);
+		});
+		cell.meshes.reset(new MeshBuffer(base + ".pnct", MeshBuffer::DeferUpload()));
+		if (optimize_meshes) cell.meshes->optimize();
+		cell.meshes->use_arena = use_mesh_arena;
+		cell.walkmeshes.reset(new WalkMeshes(base + ".w"));
+	} catch (std::exception &e) {
+		cell.error = e.what();
+	}
+}
+
+void LevelStreamer::upload_cell(Cell &cell) {
+	assert(cell.state == Cell::Read);
+
+	if (!cell.error.empty()) {
+		//leave a failed cell empty (but Resident, so it isn't read again until it is unloaded):
+		std::cerr << "WARNING: failed to read level cell (" << cell.coord.x << ", " << cell.coord.y << "): " << cell.error << std::endl;
+		unload_cell(cell);
+		cell.state = Cell::Resident;
+		return;
+	}
+
+	cell.meshes->upload();
+	cell.vao = cell.meshes->make_vao_for_program(pipeline.program);
+
+	for (auto const &ref : cell.mesh_refs) {
+		Mesh const &mesh = cell.meshes->lookup(ref.second);
+
+		cell.scene->drawables.emplace_back(ref.first);
+		Scene::Drawable &drawable = cell.scene->drawables.back();
+
+		drawable.pipeline = pipeline;
+		drawable.pipeline.vao = cell.vao;
+		drawable.set_mesh(mesh);
+	}
+	cell.mesh_refs.clear();
+
+	cell.state = Cell::Resident;
+}
+
+void LevelStreamer::unload_cell(Cell &cell) {
+	assert(cell.state != Cell::Reading);
+
+	if (cell.vao != 0) {
+		//(arena vertex arrays are shared, so stay)
+		if (!(cell.meshes && cell.meshes->in_arena())) glDeleteVertexArrays(1, &cell.vao);
+		cell.vao = 0;
+	}
+	if (cell.meshes) cell.meshes->free_buffers();
+	cell.scene.reset();
+	cell.mesh_refs.clear();
+	cell.meshes.reset();
+	cell.walkmeshes.reset();
+	cell.error.clear();
+
+	cell.state = Cell::Unloaded;
+}
+
+bool LevelStreamer::update(glm::vec3 const &position) {
+	auto distance_to = [&](Cell const &cell) {
+		glm::vec2 center = (glm::vec2(cell.coord) + glm::vec2(0.5f)) * cell_size;
+		return glm::length(glm::vec2(position) - center);
+	};
+
+	bool changed = false;
+
+	std::vector< uint32_t > to_unload; //resident (or read but not uploaded) cells that are too far away
+	std::vector< uint32_t > ready; //read cells to upload
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+
+		//drop queued reads that are no longer wanted:
+		to_read.erase(std::remove_if(to_read.begin(), to_read.end(), [&](uint32_t i) {
+			if (distance_to(cells[i]) <= unload_radius) return false;
+			cells[i].state = Cell::Unloaded;
+			return true;
+		}), to_read.end());
+
+		std::vector< uint32_t > to_queue; //unloaded cells that are close enough
+		for (uint32_t i = 0; i < uint32_t(cells.size()); ++i) {
+			Cell const &cell = cells[i];
+			float distance = distance_to(cell);
+			if (cell.state == Cell::Unloaded && distance <= load_radius) to_queue.emplace_back(i);
+			else if ((cell.state == Cell::Read || cell.state == Cell::Resident) && distance > unload_radius) to_unload.emplace_back(i);
+			else if (cell.state == Cell::Read) ready.emplace_back(i);
+		}
+
+		//read nearest cells first:
+		std::sort(to_queue.begin(), to_queue.end(), [&](uint32_t a, uint32_t b) { return distance_to(cells[a]) < distance_to(cells[b]); });
+		for (uint32_t i : to_queue) {
+			cells[i].state = Cell::Reading;
+			to_read.emplace_back(i);
+		}
+		if (!to_queue.empty()) wake.notify_one();
+	}
+
+	for (uint32_t i : to_unload) {
+		if (cells[i].state == Cell::Resident) changed = true;
+		unload_cell(cells[i]);
+	}
+
+	//upload nearest cells first, until the budget is used up:
+	std::sort(ready.begin(), ready.end(), [&](uint32_t a, uint32_t b) { return distance_to(cells[a]) < distance_to(cells[b]); });
+	size_t uploaded = 0;
+	for (uint32_t i : ready) {
+		if (uploaded >= upload_budget) break;
+		if (cells[i].meshes) uploaded += cells[i].meshes->staged.size() + cells[i].meshes->staged_indices.size();
+		upload_cell(cells[i]);
+		changed = true;
+	}
+
+	if (changed) rebuild_walkmesh();
+	return changed;
+}
+
+void LevelStreamer::load_now(glm::vec3 const &position) {
+	auto distance_to = [&](Cell const &cell) {
+		glm::vec2 center = (glm::vec2(cell.coord) + glm::vec2(0.5f)) * cell_size;
+		return glm::length(glm::vec2(position) - center);
+	};
+
+	std::vector< uint32_t > to_upload;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+
+		//take nearby cells back from the queue (they'll be read right here):
+		to_read.erase(std::remove_if(to_read.begin(), to_read.end(), [&](uint32_t i) {
+			if (distance_to(cells[i]) > load_radius) return false;
+			cells[i].state = Cell::Unloaded;
+			return true;
+		}), to_read.end());
+
+		for (uint32_t i = 0; i < uint32_t(cells.size()); ++i) {
+			if (distance_to(cells[i]) > load_radius) continue;
+			//cells the loader is busy with will be done soon, so wait for those:
+			done.wait(lock, [&]() { return cells[i].state != Cell::Reading; });
+			if (cells[i].state == Cell::Unloaded) {
+				cells[i].state = Cell::Reading;
+				lock.unlock();
+				read_cell(cells[i]);
+				lock.lock();
+				cells[i].state = Cell::Read;
+			}
+			if (cells[i].state == Cell::Read) to_upload.emplace_back(i);
+		}
+	}
+
+	for (uint32_t i : to_upload) {
+		upload_cell(cells[i]);
+	}
+
+	rebuild_walkmesh();
+}
+
+std::vector< Scene const * > LevelStreamer::resident_scenes() const {
+	std::vector< Scene const * > scenes;
+	for (auto const &cell : cells) {
+		if (cell.state == Cell::Resident && cell.scene) scenes.emplace_back(cell.scene.get());
+	}
+	return scenes;
+}
+
+void LevelStreamer::rebuild_walkmesh() {
+	std::vector< glm::vec3 > vertices;
+	std::vector< glm::vec3 > normals;
+	std::vector< glm::uvec3 > triangles;
+
+	//vertices on cell borders were copied into each cell, so join them back up by position:
+	std::unordered_map< glm::vec3, uint32_t > joined;
+	std::vector< uint32_t > vertex_map;
+	for (auto const &cell : cells) {
+		if (cell.state != Cell::Resident || !cell.walkmeshes) continue;
+		auto f = cell.walkmeshes->meshes.find(walkmesh_name);
+		if (f == cell.walkmeshes->meshes.end()) continue;
+		WalkMesh const &wm = f->second;
+
+		vertex_map.assign(wm.vertices.size(), -1U);
+		for (uint32_t v = 0; v < uint32_t(wm.vertices.size()); ++v) {
+			auto ret = joined.emplace(wm.vertices[v], uint32_t(vertices.size()));
+			if (ret.second) {
+				vertices.emplace_back(wm.vertices[v]);
+				normals.emplace_back(wm.normals[v]);
+			}
+			vertex_map[v] = ret.first->second;
+		}
+		for (auto const &tri : wm.triangles) {
+			triangles.emplace_back(vertex_map[tri.x], vertex_map[tri.y], vertex_map[tri.z]);
+		}
+	}
+
+	previous_walkmesh = std::move(walkmesh);
+	walkmesh = WalkMesh(vertices, normals, triangles);
+}
+
+WalkPoint LevelStreamer::remap(WalkPoint const &wp) const {
+	if (walkmesh.triangles.empty() || wp.indices.x >= previous_walkmesh.vertices.size()) return wp;
+	return walkmesh.nearest_walk_point(previous_walkmesh.to_world_point(wp));
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * LevelStreamer keeps just the part of a large level near the player loaded.
+ *
+ * The level is split offline (by scenes/split-cells.py) into square cells,
+ *  each with its own .scene, .pnct, and .w file, listed in a .cells file.
+ *  Each frame, update() is given the player's position and:
+ *  - queues cells within load_radius for reading on a background thread
+ *    (file reads and parsing only -- no GL)
+ *  - uploads cells that finished reading (meshes, vertex arrays, and
+ *    drawables), stopping once upload_budget bytes have gone to GL
+ *  - unloads cells beyond unload_radius (which is larger, so a player
+ *    walking along a cell border doesn't cause constant reloading)
+ *
+ * Resident cells are separate Scenes; attach them to the game's scene
+ *  (see Scene::attached) to draw them. Their walkmeshes are joined into one
+ *  'walkmesh' whenever the set of resident cells changes.
+ *
+ */
+
+#include "Mesh.hpp"
+#include "Scene.hpp"
+#include "WalkMesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LevelStreamer {
+	//read the list of cells from 'filename' (a .cells file; cell files are expected next to it):
+	// drawables in cells are made from 'pipeline' (with vao, type, start, and count filled in per mesh)
+	// cells' walkmeshes are looked up by 'walkmesh_name'
+	// throws on file format errors
+	LevelStreamer(std::string const &filename, Scene::Drawable::Pipeline const &pipeline, std::string const &walkmesh_name = "WalkMesh");
+	~LevelStreamer();
+
+	//cells with centers within load_radius of the player are loaded; loaded cells beyond unload_radius are unloaded:
+	float load_radius = 0.0f; //defaults to 1.5 * cell size
+	float unload_radius = 0.0f; //defaults to 2.5 * cell size
+
+	//bytes of vertex data uploaded per update() (at least one cell is uploaded per call, regardless):
+	size_t upload_budget = 4 << 20;
+
+	//reorder cells' meshes for the vertex cache as they are read (see MeshBuffer::optimize):
+	// (for levels that weren't run through scenes/optimize-meshes; costs loader-thread time)
+	bool optimize_meshes = false;
+
+	//upload cells' meshes into the shared mesh arena (see MeshArena.hpp), so all cells -- and anything else
+	// in the arena -- draw through one vertex array, and streaming re-uses buffer space instead of re-creating buffers:
+	bool use_mesh_arena = true;
+
+	//load/unload cells around 'position' and upload what's ready; returns true if the resident cells changed:
+	// (if so, re-attach resident_scenes() and carry WalkPoints over to the new walkmesh with remap())
+	bool update(glm::vec3 const &position);
+
+	//load all cells near 'position' right away (e.g., before placing the player at the start of a level):
+	void load_now(glm::vec3 const &position);
+
+	//scenes of resident cells, for Scene::attached:
+	std::vector< Scene const * > resident_scenes() const;
+
+	//walkmeshes of all resident cells, joined along cell borders:
+	WalkMesh walkmesh;
+	//..and as it was before the last change, so WalkPoints on it can be carried over with remap():
+	WalkMesh previous_walkmesh;
+	WalkPoint remap(WalkPoint const &wp) const;
+
+	//-- internals --
+	std::string prefix; //cell files are prefix + "-cell-<x>-<y>.{scene,pnct,w}"
+	float cell_size = 1.0f;
+	Scene::Drawable::Pipeline pipeline;
+	std::string walkmesh_name;
+
+	struct Cell {
+		glm::ivec2 coord = glm::ivec2(0);
+		enum State : uint8_t {
+			Unloaded, //nothing in memory
+			Reading, //queued for (or being read by) the loader thread
+			Read, //files read; waiting for upload
+			Resident, //uploaded and drawable
+		} state = Unloaded; //(written by the loader thread only for Reading -> Read, under 'mutex')
+
+		//written by the loader thread:
+		std::unique_ptr< Scene > scene; //transforms, cameras, and lights (drawables are added at upload)
+		std::vector< std::pair< Scene::Transform *, std::string > > mesh_refs; //drawables to make at upload
+		std::unique_ptr< MeshBuffer > meshes;
+		std::unique_ptr< WalkMeshes > walkmeshes;
+		std::string error; //set if reading failed
+
+		//written at upload:
+		GLuint vao = 0; //(the arena's, if the cell's meshes are in the arena)
+	};
+	std::vector< Cell > cells;
+
+	//loader thread and its queue of cell indices to read:
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake; //signalled when cells are queued (or the loader should quit)
+	std::condition_variable done; //signalled when the loader finishes reading a cell
+	std::deque< uint32_t > to_read;
+	bool quit = false;
+	void loader_main();
+
+	void read_cell(Cell &cell) const; //(GL-free; used by the loader thread and load_now)
+	void upload_cell(Cell &cell);
+	void unload_cell(Cell &cell);
+	void rebuild_walkmesh();
+};
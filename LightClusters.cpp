@@ -0,0 +1,284 @@
+#include "LightClusters.hpp"
+
+#include "RenderStats.hpp"
+#include "UniformBlocks.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+Load< LightClusters > light_clusters(LoadTagEarly, []() -> LightClusters const * {
+	return new LightClusters();
+});
+
+std::string const LightClusters::GLSL =
+	"layout(std140) uniform Clusters {\n"
+	"	ivec4 CLUSTER_GRID;\n"
+	"	vec4 CLUSTER_DEPTH;\n"
+	"	vec4 LIGHT_POSITION_TYPE[" + std::to_string(MaxLights) + "];\n"
+	"	vec4 LIGHT_DIRECTION_CUTOFF[" + std::to_string(MaxLights) + "];\n"
+	"	vec4 LIGHT_ENERGY_RANGE[" + std::to_string(MaxLights) + "];\n"
+	"};\n"
+	"uniform usamplerBuffer CLUSTER_TABLE;\n"
+	"uniform usamplerBuffer CLUSTER_INDICES;\n"
+	//light from one light (same models as LitColorTextureProgram's single light, with a range cutoff):
+	"vec3 cluster_light(int i, vec3 position, vec3 n) {\n"
+	"	int type = int(LIGHT_POSITION_TYPE[i].w);\n"
+	"	vec3 direction = LIGHT_DIRECTION_CUTOFF[i].xyz;\n"
+	"	vec3 energy = LIGHT_ENERGY_RANGE[i].rgb;\n"
+	"	if (type == 1) { //hemi light \n"
+	"		return (dot(n,-direction) * 0.5 + 0.5) * energy;\n"
+	"	} else if (type == 3) { //directional light \n"
+	"		return max(0.0, dot(n,-direction)) * energy;\n"
+	"	}\n"
+	"	vec3 l = (LIGHT_POSITION_TYPE[i].xyz - position);\n"
+	"	float dis2 = dot(l,l);\n"
+	"	l = normalize(l);\n"
+	"	float range = LIGHT_ENERGY_RANGE[i].a;\n"
+	"	float window = clamp(1.0 - dis2 / (range * range), 0.0, 1.0);\n"
+	"	float nl = max(0.0, dot(n, l)) / max(1.0, dis2) * window * window;\n"
+	"	if (type == 2) { //spot light \n"
+	"		float cutoff = LIGHT_DIRECTION_CUTOFF[i].w;\n"
+	"		nl *= smoothstep(cutoff,mix(cutoff,1.0,0.1), dot(l,-direction));\n"
+	"	}\n"
+	"	return nl * energy;\n"
+	"}\n"
+	"vec3 clustered_lighting(vec3 position, vec3 n, vec4 clip_position) {\n"
+	"	vec3 e = vec3(0.0);\n"
+	//global lights come first in the light arrays:
+	"	for (int i = 0; i < CLUSTER_GRID.w; ++i) {\n"
+	"		e += cluster_light(i, position, n);\n"
+	"	}\n"
+	//find this fragment's cluster:
+	"	vec2 ndc = clip_position.xy / clip_position.w;\n"
+	"	ivec2 tile = clamp(ivec2((ndc * 0.5 + 0.5) * vec2(CLUSTER_GRID.xy)), ivec2(0), CLUSTER_GRID.xy - 1);\n"
+	"	int slice = clamp(int(log(max(clip_position.w, 1e-6)) * CLUSTER_DEPTH.x + CLUSTER_DEPTH.y), 0, CLUSTER_GRID.z - 1);\n"
+	"	int cluster = (slice * CLUSTER_GRID.y + tile.y) * CLUSTER_GRID.x + tile.x;\n"
+	//...and loop over its lights:
+	"	uvec2 range = texelFetch(CLUSTER_TABLE, cluster).xy;\n"
+	"	for (uint j = 0u; j < range.y; ++j) {\n"
+	"		int i = int(texelFetch(CLUSTER_INDICES, int(range.x + j)).x);\n"
+	"		e += cluster_light(i, position, n);\n"
+	"	}\n"
+	"	return e;\n"
+	"}\n"
+;
+
+LightClusters::LightClusters() {
+	glGenBuffers(1, &block_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, block_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UniformBlocks::ClustersBinding, block_buffer);
+
+	//buffer textures for the cluster lists:
+	auto make_buffer_texture = [](GLenum format, GLuint *buffer, GLuint *tex) {
+		glGenBuffers(1, buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenTextures(1, tex);
+		glBindTexture(GL_TEXTURE_BUFFER, *tex);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	};
+	make_buffer_texture(GL_RG32UI, &table_buffer, &table_tex);
+	make_buffer_texture(GL_R8UI, &index_buffer, &index_tex);
+
+	GL_ERRORS();
+}
+
+LightClusters::~LightClusters() {
+	glDeleteTextures(1, &table_tex);
+	table_tex = 0;
+	glDeleteTextures(1, &index_tex);
+	index_tex = 0;
+	glDeleteBuffers(1, &table_buffer);
+	table_buffer = 0;
+	glDeleteBuffers(1, &index_buffer);
+	index_buffer = 0;
+	glDeleteBuffers(1, &block_buffer);
+	block_buffer = 0;
+}
+
+void LightClusters::bind_samplers(GLuint program) {
+	GLint CLUSTER_TABLE_usamplerBuffer = glGetUniformLocation(program, "CLUSTER_TABLE");
+	GLint CLUSTER_INDICES_usamplerBuffer = glGetUniformLocation(program, "CLUSTER_INDICES");
+
+	glUseProgram(program);
+	if (CLUSTER_TABLE_usamplerBuffer != -1) glUniform1i(CLUSTER_TABLE_usamplerBuffer, TableUnit);
+	if (CLUSTER_INDICES_usamplerBuffer != -1) glUniform1i(CLUSTER_INDICES_usamplerBuffer, IndexUnit);
+	glUseProgram(0);
+}
+
+void LightClusters::update(Scene const &scene, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	auto bind_textures = [this]() {
+		glActiveTexture(GL_TEXTURE0 + TableUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, table_tex);
+		glActiveTexture(GL_TEXTURE0 + IndexUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, index_tex);
+		glActiveTexture(GL_TEXTURE0);
+	};
+
+	bool any_lights = false;
+	scene.for_each_light([&any_lights](Scene::Light const &, Scene::Transform const &) { any_lights = true; });
+	if (!any_lights && uploaded_empty) {
+		bind_textures();
+		return;
+	}
+
+	//view depth (== clip w) changes by 'depth_scale' per unit of world distance:
+	glm::vec4 depth_row = glm::vec4(world_to_clip[0][3], world_to_clip[1][3], world_to_clip[2][3], world_to_clip[3][3]);
+	float depth_scale = glm::length(glm::vec3(depth_row));
+
+	float slice_scale = float(GridZ) / std::log(slice_far / slice_near);
+	float slice_bias = -std::log(slice_near) * slice_scale;
+	block.CLUSTER_DEPTH = glm::vec4(slice_scale, slice_bias, 0.0f, 0.0f);
+
+	uint32_t count = 0;
+	auto store = [&](Scene::Light const &light, glm::vec3 const &position, glm::vec3 const &direction, float range) {
+		assert(count < MaxLights);
+		float type = 0.0f;
+		if (light.type == Scene::Light::Point) type = 0.0f;
+		else if (light.type == Scene::Light::Hemisphere) type = 1.0f;
+		else if (light.type == Scene::Light::Spot) type = 2.0f;
+		else if (light.type == Scene::Light::Directional) type = 3.0f;
+		block.LIGHT_POSITION_TYPE[count] = glm::vec4(world_to_light * glm::vec4(position, 1.0f), type);
+		block.LIGHT_DIRECTION_CUTOFF[count] = glm::vec4(
+			glm::normalize(glm::mat3(world_to_light) * direction),
+			std::cos(0.5f * light.spot_fov)
+		);
+		block.LIGHT_ENERGY_RANGE[count] = glm::vec4(light.energy, range);
+		count += 1;
+	};
+
+	//Gather lights: global ones are stored right away, point/spot lights become binning candidates:
+	candidates.clear();
+	scene.for_each_light([&](Scene::Light const &light, Scene::Transform const &transform) {
+		glm::mat4x3 light_to_world = transform.make_local_to_world();
+		glm::vec3 position = light_to_world[3];
+		glm::vec3 direction = -glm::normalize(light_to_world[2]); //(lights point along their -z axis)
+
+		if (light.type == Scene::Light::Hemisphere || light.type == Scene::Light::Directional) {
+			if (count < MaxLights) store(light, position, direction, 0.0f);
+			return;
+		}
+
+		float brightest = std::max(light.energy.r, std::max(light.energy.g, light.energy.b));
+		if (!(brightest > 0.0f)) return;
+		float range = std::sqrt(brightest / cutoff_fraction);
+
+		float depth = glm::dot(depth_row, glm::vec4(position, 1.0f));
+		if (depth + range * depth_scale <= 0.0f) return; //entirely behind the camera
+
+		candidates.emplace_back(Candidate{ position, direction, &light, depth, range });
+	});
+	uint32_t global_count = count;
+	block.CLUSTER_GRID = glm::ivec4(GridX, GridY, GridZ, int32_t(global_count));
+
+	//too many lights? keep the nearest:
+	if (candidates.size() > MaxLights - global_count) {
+		std::sort(candidates.begin(), candidates.end(), [](Candidate const &a, Candidate const &b) {
+			return a.depth < b.depth;
+		});
+		candidates.resize(MaxLights - global_count);
+	}
+
+	//Find the clusters touched by each candidate's range:
+	extents.clear();
+	auto slice = [&](float depth) -> uint32_t {
+		float s = std::floor(std::log(std::max(depth, 1e-6f)) * slice_scale + slice_bias);
+		return uint32_t(std::max(0.0f, std::min(float(GridZ - 1), s)));
+	};
+	for (auto const &c : candidates) {
+		Extent extent;
+		extent.min.z = slice(c.depth - c.range * depth_scale);
+		extent.max.z = slice(c.depth + c.range * depth_scale);
+
+		//screen-space bounds of the range's bounding box (whole screen if it crosses the camera plane):
+		glm::vec2 ndc_min = glm::vec2(-1.0f);
+		glm::vec2 ndc_max = glm::vec2( 1.0f);
+		bool crosses = false;
+		glm::vec2 corner_min = glm::vec2( std::numeric_limits< float >::infinity());
+		glm::vec2 corner_max = glm::vec2(-std::numeric_limits< float >::infinity());
+		for (uint32_t i = 0; i < 8; ++i) {
+			glm::vec3 corner = c.position + c.range * glm::vec3(
+				(i & 1 ? 1.0f : -1.0f), (i & 2 ? 1.0f : -1.0f), (i & 4 ? 1.0f : -1.0f)
+			);
+			glm::vec4 clip = world_to_clip * glm::vec4(corner, 1.0f);
+			if (clip.w <= 1e-4f) {
+				crosses = true;
+				break;
+			}
+			glm::vec2 ndc = glm::vec2(clip) / clip.w;
+			corner_min = glm::min(corner_min, ndc);
+			corner_max = glm::max(corner_max, ndc);
+		}
+		if (!crosses) {
+			if (corner_max.x < -1.0f || corner_max.y < -1.0f || corner_min.x > 1.0f || corner_min.y > 1.0f) {
+				//off screen; not binned (but still stored, so indices stay simple)
+				extents.emplace_back(Extent{ glm::uvec3(1), glm::uvec3(0) });
+				continue;
+			}
+			ndc_min = glm::max(ndc_min, corner_min);
+			ndc_max = glm::min(ndc_max, corner_max);
+		}
+		auto tile = [](float ndc, uint32_t tiles) -> uint32_t {
+			float t = std::floor((ndc * 0.5f + 0.5f) * float(tiles));
+			return uint32_t(std::max(0.0f, std::min(float(tiles - 1), t)));
+		};
+		extent.min.x = tile(ndc_min.x, GridX);
+		extent.max.x = tile(ndc_max.x, GridX);
+		extent.min.y = tile(ndc_min.y, GridY);
+		extent.max.y = tile(ndc_max.y, GridY);
+		extents.emplace_back(extent);
+	}
+
+	//Build per-cluster index lists (count, then offsets, then fill):
+	table.assign(ClusterCount, glm::uvec2(0));
+	auto for_each_cluster = [](Extent const &extent, auto const &fn) {
+		for (uint32_t z = extent.min.z; z <= extent.max.z; ++z) {
+			for (uint32_t y = extent.min.y; y <= extent.max.y; ++y) {
+				for (uint32_t x = extent.min.x; x <= extent.max.x; ++x) {
+					fn((z * GridY + y) * GridX + x);
+				}
+			}
+		}
+	};
+	for (auto const &extent : extents) {
+		for_each_cluster(extent, [this](uint32_t cluster) { table[cluster].y += 1; });
+	}
+	uint32_t total = 0;
+	for (auto &entry : table) {
+		entry.x = total;
+		total += entry.y;
+		entry.y = 0; //(re-counted while filling)
+	}
+	indices.assign(std::max(total, 1U), 0);
+	for (uint32_t i = 0; i < uint32_t(candidates.size()); ++i) {
+		uint8_t index = uint8_t(count);
+		store(*candidates[i].light, candidates[i].position, candidates[i].direction, candidates[i].range);
+		for_each_cluster(extents[i], [this, index](uint32_t cluster) {
+			indices[table[cluster].x + table[cluster].y] = index;
+			table[cluster].y += 1;
+		});
+	}
+
+	//Upload:
+	glBindBuffer(GL_UNIFORM_BUFFER, block_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, table_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(table[0]), table.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, index_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(indices[0]), indices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	render_stats.frame.upload_bytes += sizeof(Block) + table.size() * sizeof(table[0]) + indices.size() * sizeof(indices[0]);
+
+	uploaded_empty = (count == 0);
+
+	bind_textures();
+}
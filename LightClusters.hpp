@@ -0,0 +1,100 @@
+#pragma once
+
+/*
+ * LightClusters shades with all of a Scene's lights in a single forward pass
+ *  ("clustered forward" lighting):
+ *  - the view frustum is cut into a grid of clusters (screen-space tiles
+ *    times exponentially-spaced depth slices)
+ *  - each frame, point and spot lights are binned on the CPU into every
+ *    cluster their range touches
+ *  - fragment shaders look up their own cluster and loop over only its
+ *    lights (plus the hemisphere and directional lights, which reach
+ *    everywhere and so aren't binned)
+ *
+ * Light parameters live in the 'Clusters' uniform block; the per-cluster
+ *  light lists live in two buffer textures. Programs paste in LightClusters::GLSL
+ *  and call clustered_lighting(); see LitColorTextureProgram for an example.
+ *
+ */
+
+#include "GL.hpp"
+#include "Load.hpp"
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+struct LightClusters {
+	LightClusters();
+	~LightClusters();
+
+	enum : uint32_t {
+		MaxLights = 64, //lights beyond this (nearest to the camera are kept) are ignored
+		GridX = 16, GridY = 9, GridZ = 24, //cluster grid size
+		ClusterCount = GridX * GridY * GridZ,
+	};
+
+	//texture units the cluster lists are bound to:
+	// (Scene::Drawable::Pipeline uses units [0, TextureCount), so these come after)
+	enum : GLuint {
+		TableUnit = Scene::Drawable::Pipeline::TextureCount,
+		IndexUnit = Scene::Drawable::Pipeline::TextureCount + 1,
+	};
+
+	//depth slices are exponentially spaced between these view depths:
+	// (anything nearer lands in the first slice, anything farther in the last)
+	float slice_near = 0.5f;
+	float slice_far = 500.0f;
+
+	//point and spot lights fall off as energy / distance^2; they are cut off (smoothly) at the distance
+	// where this fraction of their energy remains, which is also the range used for binning:
+	float cutoff_fraction = 1.0f / 256.0f;
+
+	//std140 layout of the 'Clusters' uniform block:
+	struct Block {
+		glm::ivec4 CLUSTER_GRID = glm::ivec4(GridX, GridY, GridZ, 0); //w: number of (un-binned) global lights, stored first
+		glm::vec4 CLUSTER_DEPTH = glm::vec4(0.0f); //slice = log(depth) * x + y
+		glm::vec4 LIGHT_POSITION_TYPE[MaxLights]; //xyz: position (light space), w: type (0: point, 1: hemisphere, 2: spot, 3: directional)
+		glm::vec4 LIGHT_DIRECTION_CUTOFF[MaxLights]; //xyz: direction (light space), w: cos of spot half-angle
+		glm::vec4 LIGHT_ENERGY_RANGE[MaxLights]; //rgb: energy, a: range
+	};
+	static_assert(sizeof(Block) == 32 + 3 * 16 * MaxLights, "Block matches std140 layout.");
+
+	//GLSL declarations of the cluster data along with a function
+	//  vec3 clustered_lighting(vec3 position, vec3 normal, vec4 clip_position)
+	// that returns the light reaching a point (in light space) from all of the scene's lights:
+	static std::string const GLSL;
+
+	//point a program's cluster samplers at TableUnit/IndexUnit:
+	// (call once after compiling each program that uses GLSL; the 'Clusters' block is handled by UniformBlocks::bind_blocks)
+	static void bind_samplers(GLuint program);
+
+	//bin the scene's lights into clusters for this view, upload, and bind the results:
+	// (Scene::draw calls this)
+	void update(Scene const &scene, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const;
+
+	//-- internals --
+	GLuint block_buffer = 0;
+	GLuint table_buffer = 0, table_tex = 0; //per cluster: (first index, index count), as GL_RG32UI
+	GLuint index_buffer = 0, index_tex = 0; //light indices, as GL_R8UI
+
+	//working space for update() (kept around to avoid re-allocating):
+	mutable Block block;
+	mutable std::vector< glm::uvec2 > table;
+	mutable std::vector< uint8_t > indices;
+	struct Candidate { //a point or spot light that might be binned
+		glm::vec3 position; //world space
+		glm::vec3 direction; //world space
+		Scene::Light const *light;
+		float depth; //view depth of position
+		float range;
+	};
+	mutable std::vector< Candidate > candidates;
+	struct Extent { glm::uvec3 min, max; }; //clusters touched by a binned light, inclusive
+	mutable std::vector< Extent > extents;
+	mutable bool uploaded_empty = false; //(skip re-uploading when a scene without lights is drawn repeatedly)
+};
+
+extern Load< LightClusters > light_clusters;
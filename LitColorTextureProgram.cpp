@@ -1,27 +1,34 @@
 #include "LitColorTextureProgram.hpp"
 
+#include "LightClusters.hpp"
+#include "Mesh.hpp"
+#include "UniformBlocks.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
+#include <string>
+
 Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
 
+//n.b. declared before lit_color_texture_program so that it is loaded first:
+Load< LitColorTextureProgram > instanced_lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	return new LitColorTextureProgram(LitColorTextureProgram::Instanced);
+});
+
 Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
 	LitColorTextureProgram *ret = new LitColorTextureProgram();
 
 	//----- build the pipeline template -----
 	lit_color_texture_program_pipeline.program = ret->program;
 
-	lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//copies of the same mesh get drawn with the instanced variant:
+	// (camera matrices come from the 'Camera' block, so no instancing uniforms are needed)
+	lit_color_texture_program_pipeline.instancing.program = instanced_lit_color_texture_program->program;
+
+	//object matrices come from the 'Object' block:
+	lit_color_texture_program_pipeline.Object_block = ret->Object_block;
 
-	/* This will be used later if/when we build a light loop into the Scene:
-	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
-	lit_color_texture_program_pipeline.LIGHT_LOCATION_vec3 = ret->LIGHT_LOCATION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_DIRECTION_vec3 = ret->LIGHT_DIRECTION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_ENERGY_vec3 = ret->LIGHT_ENERGY_vec3;
-	lit_color_texture_program_pipeline.LIGHT_CUTOFF_float = ret->LIGHT_CUTOFF_float;
-	*/
+	//(and lighting comes from the 'Light' block -- see uniform_blocks->set_light())
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -43,42 +50,74 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	return ret;
 });
 
-LitColorTextureProgram::LitColorTextureProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
-		//vertex shader:
-		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
-		"in vec4 Position;\n"
-		"in vec3 Normal;\n"
-		"in vec4 Color;\n"
-		"in vec2 TexCoord;\n"
+LitColorTextureProgram::LitColorTextureProgram(Variant variant) {
+	//vertex attributes get fixed locations (below Scene::InstanceAttribLocation) so that a vertex array
+	// made for one variant also works with the other:
+	static_assert(Scene::InstanceAttribLocation >= 4, "vertex attributes fit below instance attributes");
+	std::string vertex_inputs =
+		"layout(location = 0) in vec4 Position;\n"
+		"layout(location = 1) in vec3 Normal;\n"
+		"layout(location = 2) in vec4 Color;\n"
+		"layout(location = 3) in vec2 TexCoord;\n"
 		"out vec3 position;\n"
 		"out vec3 normal;\n"
 		"out vec4 color;\n"
 		"out vec2 texCoord;\n"
-		"void main() {\n"
-		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
-		"	position = OBJECT_TO_LIGHT * Position;\n"
-		"	normal = NORMAL_TO_LIGHT * Normal;\n"
-		"	color = Color;\n"
-		"	texCoord = TexCoord;\n"
-		"}\n"
+		"out vec4 clipPosition;\n"
+		+ MeshBuffer::VertexGLSL
+	;
+
+	std::string vertex_shader;
+	if (variant == Single) {
+		vertex_shader =
+			"#version 330\n"
+			+ UniformBlocks::ObjectGLSL
+			+ vertex_inputs +
+			"void main() {\n"
+			"	vec4 object_position = mesh_position(Position);\n"
+			"	gl_Position = OBJECT_TO_CLIP * object_position;\n"
+			"	clipPosition = gl_Position;\n"
+			"	position = OBJECT_TO_LIGHT * object_position;\n"
+			"	normal = NORMAL_TO_LIGHT * mesh_normal(Position, Normal);\n"
+			"	color = Color;\n"
+			"	texCoord = TexCoord;\n"
+			"}\n"
+		;
+	} else { assert(variant == Instanced);
+		vertex_shader =
+			"#version 330\n"
+			+ UniformBlocks::CameraGLSL
+			+ vertex_inputs +
+			//per-instance attributes (layout matches Scene::InstanceData):
+			"layout(location = " + std::to_string(Scene::InstanceAttribLocation) + ") in mat4x3 OBJECT_TO_WORLD;\n"
+			"layout(location = " + std::to_string(Scene::InstanceAttribLocation + 4) + ") in mat3 NORMAL_TO_LIGHT;\n"
+			"void main() {\n"
+			"	vec4 world_position = vec4(OBJECT_TO_WORLD * mesh_position(Position), 1.0);\n"
+			"	gl_Position = WORLD_TO_CLIP * world_position;\n"
+			"	clipPosition = gl_Position;\n"
+			"	position = WORLD_TO_LIGHT * world_position;\n"
+			"	normal = NORMAL_TO_LIGHT * mesh_normal(Position, Normal);\n"
+			"	color = Color;\n"
+			"	texCoord = TexCoord;\n"
+			"}\n"
+		;
+	}
+
+	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
+	program = gl_compile_program(
+		//vertex shader:
+		vertex_shader
 	,
 		//fragment shader:
 		"#version 330\n"
 		"uniform sampler2D TEX;\n"
-		"uniform int LIGHT_TYPE;\n"
-		"uniform vec3 LIGHT_LOCATION;\n"
-		"uniform vec3 LIGHT_DIRECTION;\n"
-		"uniform vec3 LIGHT_ENERGY;\n"
-		"uniform float LIGHT_CUTOFF;\n"
+		+ UniformBlocks::LightGLSL
+		+ LightClusters::GLSL +
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
 		"in vec2 texCoord;\n"
+		"in vec4 clipPosition;\n"
 		"out vec4 fragColor;\n"
 		"void main() {\n"
 		"	vec3 n = normalize(normal);\n"
@@ -102,6 +141,8 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"	} else { //(LIGHT_TYPE == 3) //directional light \n"
 		"		e = max(0.0, dot(n,-LIGHT_DIRECTION)) * LIGHT_ENERGY;\n"
 		"	}\n"
+		//plus the scene's own lights:
+		"	e += clustered_lighting(position, n, clipPosition);\n"
 		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
 		"	fragColor = vec4(e*albedo.rgb, albedo.a);\n"
 		"}\n"
@@ -115,17 +156,12 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	Color_vec4 = glGetAttribLocation(program, "Color");
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
-	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
-
-	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
-	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
-
+	//look up the indices of uniform blocks, and connect them to their binding points:
+	Camera_block = glGetUniformBlockIndex(program, "Camera");
+	Light_block = glGetUniformBlockIndex(program, "Light");
+	Object_block = glGetUniformBlockIndex(program, "Object");
+	UniformBlocks::bind_blocks(program);
+	LightClusters::bind_samplers(program);
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
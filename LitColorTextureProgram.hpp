@@ -5,8 +5,10 @@
 #include "Scene.hpp"
 
 //Shader program that draws transformed, lit, textured vertices tinted with vertex colors:
+// the 'Instanced' variant reads its object transform from per-instance attributes (see Scene::InstanceData)
 struct LitColorTextureProgram {
-	LitColorTextureProgram();
+	enum Variant { Single, Instanced };
+	LitColorTextureProgram(Variant variant = Single);
 	~LitColorTextureProgram();
 
 	GLuint program = 0;
@@ -17,24 +19,21 @@ struct LitColorTextureProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
-
-	//lighting:
-	GLuint LIGHT_TYPE_int = -1U;
-	GLuint LIGHT_LOCATION_vec3 = -1U;
-	GLuint LIGHT_DIRECTION_vec3 = -1U;
-	GLuint LIGHT_ENERGY_vec3 = -1U;
-	GLuint LIGHT_CUTOFF_float = -1U;
+	//Uniform block indices (see UniformBlocks.hpp):
+	// (each variant uses only some of these; the rest are GL_INVALID_INDEX)
+	GLuint Camera_block = -1U; //Instanced variant: world-to-clip and world-to-light matrices
+	GLuint Light_block = -1U;
+	GLuint Object_block = -1U; //Single variant: per-object matrices
 	
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
 };
 
 extern Load< LitColorTextureProgram > lit_color_texture_program;
+extern Load< LitColorTextureProgram > instanced_lit_color_texture_program;
 
 //For convenient scene-graph setup, copy this object:
 // NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// NOTE: also has 'instancing' set up to use instanced_lit_color_texture_program.
+// NOTE: lighting comes from the 'Light' uniform block, so set it with uniform_blocks->set_light().
 extern Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
@@ -137,6 +137,7 @@ if (maek.OS === 'windows') {
 //returns objFile: objFileBase + a platform-dependant suffix ('.o' or '.obj')
 const game_names = [
 	maek.CPP('WalkMesh.cpp'),
+	maek.CPP('LevelStreamer.cpp'),
 	maek.CPP('main.cpp'),
 	maek.CPP('LitColorTextureProgram.cpp'),
 	//maek.CPP('ColorTextureProgram.cpp'),  //not used right now, but you might want it
@@ -148,9 +149,14 @@ const game_names = [
 	maek.CPP('SplashScreenMode.cpp'),
 	maek.CPP('GP22IntroMode.cpp'),
 	maek.CPP('BoneAnimation.cpp'),
+	maek.CPP('AssetCache-game.cpp'),
 	maek.CPP('BoneLitColorTextureProgram.cpp')
 ];
 
+//(also linked into the command-line mesh tools, below)
+const optimize_mesh_o = maek.CPP('optimize_mesh.cpp');
+const pnct_file_o = maek.CPP('pnct_file.cpp');
+
 const common_names = [
 	maek.CPP('data_path.cpp'),
 	maek.CPP('PathFont.cpp'),
@@ -158,7 +164,17 @@ const common_names = [
 	maek.CPP('DrawLines.cpp'),
 	maek.CPP('ColorProgram.cpp'),
 	maek.CPP('Scene.cpp'),
+	maek.CPP('LightClusters.cpp'),
+	maek.CPP('SceneBVH.cpp'),
+	maek.CPP('OcclusionBuffer.cpp'),
+	maek.CPP('RenderStats.cpp'),
+	maek.CPP('GPUProfiler.cpp'),
 	maek.CPP('Mesh.cpp'),
+	maek.CPP('MeshLoader.cpp'),
+	maek.CPP('MeshArena.cpp'),
+	maek.CPP('AssetCache.cpp'),
+	optimize_mesh_o,
+	pnct_file_o,
 	maek.CPP('load_save_png.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
 	maek.CPP('Mode.cpp'),
@@ -166,7 +182,9 @@ const common_names = [
 	maek.CPP('Load.cpp'),
 	maek.CPP('make_vao_for_program.cpp'),
 	maek.CPP('TextRendering.cpp'),
-	maek.CPP('TextTextureProgram.cpp')
+	maek.CPP('TextTextureProgram.cpp'),
+	maek.CPP('UniformBlocks.cpp'),
+	maek.CPP('WorkerPool.cpp')
 ];
 
 const show_meshes_names = [
@@ -188,9 +206,14 @@ const show_scene_names = [
 const game_exe = maek.LINK([...game_names, ...common_names], 'dist/game');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+//(command-line only, so it doesn't need the common -- OpenGL -- code)
+const simplify_meshes_exe = maek.LINK([maek.CPP('simplify-meshes.cpp'), pnct_file_o], 'scenes/simplify-meshes');
+const quantize_meshes_exe = maek.LINK([maek.CPP('quantize-meshes.cpp'), pnct_file_o], 'scenes/quantize-meshes');
+const optimize_meshes_exe = maek.LINK([maek.CPP('optimize-meshes.cpp'), optimize_mesh_o, pnct_file_o], 'scenes/optimize-meshes');
+const bench_pool_exe = maek.LINK([maek.CPP('bench-pool.cpp')], 'scenes/bench-pool');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, simplify_meshes_exe, quantize_meshes_exe, optimize_meshes_exe, bench_pool_exe, ...copies];
 
 //the '[targets =] RULE(targets, prerequisites[, recipe])' rule defines a Makefile-style task
 // targets: array of targets the task produces (can include both files and ':abstract targets')
@@ -1,90 +1,265 @@
 #include "Mesh.hpp"
-#include "read_write_chunk.hpp"
+#include "MeshArena.hpp"
+#include "RenderStats.hpp"
+#include "optimize_mesh.hpp"
+#include "pnct_file.hpp"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <limits>
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
 #include <cstddef>
+#include <cstring>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
+std::string const MeshBuffer::VertexGLSL =
+	//quantized positions have w = 0 (GL fills in w = 1 for three-component float positions):
+	"vec4 mesh_position(vec4 Position) {\n"
+	"	return vec4(Position.xyz, 1.0);\n"
+	"}\n"
+	//quantized normals are octahedral -- a point on the unit octahedron, with the lower half folded out to the corners:
+	"vec3 mesh_normal(vec4 Position, vec3 Normal) {\n"
+	"	if (Position.w != 0.0) return Normal;\n"
+	"	vec3 n = vec3(Normal.xy, 1.0 - abs(Normal.x) - abs(Normal.y));\n"
+	"	if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+	"	return normalize(n);\n"
+	"}\n"
+;
 
-	std::ifstream file(filename, std::ios::binary);
+MeshBuffer::MeshBuffer(std::string const &filename) : MeshBuffer(filename, DeferUpload()) {
+	upload();
+}
 
-	GLuint total = 0;
+void MeshBuffer::upload() {
+	size_t budget = std::numeric_limits< size_t >::max();
+	bool finished = upload_some(&budget);
+	assert(finished);
+	(void)finished;
+}
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
+//send up to 'budget' bytes of 'data' after the first 'sent' to buffer 'name' (creating it when sent is zero); returns bytes sent:
+static size_t send_staged(GLenum target, GLuint *name, std::vector< char > const &data, size_t sent, size_t budget) {
+	size_t count = std::min(data.size() - sent, budget);
+	if (count == 0 && sent < data.size()) return 0; //(no budget left)
+
+	if (*name == 0) glGenBuffers(1, name);
+	glBindBuffer(target, *name);
+	if (sent == 0 && count == data.size()) {
+		glBufferData(target, data.size(), data.data(), GL_STATIC_DRAW);
+	} else {
+		//(too big for one go, so allocate and fill in pieces)
+		if (sent == 0) glBufferData(target, data.size(), nullptr, GL_STATIC_DRAW);
+		glBufferSubData(target, sent, count, data.data() + sent);
+	}
+	glBindBuffer(target, 0);
+	render_stats.frame.upload_bytes += count;
+	return count;
+}
 
-	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+//send up to 'budget' bytes of 'data' after the first 'sent' to the (existing) buffer 'name', starting 'offset' bytes in; returns bytes sent:
+static size_t send_staged_at(GLenum target, GLuint name, size_t offset, std::vector< char > const &data, size_t sent, size_t budget) {
+	size_t count = std::min(data.size() - sent, budget);
+	if (count == 0) return 0;
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(target, name);
+	glBufferSubData(target, offset + sent, count, data.data() + sent);
+	glBindBuffer(target, 0);
+	render_stats.frame.upload_bytes += count;
+	return count;
+}
 
-		total = GLuint(data.size()); //store total for later checks on index
+bool MeshBuffer::upload_some(size_t *budget) {
+	assert(budget);
 
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+	if (use_arena && buffer == 0 && !in_arena()) {
+		if (mesh_arena.allocate(this)) {
+			//point every mesh (and level of detail) at this buffer's place in the arena:
+			GLuint index_start = arena.index_offset / (index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+			auto move = [&](GLuint &start, GLint &base_vertex) {
+				if (index_type == GL_NONE) {
+					start += arena.first_vertex;
+				} else {
+					start += index_start;
+					base_vertex += GLint(arena.first_vertex);
+				}
+			};
+			for (auto &m : meshes) {
+				move(m.second.start, m.second.base_vertex);
+				for (auto &lod : m.second.lods) move(lod.start, lod.base_vertex);
+			}
+		} else {
+			use_arena = false; //(too big to share a block, so keep buffers of its own)
+		}
+	}
+
+	if (in_arena()) {
+		if (uploaded < staged.size()) {
+			size_t count = send_staged_at(GL_ARRAY_BUFFER, buffer, size_t(arena.first_vertex) * Position.stride, staged, uploaded, *budget);
+			uploaded += count;
+			*budget -= count;
+			if (uploaded < staged.size()) return false;
+		}
+		size_t sent = uploaded - staged.size();
+		if (sent < staged_indices.size()) {
+			//(binding GL_ELEMENT_ARRAY_BUFFER changes the bound vertex array, so make sure none is bound)
+			glBindVertexArray(0);
+			size_t count = send_staged_at(GL_ELEMENT_ARRAY_BUFFER, index_buffer, arena.index_offset, staged_indices, sent, *budget);
+			uploaded += count;
+			*budget -= count;
+			if (sent + count < staged_indices.size()) return false;
+		}
 	} else {
+		if (buffer == 0 || uploaded < staged.size()) {
+			size_t count = send_staged(GL_ARRAY_BUFFER, &buffer, staged, uploaded, *budget);
+			uploaded += count;
+			*budget -= count;
+			if (buffer == 0 || uploaded < staged.size()) return false;
+		}
+
+		if (index_type != GL_NONE) {
+			size_t sent = uploaded - staged.size();
+			if (index_buffer == 0 || sent < staged_indices.size()) {
+				//(binding GL_ELEMENT_ARRAY_BUFFER changes the bound vertex array, so make sure none is bound)
+				glBindVertexArray(0);
+				size_t count = send_staged(GL_ELEMENT_ARRAY_BUFFER, &index_buffer, staged_indices, sent, *budget);
+				uploaded += count;
+				*budget -= count;
+				if (index_buffer == 0 || sent + count < staged_indices.size()) return false;
+			}
+		}
+	}
+
+	//release the CPU copy:
+	std::vector< char >().swap(staged);
+	std::vector< char >().swap(staged_indices);
+	uploaded = 0;
+	return true;
+}
+
+MeshBuffer::MeshBuffer(std::string const &filename, DeferUpload) {
+	if (!(filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct")) {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
+	PnctFile pnct;
+	read_pnct(filename, &pnct);
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	//keep vertex data for upload():
+	if (pnct.quantized) {
+		staged.resize(pnct.quantized_vertices.size() * sizeof(PnctQuantizedVertex));
+		if (!staged.empty()) std::memcpy(staged.data(), pnct.quantized_vertices.data(), staged.size());
 
-	{ //read index chunk, add to meshes:
-		struct IndexEntry {
-			uint32_t name_begin, name_end;
-			uint32_t vertex_begin, vertex_end;
-		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+		//store attrib locations:
+		Position = Attrib(4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PnctQuantizedVertex), offsetof(PnctQuantizedVertex, Position));
+		Normal = Attrib(2, GL_SHORT, GL_TRUE, sizeof(PnctQuantizedVertex), offsetof(PnctQuantizedVertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PnctQuantizedVertex), offsetof(PnctQuantizedVertex, Color));
+		TexCoord = Attrib(2, GL_HALF_FLOAT, GL_FALSE, sizeof(PnctQuantizedVertex), offsetof(PnctQuantizedVertex, TexCoord));
+	} else {
+		staged.resize(pnct.vertices.size() * sizeof(PnctVertex));
+		if (!staged.empty()) std::memcpy(staged.data(), pnct.vertices.data(), staged.size());
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		//store attrib locations:
+		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(PnctVertex), offsetof(PnctVertex, Position));
+		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(PnctVertex), offsetof(PnctVertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PnctVertex), offsetof(PnctVertex, Color));
+		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(PnctVertex), offsetof(PnctVertex, TexCoord));
+	}
 
-		for (auto const &entry : index) {
-			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-				throw std::runtime_error("index entry has out-of-range name begin/end");
-			}
-			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
-				throw std::runtime_error("index entry has out-of-range vertex start/count");
-			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
-			Mesh mesh;
-			mesh.type = GL_TRIANGLES;
+	//..and index data, at the size the file stored it:
+	if (pnct.index_size == 2) {
+		std::vector< uint16_t > indices16(pnct.indices.begin(), pnct.indices.end());
+		staged_indices.resize(indices16.size() * sizeof(uint16_t));
+		if (!staged_indices.empty()) std::memcpy(staged_indices.data(), indices16.data(), staged_indices.size());
+		index_type = GL_UNSIGNED_SHORT;
+	} else if (pnct.index_size == 4) {
+		staged_indices.resize(pnct.indices.size() * sizeof(uint32_t));
+		if (!staged_indices.empty()) std::memcpy(staged_indices.data(), pnct.indices.data(), staged_indices.size());
+		index_type = GL_UNSIGNED_INT;
+	}
+
+	//meshes in file order (read_pnct has already checked their ranges):
+	std::vector< std::pair< std::string, Mesh > > read_meshes;
+	read_meshes.reserve(pnct.meshes.size());
+	for (auto const &entry : pnct.meshes) {
+		Mesh mesh;
+		mesh.type = GL_TRIANGLES;
+		if (index_type == GL_NONE) {
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
-			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
-				mesh.min = glm::min(mesh.min, data[v].Position);
-				mesh.max = glm::max(mesh.max, data[v].Position);
-			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
-			}
+		} else {
+			mesh.start = entry.index_begin;
+			mesh.count = entry.index_end - entry.index_begin;
+			mesh.index_type = index_type;
+			mesh.base_vertex = GLint(entry.vertex_begin);
+		}
+		mesh.position_offset = entry.position_offset;
+		mesh.position_scale = entry.position_scale;
+		for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+			glm::vec3 position = pnct.position(entry, v);
+			mesh.min = glm::min(mesh.min, position);
+			mesh.max = glm::max(mesh.max, position);
+		}
+		read_meshes.emplace_back(entry.name, mesh);
+	}
+
+	for (auto const &m : read_meshes) {
+		bool inserted = meshes.insert(m).second;
+		if (!inserted) {
+			std::cerr << "WARNING: mesh name '" + m.first + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
 		}
 	}
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+	{ //gather "<name>.LOD<n>" meshes into levels of detail:
+		std::map< std::string, std::map< uint32_t, Mesh const * > > groups;
+		for (auto const &m : meshes) {
+			std::string const &name = m.first;
+			size_t dot = name.rfind(".LOD");
+			if (dot == std::string::npos || dot + 4 == name.size()) continue;
+			if (name.find_first_not_of("0123456789", dot + 4) != std::string::npos) continue;
+			groups[name.substr(0, dot)][uint32_t(std::stoul(name.substr(dot + 4)))] = &m.second;
+		}
+		for (auto const &group : groups) {
+			//levels should count up from LOD0:
+			std::vector< Mesh::LOD > lods;
+			Mesh combined;
+			for (auto const &level : group.second) {
+				if (level.first != lods.size()) {
+					std::cerr << "WARNING: mesh '" << group.first << "' in filename '" << filename << "' is missing LOD" << lods.size() << "; ignoring LOD" << level.first << " and up." << std::endl;
+					break;
+				}
+				//(levels are drawn with one set of position matrices, so quantized levels must share their scale)
+				Mesh const &first = *group.second.begin()->second;
+				if (level.second->position_offset != first.position_offset || level.second->position_scale != first.position_scale) {
+					std::cerr << "WARNING: mesh '" << group.first << "' in filename '" << filename << "' has LOD" << level.first << " quantized differently than LOD0; ignoring LOD" << level.first << " and up." << std::endl;
+					break;
+				}
+				lods.emplace_back();
+				lods.back().start = level.second->start;
+				lods.back().count = level.second->count;
+				lods.back().base_vertex = level.second->base_vertex;
+				//(bounds cover every level, since any of them may be drawn)
+				combined.min = glm::min(combined.min, level.second->min);
+				combined.max = glm::max(combined.max, level.second->max);
+			}
+			if (lods.size() < 2) continue;
+
+			Mesh const &lod0 = *group.second.begin()->second;
+			combined.type = lod0.type;
+			combined.start = lod0.start;
+			combined.count = lod0.count;
+			combined.index_type = lod0.index_type;
+			combined.base_vertex = lod0.base_vertex;
+			combined.position_offset = lod0.position_offset;
+			combined.position_scale = lod0.position_scale;
+			combined.lods = lods;
+			meshes[group.first + ".LOD0"] = combined;
+			meshes.insert(std::make_pair(group.first, combined)); //(doesn't replace a mesh that already has this name)
+		}
 	}
 
 	/* //DEBUG:
@@ -98,6 +273,114 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
+void MeshBuffer::optimize(bool report) {
+	if (index_type == GL_NONE) return; //(nothing to reorder in triangle soup)
+	if (buffer != 0) {
+		throw std::runtime_error("MeshBuffer::optimize() must be called before upload().");
+	}
+
+	uint32_t index_size = (index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+	auto get_index = [&](uint32_t i) -> uint32_t {
+		if (index_size == 2) {
+			uint16_t ret;
+			std::memcpy(&ret, staged_indices.data() + 2 * size_t(i), 2);
+			return ret;
+		} else {
+			uint32_t ret;
+			std::memcpy(&ret, staged_indices.data() + 4 * size_t(i), 4);
+			return ret;
+		}
+	};
+	auto set_index = [&](uint32_t i, uint32_t value) {
+		if (index_size == 2) {
+			uint16_t v = uint16_t(value);
+			std::memcpy(staged_indices.data() + 2 * size_t(i), &v, 2);
+		} else {
+			std::memcpy(staged_indices.data() + 4 * size_t(i), &value, 4);
+		}
+	};
+
+	//meshes that share vertices (by base_vertex), each with its distinct index ranges:
+	// (several names can refer to one range -- e.g., "name" and "name.LOD0")
+	struct Range {
+		std::string name;
+		GLuint start, count;
+	};
+	std::map< GLint, std::vector< Range > > groups;
+	std::map< GLint, Mesh const * > group_meshes;
+	for (auto const &m : meshes) {
+		if (m.second.index_type == GL_NONE || m.second.type != GL_TRIANGLES) continue;
+		std::vector< Range > &ranges = groups[m.second.base_vertex];
+		group_meshes.emplace(m.second.base_vertex, &m.second);
+		bool found = false;
+		for (auto const &r : ranges) found = found || (r.start == m.second.start && r.count == m.second.count);
+		if (!found) ranges.emplace_back(Range{ m.first, m.second.start, m.second.count });
+	}
+
+	//each group's vertices run up to the next group's first vertex (or the end of the buffer):
+	GLsizei stride = Position.stride;
+	uint32_t total = uint32_t(staged.size() / stride);
+	for (auto g = groups.begin(); g != groups.end(); ++g) {
+		uint32_t base = uint32_t(g->first);
+		auto next = std::next(g);
+		uint32_t vertex_count = (next == groups.end() ? total : uint32_t(next->first)) - base;
+		Mesh const &mesh = *group_meshes[g->first];
+
+		//object-space positions, for overdraw sorting:
+		std::vector< glm::vec3 > positions(vertex_count);
+		for (uint32_t v = 0; v < vertex_count; ++v) {
+			char const *at = staged.data() + size_t(base + v) * stride + Position.offset;
+			if (Position.type == GL_FLOAT) {
+				std::memcpy(&positions[v], at, sizeof(glm::vec3));
+			} else {
+				glm::u16vec4 q;
+				std::memcpy(&q, at, sizeof(q));
+				positions[v] = mesh.position_offset + mesh.position_scale * (glm::vec3(q) / 65535.0f);
+			}
+		}
+
+		//reorder each range's triangles:
+		std::vector< uint32_t > indices;
+		bool in_range = true;
+		for (auto const &r : g->second) {
+			std::vector< uint32_t > range;
+			range.reserve(r.count);
+			for (uint32_t i = r.start; i < r.start + r.count; ++i) {
+				range.emplace_back(get_index(i));
+				in_range = in_range && (range.back() < vertex_count);
+			}
+			if (!in_range) break;
+			VertexCacheStats before = analyze_vertex_cache(range, vertex_count);
+			optimize_vertex_cache(&range, vertex_count);
+			optimize_overdraw(&range, positions);
+			indices.insert(indices.end(), range.begin(), range.end());
+			if (report) {
+				VertexCacheStats after = analyze_vertex_cache(range, vertex_count);
+				std::cout << "Mesh '" << r.name << "': ACMR " << before.acmr << " -> " << after.acmr
+					<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+			}
+		}
+		if (!in_range) {
+			//(meshes whose vertices overlap some other mesh's are left alone)
+			std::cerr << "WARNING: not optimizing mesh '" << g->second[0].name << "' (and any others sharing its vertices), since its vertices overlap another mesh's." << std::endl;
+			continue;
+		}
+
+		//renumber the group's vertices in order of first use (over all of its ranges):
+		std::vector< uint32_t > remap = optimize_vertex_fetch(&indices, vertex_count);
+		std::vector< char > moved(size_t(vertex_count) * stride);
+		for (uint32_t v = 0; v < vertex_count; ++v) {
+			std::memcpy(moved.data() + size_t(remap[v]) * stride, staged.data() + size_t(base + v) * stride, stride);
+		}
+		std::copy(moved.begin(), moved.end(), staged.begin() + size_t(base) * stride);
+
+		uint32_t at = 0;
+		for (auto const &r : g->second) {
+			for (uint32_t i = r.start; i < r.start + r.count; ++i) set_index(i, indices[at++]);
+		}
+	}
+}
+
 const Mesh &MeshBuffer::lookup(std::string const &name) const {
 	auto f = meshes.find(name);
 	if (f == meshes.end()) {
@@ -106,7 +389,29 @@ const Mesh &MeshBuffer::lookup(std::string const &name) const {
 	return f->second;
 }
 
+void MeshBuffer::free_buffers() {
+	if (in_arena()) {
+		mesh_arena.free(this);
+		return;
+	}
+	if (buffer != 0) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+	if (index_buffer != 0) {
+		glDeleteBuffers(1, &index_buffer);
+		index_buffer = 0;
+	}
+}
+
 GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+	//buffers in the arena share their block's vertex array:
+	GLuint *shared = nullptr;
+	if (in_arena()) {
+		shared = &mesh_arena.blocks[arena.block].vaos[program];
+		if (*shared != 0) return *shared;
+	}
+
 	//create a new vertex array object:
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
@@ -128,6 +433,10 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//(element array binding is part of the vertex array object's state, so leave it bound)
+	// (an arena block's vertex array may also serve indexed buffers, even if this one isn't)
+	GLuint elements = (in_arena() ? mesh_arena.blocks[arena.block].index_buffer : index_buffer);
+	if (elements != 0) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elements);
 	glBindVertexArray(0);
 
 	//Check that all active attributes were bound:
@@ -146,5 +455,6 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 		}
 	}
 
+	if (shared) *shared = vao;
 	return vao;
 }
@@ -7,6 +7,25 @@
  *  a single OpenGL array buffer. Individual meshes can be looked up by name
  *  using the MeshBuffer::lookup() function.
  *
+ * A .pnct file is either triangle soup (chunks pnct, str0, idx0) or indexed
+ *  (chunks pnct, ix16 or ix32, str0, idx1), in which case each mesh's
+ *  vertices are welded and drawn through 16- or 32-bit indices that count
+ *  from the mesh's first vertex (see scenes/export-meshes.py).
+ *
+ * Either kind may instead be quantized (by quantize-meshes): the pnct chunk
+ *  becomes a pnq0 chunk of 20-byte vertices, and a qbx0 chunk after the
+ *  index gives each mesh's position offset and scale:
+ *  - positions are 16-bit fractions of the mesh's bounding box, with w = 0
+ *    (levels of detail share their group's box)
+ *  - normals are octahedral-encoded in two 16-bit snorms
+ *  - colors are unchanged, and texture coordinates are half-floats
+ *  Programs decode these with MeshBuffer::VertexGLSL; the position scale and
+ *  offset are folded into the object matrices by Scene::draw (see
+ *  Drawable::Pipeline::position_offset).
+ *
+ * (pnct_file.hpp reads and writes these files without OpenGL, for
+ *  MeshBuffer, OccluderMeshes, and the command-line tools)
+ *
  */
 
 #include "GL.hpp"
@@ -14,19 +33,40 @@
 #include <map>
 #include <limits>
 #include <string>
+#include <vector>
 
 
 struct Mesh {
 	//Meshes are vertex ranges (and primitive types) in their MeshBuffer:
 
 	GLenum type = GL_TRIANGLES; //type of primitives in mesh
-	GLuint start = 0; //index of first vertex
-	GLuint count = 0; //count of vertices
+	GLuint start = 0; //index of first vertex (or, for indexed meshes, of first index)
+	GLuint count = 0; //count of vertices (or indices)
+
+	//Indexed meshes are drawn with glDrawElementsBaseVertex:
+	GLenum index_type = GL_NONE; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for indexed meshes; GL_NONE draws vertices in order
+	GLint base_vertex = 0; //added to every index (the mesh's first vertex)
+
+	//Quantized meshes store positions as 'position_offset + position_scale * Position':
+	// (unquantized meshes leave these as the identity)
+	glm::vec3 position_offset = glm::vec3(0.0f);
+	glm::vec3 position_scale = glm::vec3(1.0f);
 
 	//Bounding box.
 	//useful for debug visualization and (perhaps, eventually) collision detection:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
 	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+	//Levels of detail, for meshes exported as "<name>.LOD0", "<name>.LOD1", ... (finest first):
+	// "<name>.LOD0" (and "<name>" itself, unless the file has a mesh by that name) draws LOD0 and lists
+	// every level here; other meshes (including the coarser levels, looked up by name) leave this empty
+	// (copy these into Scene::Drawable::lods to have Scene::draw pick one by size on screen)
+	struct LOD {
+		GLuint start = 0;
+		GLuint count = 0;
+		GLint base_vertex = 0;
+	};
+	std::vector< LOD > lods;
 };
 
 struct MeshBuffer {
@@ -34,19 +74,69 @@ struct MeshBuffer {
 	// note: will throw if file fails to read.
 	MeshBuffer(std::string const &filename);
 
+	//..or in two steps, so that the file can be read on a background thread (see LevelStreamer.hpp):
+	// the DeferUpload constructor reads the file but keeps vertex data in 'staged' (and 'staged_indices') instead of creating 'buffer';
+	// upload() then creates 'buffer' (and 'index_buffer') from (and frees) the staged data, and must be called on the GL thread.
+	struct DeferUpload { };
+	MeshBuffer(std::string const &filename, DeferUpload);
+	void upload();
+	//..or upload() a piece at a time (see MeshLoader.hpp): sends at most *budget bytes (taking them off *budget);
+	// returns true once everything is sent, at which point the buffers are ready and the staged data is freed
+	bool upload_some(size_t *budget);
+
+	//optionally, between the two: reorder indexed meshes' triangles and vertices so they draw faster (see optimize_mesh.hpp)
+	// -- the same as scenes/optimize-meshes does offline, but costing load time (so files are better optimized ahead of time);
+	// safe to call on a background thread; 'report' prints each mesh's cache miss ratios before and after
+	void optimize(bool report = false);
+
+	//..and/or set this to have upload() put the data in the shared mesh arena (see MeshArena.hpp) rather than buffers of its own:
+	// 'buffer' and 'index_buffer' are then the arena block's, and upload() offsets every mesh's range to match
+	// (so look meshes up after uploading); cleared by upload() if the data doesn't fit in a block
+	bool use_arena = false;
+
+	//delete 'buffer' and 'index_buffer' -- or, for buffers in the arena, give their space back:
+	// (vertex arrays from make_vao_for_program() are the caller's to delete, except arena ones; see there)
+	void free_buffers();
+
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
 	const Mesh &lookup(std::string const &name) const;
 	
 	//build a vertex array object that links this vbo to attributes to a program:
+	// (for indexed files, the vertex array also binds 'index_buffer' as its element array)
+	// (for buffers in the arena, this is the arena block's vertex array for 'program', shared with every other buffer
+	//  in the block and owned by the arena -- don't delete it)
 	// note: will throw if program defines attributes not contained in this buffer
 	GLuint make_vao_for_program(GLuint program) const;
 
+	//GLSL for vertex shaders reading a MeshBuffer's 'Position' (vec4) and 'Normal' (vec3) attributes:
+	// defines mesh_position(Position) and mesh_normal(Position, Normal), which work for both plain and quantized buffers
+	// (quantized positions come out as fractions of the mesh's bounds; see above)
+	static std::string const VertexGLSL;
+
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
+	//..and, for indexed files, the element buffer holding the indices:
+	GLuint index_buffer = 0;
+	GLenum index_type = GL_NONE; //GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, or (not indexed) GL_NONE
 
 	//-- internals ---
 
+	//vertex (and index) data waiting for upload():
+	std::vector< char > staged;
+	std::vector< char > staged_indices;
+	size_t uploaded = 0; //bytes of 'staged' (and then 'staged_indices') sent by upload_some() so far
+
+	//where this buffer's data sits in the mesh arena (if it does):
+	struct ArenaRange {
+		uint32_t block = -1U; //index in mesh_arena.blocks (-1U if not in the arena)
+		uint32_t first_vertex = 0, vertex_count = 0;
+		uint32_t index_offset = 0; //in bytes
+		uint32_t index_units = 0; //(see MeshArena::IndexAlign)
+	};
+	ArenaRange arena;
+	bool in_arena() const { return arena.block != -1U; }
+
 	//used by the lookup() function:
 	std::map< std::string, Mesh > meshes;
 
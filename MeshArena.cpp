@@ -0,0 +1,157 @@
+#include "MeshArena.hpp"
+
+#include "gl_errors.hpp"
+
+#include <cassert>
+#include <iterator>
+
+MeshArena mesh_arena;
+
+void MeshArena::FreeList::reset(uint32_t capacity_) {
+	capacity = capacity_;
+	free.clear();
+	if (capacity != 0) free.emplace(0, capacity);
+	used = 0;
+}
+
+uint32_t MeshArena::FreeList::allocate(uint32_t size) {
+	if (size == 0) return 0;
+	for (auto f = free.begin(); f != free.end(); ++f) {
+		if (f->second < size) continue;
+		uint32_t offset = f->first;
+		uint32_t left = f->second - size;
+		free.erase(f);
+		if (left != 0) free.emplace(offset + size, left);
+		used += size;
+		return offset;
+	}
+	return -1U;
+}
+
+void MeshArena::FreeList::release(uint32_t offset, uint32_t size) {
+	if (size == 0) return;
+	assert(offset + size <= capacity);
+	assert(used >= size);
+	used -= size;
+
+	auto next = free.lower_bound(offset);
+	assert(next == free.end() || next->first >= offset + size); //(not already free)
+	//merge with the free range just after:
+	if (next != free.end() && next->first == offset + size) {
+		size += next->second;
+		next = free.erase(next);
+	}
+	//..and the one just before:
+	if (next != free.begin()) {
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= offset);
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+	free.emplace(offset, size);
+}
+
+//-------------------------
+
+static bool same_attrib(MeshBuffer::Attrib const &a, MeshBuffer::Attrib const &b) {
+	return a.size == b.size && a.type == b.type && a.normalized == b.normalized && a.stride == b.stride && a.offset == b.offset;
+}
+
+bool MeshArena::allocate(MeshBuffer *buffer) {
+	assert(buffer);
+	assert(!buffer->in_arena() && buffer->buffer == 0);
+	assert(buffer->Position.stride > 0);
+
+	size_t stride = size_t(buffer->Position.stride);
+	assert(buffer->staged.size() % stride == 0);
+	uint32_t vertex_count = uint32_t(buffer->staged.size() / stride);
+	uint32_t index_units = uint32_t((buffer->staged_indices.size() + IndexAlign - 1) / IndexAlign);
+	if (size_t(vertex_count) > block_vertex_bytes / stride || size_t(index_units) > block_index_bytes / IndexAlign) {
+		return false;
+	}
+
+	auto try_block = [&](uint32_t b) {
+		Block &block = blocks[b];
+		if (!(same_attrib(block.Position, buffer->Position) && same_attrib(block.Normal, buffer->Normal)
+		 && same_attrib(block.Color, buffer->Color) && same_attrib(block.TexCoord, buffer->TexCoord))) return false;
+		uint32_t first_vertex = block.vertices.allocate(vertex_count);
+		if (first_vertex == -1U) return false;
+		uint32_t first_index = block.indices.allocate(index_units);
+		if (first_index == -1U) {
+			block.vertices.release(first_vertex, vertex_count);
+			return false;
+		}
+
+		buffer->arena.block = b;
+		buffer->arena.first_vertex = first_vertex;
+		buffer->arena.vertex_count = vertex_count;
+		buffer->arena.index_offset = first_index * IndexAlign;
+		buffer->arena.index_units = index_units;
+		buffer->buffer = block.vertex_buffer;
+		buffer->index_buffer = (buffer->index_type != GL_NONE ? block.index_buffer : 0);
+		return true;
+	};
+
+	for (uint32_t b = 0; b < uint32_t(blocks.size()); ++b) {
+		if (try_block(b)) return true;
+	}
+
+	//no room anywhere, so add a block for this format:
+	blocks.emplace_back();
+	Block &block = blocks.back();
+	block.Position = buffer->Position;
+	block.Normal = buffer->Normal;
+	block.Color = buffer->Color;
+	block.TexCoord = buffer->TexCoord;
+	block.vertices.reset(uint32_t(block_vertex_bytes / stride));
+	block.indices.reset(uint32_t(block_index_bytes / IndexAlign));
+
+	glGenBuffers(1, &block.vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, block.vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, size_t(block.vertices.capacity) * stride, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//(binding GL_ELEMENT_ARRAY_BUFFER changes the bound vertex array, so make sure none is bound)
+	glBindVertexArray(0);
+	glGenBuffers(1, &block.index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size_t(block.indices.capacity) * IndexAlign, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	GL_ERRORS();
+
+	bool fit = try_block(uint32_t(blocks.size()) - 1);
+	assert(fit);
+	return fit;
+}
+
+void MeshArena::free(MeshBuffer *buffer) {
+	assert(buffer);
+	if (!buffer->in_arena()) return;
+	assert(buffer->arena.block < blocks.size());
+	Block &block = blocks[buffer->arena.block];
+	block.vertices.release(buffer->arena.first_vertex, buffer->arena.vertex_count);
+	block.indices.release(buffer->arena.index_offset / IndexAlign, buffer->arena.index_units);
+
+	buffer->arena = MeshBuffer::ArenaRange();
+	buffer->buffer = 0;
+	buffer->index_buffer = 0;
+}
+
+size_t MeshArena::used_bytes() const {
+	size_t total = 0;
+	for (auto const &block : blocks) {
+		total += size_t(block.vertices.used) * size_t(block.Position.stride) + size_t(block.indices.used) * IndexAlign;
+	}
+	return total;
+}
+
+size_t MeshArena::capacity_bytes() const {
+	size_t total = 0;
+	for (auto const &block : blocks) {
+		total += size_t(block.vertices.capacity) * size_t(block.Position.stride) + size_t(block.indices.capacity) * IndexAlign;
+	}
+	return total;
+}
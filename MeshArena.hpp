@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+ * MeshArena packs MeshBuffers into a few big shared GL buffers ("blocks"),
+ *  instead of each file getting a vertex buffer (and vertex array) of its
+ *  own. Every MeshBuffer in a block shares the block's vertex array for a
+ *  given program, so drawing meshes from different files -- the resident
+ *  level and its streamed cells, say -- doesn't re-bind vertex arrays, and
+ *  Scene::draw can batch their draws (see Scene::DrawBatch).
+ *
+ * Each block holds one vertex format (plain or quantized; see Mesh.hpp) and
+ *  has a vertex buffer of block_vertex_bytes and an index buffer of
+ *  block_index_bytes; both are handed out first-fit from free lists, and
+ *  freed ranges merge with their free neighbours. Blocks are added as
+ *  needed and kept (empty or not) until the program exits, so streaming
+ *  cells in and out re-uses space rather than creating and deleting
+ *  buffers.
+ *
+ * MeshBuffers opt in by setting 'use_arena' before upload (LevelStreamer
+ *  and MeshLoader do this); a MeshBuffer too big for an empty block keeps
+ *  buffers of its own.
+ *
+ * Use from the main (GL) thread only.
+ *
+ */
+
+#include "Mesh.hpp"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+struct MeshArena {
+	//size of each block's buffers:
+	size_t block_vertex_bytes = 16 << 20;
+	size_t block_index_bytes = 4 << 20;
+
+	//find space for 'buffer' (its staged vertex and index data) in a block of its vertex format, adding a block if none has room:
+	// sets buffer->arena, buffer->buffer, and buffer->index_buffer; returns false (changing nothing) if the buffer is too big for a block
+	bool allocate(MeshBuffer *buffer);
+
+	//give back 'buffer's space (and clear buffer->arena, buffer->buffer, and buffer->index_buffer):
+	void free(MeshBuffer *buffer);
+
+	//bytes in use (and allocated for blocks) over all blocks:
+	size_t used_bytes() const;
+	size_t capacity_bytes() const;
+
+	//-- internals --
+
+	//first-fit allocator over [0, capacity) units:
+	struct FreeList {
+		uint32_t capacity = 0;
+		std::map< uint32_t, uint32_t > free; //offset -> size of each free range (free ranges never touch)
+		uint32_t used = 0;
+
+		void reset(uint32_t capacity);
+		//returns the offset of 'size' free units (or -1U if there is no free range that big):
+		uint32_t allocate(uint32_t size);
+		void release(uint32_t offset, uint32_t size);
+	};
+
+	struct Block {
+		//vertex format of everything in the block:
+		MeshBuffer::Attrib Position, Normal, Color, TexCoord;
+		GLuint vertex_buffer = 0;
+		GLuint index_buffer = 0;
+		FreeList vertices; //in vertices
+		FreeList indices; //in IndexAlign-byte units
+		std::map< GLuint, GLuint > vaos; //program -> vertex array shared by the block's buffers (see MeshBuffer::make_vao_for_program)
+	};
+	std::vector< Block > blocks;
+
+	//index ranges start on multiples of this, so both 16- and 32-bit indices can share an index buffer:
+	enum : uint32_t { IndexAlign = 4 };
+};
+
+extern MeshArena mesh_arena;
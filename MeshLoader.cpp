@@ -0,0 +1,122 @@
+#include "MeshLoader.hpp"
+
+#include "AssetCache.hpp"
+
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+MeshLoader mesh_loader;
+
+MeshLoader::~MeshLoader() {
+	if (!loader.joinable()) return;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	loader.join();
+}
+
+void MeshLoader::load(std::string const &filename, std::function< void(std::shared_ptr< MeshBuffer const > const &) > const &ready) {
+	jobs.emplace_back(new Job);
+	jobs.back()->filename = filename;
+	jobs.back()->ready = ready;
+	jobs.back()->use_arena = use_arena;
+
+	//already loaded, or on its way?
+	Job &job = *jobs.back();
+	std::string path = AssetCache::canonical_path(filename);
+	job.shared = assets.find_meshes(path);
+	job.reuse = (job.shared != nullptr);
+	for (size_t i = 0; i + 1 < jobs.size() && !job.reuse; ++i) {
+		if (AssetCache::canonical_path(jobs[i]->filename) == path) job.reuse = true;
+	}
+	if (job.reuse) {
+		job.read = true; //(nothing for the loader thread to do)
+		return;
+	}
+
+	if (!loader.joinable()) loader = std::thread(&MeshLoader::loader_main, this);
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		to_read.emplace_back(&job);
+	}
+	wake.notify_one();
+}
+
+void MeshLoader::loader_main() {
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		wake.wait(lock, [this]() { return quit || !to_read.empty(); });
+		if (quit) break;
+		Job &job = *to_read.front();
+		to_read.pop_front();
+
+		//read without holding the lock (the main thread leaves unread jobs alone):
+		lock.unlock();
+		try {
+			job.buffer.reset(new MeshBuffer(job.filename, MeshBuffer::DeferUpload()));
+			job.buffer->use_arena = job.use_arena;
+		} catch (std::exception &e) {
+			job.error = e.what();
+		}
+		lock.lock();
+
+		job.read = true;
+		done.notify_all();
+	}
+}
+
+void MeshLoader::update() {
+	upload(upload_budget);
+}
+
+void MeshLoader::finish() {
+	while (!jobs.empty()) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			done.wait(lock, [this]() { return jobs.front()->read; });
+		}
+		upload(std::numeric_limits< size_t >::max());
+	}
+}
+
+void MeshLoader::upload(size_t budget) {
+	while (!jobs.empty()) {
+		Job &job = *jobs.front();
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			if (!job.read) return;
+		}
+
+		if (job.reuse && !job.shared) {
+			//(the earlier job for this file has finished by now, so it's in the cache -- unless it failed)
+			job.shared = assets.find_meshes(job.filename);
+			if (!job.shared) job.error = "an earlier load of the same file failed";
+		}
+
+		if (!job.error.empty()) {
+			std::string message = "Failed to load '" + job.filename + "': " + job.error;
+			jobs.pop_front();
+			throw std::runtime_error(message);
+		}
+
+		if (!job.reuse) {
+			if (!job.buffer->upload_some(&budget)) {
+				assert(budget == 0);
+				return;
+			}
+			//finished; cache and keep the buffer:
+			job.shared = assets.add_meshes(job.filename, std::move(job.buffer));
+			loaded.emplace_back(job.shared);
+		}
+
+		//let the file's users at it:
+		std::shared_ptr< MeshBuffer const > buffer = std::move(job.shared);
+		std::function< void(std::shared_ptr< MeshBuffer const > const &) > ready = std::move(job.ready);
+		jobs.pop_front();
+		ready(buffer);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+ * MeshLoader loads MeshBuffers in the background, so that big mesh files
+ *  don't hold up the first frame.
+ *
+ * load() queues a file. A loader thread reads it -- file reads, validation,
+ *  and bounding boxes; everything in the MeshBuffer DeferUpload constructor
+ *  -- and update(), called by the main loop once per frame, sends what has
+ *  been read to GL, at most upload_budget bytes per frame (so one big file
+ *  is spread over several frames). Once a file's buffers are complete, its
+ *  'ready' function is called on the main thread; files become ready in the
+ *  order they were queued.
+ *
+ * So, for a mesh file needed by a mode that starts later (e.g., after the
+ *  intro and splash screens), a load function can queue the file and set
+ *  up whatever depends on it -- vertex arrays, scenes -- in 'ready':
+ *
+ *   MeshBuffer const *level_meshes = nullptr;
+ *   Load< void > load_level_meshes(LoadTagDefault, [](){
+ *       mesh_loader.load(data_path("level.pnct"), [](std::shared_ptr< MeshBuffer const > const &buffer){
+ *           level_meshes = buffer.get();
+ *           ...
+ *       });
+ *   });
+ *
+ * ..and the mode calls finish() before using them, which waits for (and
+ *  uploads) anything still outstanding.
+ *
+ * Loaded buffers go into the asset cache (see AssetCache.hpp) and are kept
+ *  until the program exits (like Load<> values). A file that is already
+ *  cached, or already queued, isn't read again: its 'ready' gets the same
+ *  buffer (still in queue order). Read errors are thrown from update() or
+ *  finish(), on the main thread.
+ *
+ */
+
+#include "Mesh.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MeshLoader {
+	MeshLoader() = default;
+	~MeshLoader();
+
+	//queue 'filename' for loading; 'ready' is called (on the main thread) once it is uploaded:
+	void load(std::string const &filename, std::function< void(std::shared_ptr< MeshBuffer const > const &) > const &ready);
+
+	//bytes of vertex and index data sent to GL per update():
+	size_t upload_budget = 4 << 20;
+
+	//upload into the shared mesh arena (see MeshArena.hpp), so loaded files share vertex arrays with each other and with streamed level cells:
+	// (applies to files queued after it is set)
+	bool use_arena = true;
+
+	//upload what has been read (within upload_budget) and call 'ready' for finished files:
+	// (call once per frame, on the GL thread)
+	void update();
+
+	//wait for everything queued so far to be read and uploaded:
+	void finish();
+
+	//is anything queued, being read, or being uploaded?
+	bool busy() const { return !jobs.empty(); }
+
+	//-- internals --
+	struct Job {
+		std::string filename;
+		std::function< void(std::shared_ptr< MeshBuffer const > const &) > ready;
+		bool use_arena = true;
+		//set by load() if the file is cached or queued by an earlier job (which will have cached it by the time this job is up):
+		bool reuse = false;
+		std::shared_ptr< MeshBuffer const > shared;
+		//written by the loader thread (under 'mutex' for 'read'):
+		std::unique_ptr< MeshBuffer > buffer;
+		std::string error; //set if reading failed
+		bool read = false;
+	};
+	std::deque< std::unique_ptr< Job > > jobs; //in load() order; only the main thread adds or removes jobs
+	std::vector< std::shared_ptr< MeshBuffer const > > loaded;
+
+	//loader thread (started by the first load()) and its queue of jobs to read:
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake; //signalled when jobs are queued (or the loader should quit)
+	std::condition_variable done; //signalled when the loader finishes reading a job
+	std::deque< Job * > to_read;
+	bool quit = false;
+	void loader_main();
+
+	void upload(size_t budget); //upload finished jobs, front to back, until out of budget or the front job isn't read yet
+};
+
+extern MeshLoader mesh_loader;
@@ -0,0 +1,276 @@
+#include "OcclusionBuffer.hpp"
+
+#include "pnct_file.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+//triangles and boxes closer than this (in clip-space w) are treated as reaching behind the camera:
+static constexpr float MinW = 1e-4f;
+
+static bool is_power_of_two(uint32_t x) {
+	return x != 0 && (x & (x - 1)) == 0;
+}
+
+static uint32_t log2_of_power_of_two(uint32_t x) {
+	uint32_t log = 0;
+	while (x > 1) {
+		x >>= 1;
+		log += 1;
+	}
+	return log;
+}
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width_, uint32_t height_) : width(width_), height(height_) {
+	//(rows are rasterized four pixels at a time, so they need to be at least that wide)
+	if (!is_power_of_two(width) || !is_power_of_two(height) || width < 4) {
+		throw std::runtime_error("OcclusionBuffer size " + std::to_string(width) + "x" + std::to_string(height) + " should be powers of two (and at least 4 wide).");
+	}
+
+	uint32_t w = width, h = height;
+	while (true) {
+		levels.emplace_back();
+		levels.back().width = w;
+		levels.back().height = h;
+		levels.back().depth.assign(w * h, 0.0f);
+		if (w == 1 && h == 1) break;
+		w = std::max(1U, w / 2);
+		h = std::max(1U, h / 2);
+	}
+}
+
+void OcclusionBuffer::render(glm::mat4 const &world_to_clip_) {
+	clear(world_to_clip_);
+	for (auto const &occluder : occluders) {
+		assert(occluder.transform && occluder.triangles);
+		if (!occluder.transform->include) continue;
+		rasterize(world_to_clip * glm::mat4(occluder.transform->make_local_to_world()), *occluder.triangles);
+	}
+	build_hiz();
+}
+
+void OcclusionBuffer::clear(glm::mat4 const &world_to_clip_) {
+	world_to_clip = world_to_clip_;
+	std::fill(levels[0].depth.begin(), levels[0].depth.end(), 0.0f);
+	stats = Stats();
+}
+
+void OcclusionBuffer::rasterize(glm::mat4 const &object_to_clip, std::vector< glm::vec3 > const &triangles) {
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+		rasterize_triangle(
+			object_to_clip * glm::vec4(triangles[i+0], 1.0f),
+			object_to_clip * glm::vec4(triangles[i+1], 1.0f),
+			object_to_clip * glm::vec4(triangles[i+2], 1.0f)
+		);
+	}
+}
+
+void OcclusionBuffer::rasterize_triangle(glm::vec4 const &a_clip, glm::vec4 const &b_clip, glm::vec4 const &c_clip) {
+	//no near-plane clipping; just leave out triangles that reach behind the camera:
+	// (drawing less than the occluders cover is always safe -- it only hides less)
+	if (a_clip.w < MinW || b_clip.w < MinW || c_clip.w < MinW) {
+		stats.skipped += 1;
+		return;
+	}
+
+	//to pixel coordinates (x, y) and depth (1/w):
+	auto to_screen = [this](glm::vec4 const &clip) {
+		float inv_w = 1.0f / clip.w;
+		return glm::vec3(
+			(clip.x * inv_w * 0.5f + 0.5f) * float(width),
+			(clip.y * inv_w * 0.5f + 0.5f) * float(height),
+			inv_w
+		);
+	};
+	glm::vec3 a = to_screen(a_clip);
+	glm::vec3 b = to_screen(b_clip);
+	glm::vec3 c = to_screen(c_clip);
+
+	//twice the signed area; make the winding counterclockwise so insides are positive:
+	// (occluders are drawn two-sided)
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area < 0.0f) {
+		std::swap(b, c);
+		area = -area;
+	}
+	if (!(area > 1e-8f)) return; //degenerate (or NaN)
+
+	//pixels (by center) covered by the triangle's bounding rectangle:
+	float min_x = std::min(a.x, std::min(b.x, c.x));
+	float max_x = std::max(a.x, std::max(b.x, c.x));
+	float min_y = std::min(a.y, std::min(b.y, c.y));
+	float max_y = std::max(a.y, std::max(b.y, c.y));
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= float(width) || min_y >= float(height)) return; //off-screen
+	int32_t x0 = std::max(0, int32_t(std::floor(min_x)));
+	int32_t x1 = std::min(int32_t(width), int32_t(std::ceil(max_x)));
+	int32_t y0 = std::max(0, int32_t(std::floor(min_y)));
+	int32_t y1 = std::min(int32_t(height), int32_t(std::ceil(max_y)));
+	x0 &= ~3; //(start at a multiple of four, so four-pixel steps stay within the row)
+
+	stats.triangles += 1;
+
+	//edge functions, as e(x,y) = A * x + B * y + C, positive inside; e0 is the edge opposite a, and so on:
+	auto edge = [](glm::vec3 const &p, glm::vec3 const &q) {
+		float A = p.y - q.y;
+		float B = q.x - p.x;
+		return glm::vec3(A, B, -(A * p.x + B * p.y));
+	};
+	glm::vec3 e0 = edge(b, c);
+	glm::vec3 e1 = edge(c, a);
+	glm::vec3 e2 = edge(a, b);
+	//depth is linear in screen space (weights are e0 / area, e1 / area, e2 / area):
+	glm::vec3 z = (e0 * a.z + e1 * b.z + e2 * c.z) / area;
+
+	std::vector< float > &depth = levels[0].depth;
+
+	for (int32_t y = y0; y < y1; ++y) {
+		float py = float(y) + 0.5f;
+		float *row = depth.data() + size_t(y) * width;
+		//(the y part of each function is the same across the row)
+		float row_e0 = e0.y * py + e0.z;
+		float row_e1 = e1.y * py + e1.z;
+		float row_e2 = e2.y * py + e2.z;
+		float row_z = z.y * py + z.z;
+
+		int32_t x = x0;
+
+		#ifdef OCCLUSION_SSE
+		//four pixels at a time:
+		__m128 A0 = _mm_set1_ps(e0.x), A1 = _mm_set1_ps(e1.x), A2 = _mm_set1_ps(e2.x), AZ = _mm_set1_ps(z.x);
+		__m128 R0 = _mm_set1_ps(row_e0), R1 = _mm_set1_ps(row_e1), R2 = _mm_set1_ps(row_e2), RZ = _mm_set1_ps(row_z);
+		__m128 zero = _mm_setzero_ps();
+		__m128 centers = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		for (; x < x1; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), centers);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(A0, px), R0), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(A1, px), R1), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(A2, px), R2), zero));
+			if (_mm_movemask_ps(inside) == 0) continue;
+			__m128 pz = _mm_add_ps(_mm_mul_ps(AZ, px), RZ);
+			__m128 old_z = _mm_loadu_ps(row + x);
+			__m128 new_z = _mm_max_ps(old_z, pz); //(keep the nearer depth)
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+		}
+		#endif
+
+		//remaining pixels (or all of them, without SSE):
+		for (; x < x1; ++x) {
+			float px = float(x) + 0.5f;
+			if (e0.x * px + row_e0 < 0.0f) continue;
+			if (e1.x * px + row_e1 < 0.0f) continue;
+			if (e2.x * px + row_e2 < 0.0f) continue;
+			row[x] = std::max(row[x], z.x * px + row_z);
+		}
+	}
+}
+
+void OcclusionBuffer::build_hiz() {
+	//each texel keeps the farthest (smallest 1/w) of the (up to) 2x2 texels below it:
+	for (size_t l = 1; l < levels.size(); ++l) {
+		Level const &from = levels[l-1];
+		Level &to = levels[l];
+		uint32_t step_x = (from.width > 1 ? 2 : 1);
+		uint32_t step_y = (from.height > 1 ? 2 : 1);
+		for (uint32_t y = 0; y < to.height; ++y) {
+			float const *row0 = from.depth.data() + size_t(y * step_y) * from.width;
+			float const *row1 = from.depth.data() + size_t(y * step_y + step_y - 1) * from.width;
+			for (uint32_t x = 0; x < to.width; ++x) {
+				uint32_t fx0 = x * step_x, fx1 = x * step_x + step_x - 1;
+				to.depth[size_t(y) * to.width + x] = std::min(std::min(row0[fx0], row0[fx1]), std::min(row1[fx0], row1[fx1]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::box_occluded(glm::vec3 const &center, glm::vec3 const &radius) const {
+	//screen rectangle and nearest depth of the box's corners:
+	float min_x = std::numeric_limits< float >::infinity();
+	float max_x = -std::numeric_limits< float >::infinity();
+	float min_y = std::numeric_limits< float >::infinity();
+	float max_y = -std::numeric_limits< float >::infinity();
+	float nearest = 0.0f; //(as 1/w)
+	for (uint32_t i = 0; i < 8; ++i) {
+		glm::vec3 corner = center + glm::vec3(
+			(i & 1 ? radius.x : -radius.x),
+			(i & 2 ? radius.y : -radius.y),
+			(i & 4 ? radius.z : -radius.z)
+		);
+		glm::vec4 clip = world_to_clip * glm::vec4(corner, 1.0f);
+		if (clip.w < MinW) return false; //reaches behind the camera
+		float inv_w = 1.0f / clip.w;
+		float x = (clip.x * inv_w * 0.5f + 0.5f) * float(width);
+		float y = (clip.y * inv_w * 0.5f + 0.5f) * float(height);
+		min_x = std::min(min_x, x); max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y); max_y = std::max(max_y, y);
+		nearest = std::max(nearest, inv_w);
+	}
+
+	//leave boxes that reach past the edges of the screen to frustum culling:
+	if (min_x < 0.0f || min_y < 0.0f || max_x >= float(width) || max_y >= float(height)) return false;
+	uint32_t x0 = uint32_t(min_x), x1 = uint32_t(max_x);
+	uint32_t y0 = uint32_t(min_y), y1 = uint32_t(max_y);
+
+	//pick the level where the rectangle is a texel or two across:
+	uint32_t span = std::max(x1 - x0, y1 - y0);
+	uint32_t l = 0;
+	while (span > 1 && l + 1 < levels.size()) {
+		span >>= 1;
+		l += 1;
+	}
+
+	//hidden only if every texel the rectangle touches has an occluder in front of the box's nearest point:
+	Level const &level = levels[l];
+	uint32_t shift_x = log2_of_power_of_two(width / level.width);
+	uint32_t shift_y = log2_of_power_of_two(height / level.height);
+	for (uint32_t y = y0 >> shift_y; y <= (y1 >> shift_y); ++y) {
+		for (uint32_t x = x0 >> shift_x; x <= (x1 >> shift_x); ++x) {
+			if (!(level.depth[size_t(y) * level.width + x] > nearest)) return false;
+		}
+	}
+	return true;
+}
+
+//-------------------------
+
+OccluderMeshes::OccluderMeshes(std::string const &filename) {
+	if (!(filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct")) {
+		throw std::runtime_error("Unknown file type '" + filename + "'");
+	}
+	PnctFile pnct;
+	read_pnct(filename, &pnct);
+
+	//only positions are kept, with indexed meshes expanded back into triangle lists:
+	for (auto const &entry : pnct.meshes) {
+		std::vector< glm::vec3 > positions;
+		if (pnct.indexed()) {
+			positions.reserve(entry.index_end - entry.index_begin);
+			for (uint32_t i = entry.index_begin; i < entry.index_end; ++i) {
+				positions.emplace_back(pnct.position(entry, entry.vertex_begin + pnct.indices[i]));
+			}
+		} else {
+			positions.reserve(entry.vertex_end - entry.vertex_begin);
+			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+				positions.emplace_back(pnct.position(entry, v));
+			}
+		}
+		if (!meshes.emplace(entry.name, std::move(positions)).second) {
+			std::cerr << "WARNING: mesh name '" + entry.name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+		}
+	}
+}
+
+std::vector< glm::vec3 > const &OccluderMeshes::lookup(std::string const &name) const {
+	auto f = meshes.find(name);
+	if (f == meshes.end()) {
+		throw std::runtime_error("Looking up occluder mesh '" + name + "' that doesn't exist.");
+	}
+	return f->second;
+}
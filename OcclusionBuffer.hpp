@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * OcclusionBuffer is a small software depth buffer used to skip drawables
+ *  that are hidden behind big things (houses, fences, walls).
+ *
+ * Each frame (see Scene::draw):
+ *  - render() rasterizes a few occluder meshes -- usually cheap, simplified
+ *    stand-ins for the big things -- into a low-resolution depth buffer
+ *    (on the CPU, four pixels at a time with SSE, where available)
+ *  - build_hiz() reduces that buffer to a "hierarchical-Z" pyramid, where
+ *    each texel holds the farthest depth of the pixels below it
+ *  - box_occluded() tests a world-space box against a few texels of the
+ *    pyramid level where the box's screen rectangle is about a texel wide
+ *
+ * Depth is stored as 1/w (w being the distance in front of the camera), so
+ *  larger is nearer and empty pixels (0) are infinitely far away; this also
+ *  interpolates linearly across a triangle in screen space and copes with
+ *  the infinite far plane of Camera::make_projection.
+ *
+ * Nothing here touches OpenGL.
+ *
+ */
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct OcclusionBuffer {
+	//depth buffer size (powers of two); pyramid levels halve it down to 1x1:
+	// note: will throw if the size isn't a power of two
+	OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+	//occluders drawn by render(): triangle list positions (three per triangle) in the space of 'transform':
+	// (for instance scenes, use the transform actually in effect -- see Scene::resolve)
+	struct Occluder {
+		Scene::Transform const *transform = nullptr;
+		std::vector< glm::vec3 > const *triangles = nullptr;
+	};
+	std::vector< Occluder > occluders;
+
+	//clear, rasterize all occluders as seen through 'world_to_clip', and build the pyramid:
+	// (transforms' world matrices should be current -- see Scene::update_world_matrices)
+	void render(glm::mat4 const &world_to_clip);
+
+	//the steps of render(), for drawing other things (or testing without a Scene):
+	void clear(glm::mat4 const &world_to_clip); //empty the buffer, and remember the view for box_occluded()
+	void rasterize(glm::mat4 const &object_to_clip, std::vector< glm::vec3 > const &triangles);
+	void build_hiz();
+
+	//is the world-space box (center +/- radius) certainly hidden behind occluders drawn since clear()?
+	// (conservative -- boxes that reach behind the camera or off-screen are never reported hidden)
+	// safe to call from several threads at once (it only reads)
+	bool box_occluded(glm::vec3 const &center, glm::vec3 const &radius) const;
+
+	//counts from the most recent render():
+	struct Stats {
+		uint32_t triangles = 0; //triangles rasterized
+		uint32_t skipped = 0; //triangles skipped because they reach behind the near plane
+	} stats;
+
+	//-- internals --
+	uint32_t width, height;
+	glm::mat4 world_to_clip = glm::mat4(1.0f); //from the most recent clear() (used by box_occluded)
+	//depth (as 1/w) per pixel of each level; levels[0] is the full-resolution buffer:
+	struct Level {
+		uint32_t width, height;
+		std::vector< float > depth;
+	};
+	std::vector< Level > levels;
+	void rasterize_triangle(glm::vec4 const &a, glm::vec4 const &b, glm::vec4 const &c);
+};
+
+//Occluder geometry is read from a .pnct file (positions only, so nothing is uploaded to OpenGL):
+struct OccluderMeshes {
+	//note: will throw if file fails to read.
+	OccluderMeshes(std::string const &filename);
+
+	//triangle list positions of a mesh, by name:
+	// note: will throw if mesh not found.
+	std::vector< glm::vec3 > const &lookup(std::string const &name) const;
+
+	std::map< std::string, std::vector< glm::vec3 > > meshes;
+};
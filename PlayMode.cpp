@@ -1,6 +1,7 @@
 #include "PlayMode.hpp"
 
 #include "LitColorTextureProgram.hpp"
+#include "UniformBlocks.hpp"
 
 #include "DrawLines.hpp"
 #include "Mesh.hpp"
@@ -30,9 +31,7 @@ Load< Scene > proto_scene(LoadTagDefault, []() -> Scene const * {
 		drawable.pipeline = lit_color_texture_program_pipeline;
 
 		drawable.pipeline.vao = proto_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
+		drawable.set_mesh(mesh);
 
 	});
 });
@@ -300,12 +299,16 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	character.camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
 	//set up light type and position for lit_color_texture_program:
-	// TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
+	// (the 'Light' uniform block is shared by every lit program, so this is one buffer update)
+	// the scene's own Light(s) are shaded by Scene::draw (see LightClusters.hpp); this default sky light
+	// stays on as ambient fill under point and spot lights, and is only dropped if the scene brings its own sky or sun:
+	{
+		UniformBlocks::Light light;
+		light.LIGHT_TYPE = 1;
+		light.LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f,-1.0f);
+		light.LIGHT_ENERGY = (scene.has_global_light() ? glm::vec3(0.0f) : glm::vec3(1.0f, 1.0f, 0.95f));
+		uniform_blocks->set_light(light);
+	}
 
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
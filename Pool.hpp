@@ -0,0 +1,151 @@
+#pragma once
+
+/*
+ * A Pool< T > is an append-only container that stores its elements in
+ * fixed-size blocks:
+ *  - elements never move once created, so raw pointers to them stay valid
+ *  - elements are packed contiguously within each block, so iteration walks
+ *    memory (mostly) linearly instead of chasing list nodes
+ *  - elements can be addressed by index, and pointers mapped back to indices
+ *
+ * It supports the subset of std::list operations that Scene relies on
+ *  (emplace_back, back, iteration, size, clear) so it can stand in for one.
+ *
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+template< typename T, uint32_t BlockSize = 256 >
+struct Pool {
+	static_assert(BlockSize > 0, "Pool blocks must hold at least one element.");
+
+	Pool() = default;
+	Pool(Pool const &other) { *this = other; }
+	Pool &operator=(Pool const &other) {
+		if (this == &other) return *this;
+		clear();
+		reserve(other.size());
+		for (auto const &t : other) {
+			emplace_back(t);
+		}
+		return *this;
+	}
+	//moving hands over the blocks, so (unlike copying) pointers to elements stay valid:
+	Pool(Pool &&other) noexcept { *this = std::move(other); }
+	Pool &operator=(Pool &&other) noexcept {
+		if (this == &other) return *this;
+		clear();
+		blocks = std::move(other.blocks);
+		sorted_blocks = std::move(other.sorted_blocks);
+		count = other.count;
+		other.blocks.clear();
+		other.sorted_blocks.clear();
+		other.count = 0;
+		return *this;
+	}
+	~Pool() { clear(); }
+
+	//construct a new element at the end of the pool:
+	template< typename... Args >
+	T &emplace_back(Args&&... args) {
+		if (count == blocks.size() * BlockSize) add_block();
+		T *at = slot(count);
+		new (at) T(std::forward< Args >(args)...);
+		count += 1;
+		return *at;
+	}
+
+	T &back() { assert(count > 0); return *slot(count - 1); }
+	T const &back() const { assert(count > 0); return *slot(count - 1); }
+
+	T &operator[](size_t index) { assert(index < count); return *slot(index); }
+	T const &operator[](size_t index) const { assert(index < count); return *slot(index); }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	//make sure at least 'n' elements fit without allocating:
+	void reserve(size_t n) {
+		while (blocks.size() * BlockSize < n) add_block();
+	}
+
+	//destroy all elements (blocks are kept around for re-use):
+	void clear() {
+		for (size_t i = 0; i < count; ++i) {
+			slot(i)->~T();
+		}
+		count = 0;
+	}
+
+	//map a pointer to an element back to its index:
+	// returns size() if 't' isn't in this pool
+	size_t index_of(T const *t) const {
+		uintptr_t addr = reinterpret_cast< uintptr_t >(t);
+		//find last block starting at or before addr:
+		auto f = std::upper_bound(sorted_blocks.begin(), sorted_blocks.end(), addr,
+			[](uintptr_t a, std::pair< uintptr_t, size_t > const &b) { return a < b.first; });
+		if (f == sorted_blocks.begin()) return count;
+		--f;
+		size_t offset = addr - f->first;
+		if (offset >= BlockSize * sizeof(T) || offset % sizeof(T) != 0) return count;
+		size_t index = f->second * BlockSize + offset / sizeof(T);
+		return (index < count ? index : count);
+	}
+
+	//iteration (in creation order):
+	template< bool Const >
+	struct Iterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = typename std::conditional< Const, T const *, T * >::type;
+		using reference = typename std::conditional< Const, T const &, T & >::type;
+		using PoolPtr = typename std::conditional< Const, Pool const *, Pool * >::type;
+
+		Iterator() = default;
+		Iterator(PoolPtr pool_, size_t index_) : pool(pool_), index(index_) { }
+
+		reference operator*() const { return *pool->slot(index); }
+		pointer operator->() const { return pool->slot(index); }
+		Iterator &operator++() { ++index; return *this; }
+		Iterator operator++(int) { Iterator ret = *this; ++index; return ret; }
+		bool operator==(Iterator const &o) const { return index == o.index; }
+		bool operator!=(Iterator const &o) const { return index != o.index; }
+
+		PoolPtr pool = nullptr;
+		size_t index = 0;
+	};
+	using iterator = Iterator< false >;
+	using const_iterator = Iterator< true >;
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, count); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, count); }
+
+	//-- internals --
+	struct Block {
+		alignas(T) unsigned char storage[BlockSize * sizeof(T)];
+	};
+	std::vector< std::unique_ptr< Block > > blocks;
+	std::vector< std::pair< uintptr_t, size_t > > sorted_blocks; //(block address, block index), sorted by address; used by index_of
+	size_t count = 0;
+
+	T *slot(size_t index) const {
+		return reinterpret_cast< T * >(blocks[index / BlockSize]->storage) + (index % BlockSize);
+	}
+
+	void add_block() {
+		blocks.emplace_back(new Block);
+		std::pair< uintptr_t, size_t > entry(reinterpret_cast< uintptr_t >(blocks.back()->storage), blocks.size() - 1);
+		sorted_blocks.insert(std::upper_bound(sorted_blocks.begin(), sorted_blocks.end(), entry), entry);
+	}
+};
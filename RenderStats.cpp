@@ -0,0 +1,169 @@
+#include "RenderStats.hpp"
+
+#include "DrawLines.hpp"
+#include "GL.hpp"
+#include "GPUProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+RenderStats render_stats;
+
+void RenderStats::end_frame() {
+	auto now = std::chrono::high_resolution_clock::now();
+	frame.frame_ms = std::chrono::duration< float, std::milli >(now - frame_start).count();
+	frame_start = now;
+
+	if (frames.size() != History) frames.resize(History);
+	frames[next] = frame;
+	next = (next + 1) % History;
+	count = std::min< uint32_t >(count + 1, History);
+
+	frame = Frame();
+}
+
+std::vector< RenderStats::Frame > RenderStats::recent() const {
+	std::vector< Frame > ret;
+	ret.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		ret.emplace_back(frames[(next + History - count + i) % History]);
+	}
+	return ret;
+}
+
+void RenderStats::draw_hud(glm::uvec2 const &drawable_size) const {
+	if (drawable_size.x == 0 || drawable_size.y == 0) return;
+
+	std::vector< Frame > history = recent();
+	if (history.empty()) return;
+	Frame const &last = history.back();
+
+	//draw in pixels, with (0,0) at the lower left of the window:
+	glm::mat4 pixel_to_clip = glm::mat4(
+		2.0f / drawable_size.x, 0.0f, 0.0f, 0.0f,
+		0.0f, 2.0f / drawable_size.y, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 1.0f
+	);
+
+	glDisable(GL_DEPTH_TEST);
+	DrawLines lines(pixel_to_clip);
+
+	float const left = 10.0f;
+	float bottom = 10.0f; //(moves up past each part of the HUD)
+
+	{ //frame-time graph: one bar per frame, newest at the right; guides at 60 and 30 fps:
+		float const bar = std::max(1.0f, std::floor((drawable_size.x - 2.0f * left) / History));
+		float const ms_height = 3.0f; //pixels per millisecond
+		float const graph_height = 50.0f * ms_height;
+		glm::vec2 origin(left, bottom);
+
+		for (uint32_t i = 0; i < uint32_t(history.size()); ++i) {
+			float ms = history[i].frame_ms;
+			glm::u8vec4 color = (ms <= 1000.0f / 60.0f + 1.0f ? glm::u8vec4(0x44, 0xff, 0x44, 0xff)
+				: ms <= 1000.0f / 30.0f + 1.0f ? glm::u8vec4(0xff, 0xcc, 0x22, 0xff)
+				: glm::u8vec4(0xff, 0x44, 0x44, 0xff));
+			float x = origin.x + (History - history.size() + i + 0.5f) * bar;
+			lines.draw(glm::vec3(x, origin.y, 0.0f), glm::vec3(x, origin.y + std::min(ms * ms_height, graph_height), 0.0f), color);
+		}
+
+		float width = History * bar;
+		for (float ms : { 1000.0f / 60.0f, 1000.0f / 30.0f }) {
+			float y = origin.y + ms * ms_height;
+			lines.draw(glm::vec3(origin.x, y, 0.0f), glm::vec3(origin.x + width, y, 0.0f), glm::u8vec4(0x88, 0x88, 0x88, 0xff));
+		}
+		lines.draw_box(glm::mat4x3(
+			0.5f * width, 0.0f, 0.0f,
+			0.0f, 0.5f * graph_height, 0.0f,
+			0.0f, 0.0f, 0.0f,
+			origin.x + 0.5f * width, origin.y + 0.5f * graph_height, 0.0f
+		), glm::u8vec4(0x88, 0x88, 0x88, 0xff));
+
+		bottom += graph_height + 10.0f;
+	}
+
+	{ //counts for the most recent frame (and frame time over the whole history):
+		float total_ms = 0.0f, max_ms = 0.0f;
+		for (auto const &f : history) {
+			total_ms += f.frame_ms;
+			max_ms = std::max(max_ms, f.frame_ms);
+		}
+
+		std::vector< std::string > text;
+		char buffer[128];
+		auto add_line = [&]() { text.emplace_back(buffer); };
+		std::snprintf(buffer, sizeof(buffer), "frame %.1f ms (avg %.1f, max %.1f)", last.frame_ms, total_ms / history.size(), max_ms); add_line();
+		std::snprintf(buffer, sizeof(buffer), "draws %u  triangles %u", last.draws, last.triangles); add_line();
+		std::snprintf(buffer, sizeof(buffer), "binds: program %u  vao %u  texture %u", last.program_binds, last.vao_binds, last.texture_binds); add_line();
+		std::snprintf(buffer, sizeof(buffer), "upload %.1f KB", last.upload_bytes / 1024.0); add_line();
+		std::snprintf(buffer, sizeof(buffer), "visible %u  culled %u  occluded %u", last.visible, last.culled, last.occluded); add_line();
+
+		//per-pass timings (from GPUProfiler::Latency frames ago):
+		// if the GPU total is near the frame time while the CPU total is well under it, the GPU is the bottleneck
+		float cpu_total = 0.0f, gpu_total = 0.0f;
+		for (auto const &pass : gpu_profiler.results) {
+			if (pass.scopes == 0) continue;
+			if (gpu_profiler.gpu_timing) {
+				std::snprintf(buffer, sizeof(buffer), "%s: cpu %.2f ms  gpu %.2f ms", pass.name, pass.cpu_ms, pass.gpu_ms);
+			} else {
+				std::snprintf(buffer, sizeof(buffer), "%s: cpu %.2f ms  gpu n/a", pass.name, pass.cpu_ms);
+			}
+			add_line();
+			cpu_total += pass.cpu_ms;
+			gpu_total += pass.gpu_ms;
+		}
+		if (!gpu_profiler.results.empty()) {
+			std::snprintf(buffer, sizeof(buffer), "passes: cpu %.2f ms  gpu %.2f ms (%u dropped)", cpu_total, gpu_total, gpu_profiler.dropped); add_line();
+		}
+
+		float const H = 14.0f;
+		for (uint32_t i = 0; i < uint32_t(text.size()); ++i) {
+			float y = bottom + (text.size() - 1 - i) * 1.5f * H;
+			lines.draw_text(text[i], glm::vec3(left, y, 0.0f),
+				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+				glm::u8vec4(0xff));
+		}
+	}
+}
+
+void RenderStats::write_json(std::ostream &to) const {
+	to << "{\"frames\":[";
+	std::vector< Frame > history = recent();
+	for (uint32_t i = 0; i < uint32_t(history.size()); ++i) {
+		Frame const &f = history[i];
+		if (i != 0) to << ",";
+		to << "\n\t{"
+			<< "\"frame_ms\":" << f.frame_ms
+			<< ",\"draws\":" << f.draws
+			<< ",\"triangles\":" << f.triangles
+			<< ",\"program_binds\":" << f.program_binds
+			<< ",\"vao_binds\":" << f.vao_binds
+			<< ",\"texture_binds\":" << f.texture_binds
+			<< ",\"upload_bytes\":" << f.upload_bytes
+			<< ",\"visible\":" << f.visible
+			<< ",\"culled\":" << f.culled
+			<< ",\"occluded\":" << f.occluded
+			<< "}";
+	}
+	to << "\n],\"passes\":[";
+	for (uint32_t i = 0; i < uint32_t(gpu_profiler.results.size()); ++i) {
+		GPUProfiler::Pass const &pass = gpu_profiler.results[i];
+		if (i != 0) to << ",";
+		to << "\n\t{"
+			<< "\"name\":\"" << pass.name << "\""
+			<< ",\"cpu_ms\":" << pass.cpu_ms;
+		if (gpu_profiler.gpu_timing) to << ",\"gpu_ms\":" << pass.gpu_ms;
+		to << ",\"scopes\":" << pass.scopes
+			<< "}";
+	}
+	to << "\n]}\n";
+}
+
+void RenderStats::write_json(std::string const &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	write_json(file);
+	if (!file) throw std::runtime_error("Failed to write render stats to '" + filename + "'.");
+}
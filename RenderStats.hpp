@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ * RenderStats counts what each frame asks of OpenGL -- draw calls,
+ *  triangles, binds, buffer uploads, and culled objects -- and keeps the
+ *  counts for the last few hundred frames.
+ *
+ * Code that talks to GL (Scene::draw, DrawLines, TextRenderer, ...) adds to
+ *  'render_stats.frame' as it goes; the main loop calls end_frame() once
+ *  per frame to time the frame and file the counts into the history.
+ *
+ * draw_hud() shows the most recent counts and a frame-time graph on top of
+ *  whatever was drawn, along with per-pass CPU and GPU times from
+ *  GPUProfiler (in main.cpp: F3 toggles it, F4 writes the history to
+ *  render-stats.json).
+ *
+ * Counters are only touched from the thread that owns the GL context.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct RenderStats {
+	struct Frame {
+		float frame_ms = 0.0f; //time from the end of the previous frame to the end of this one
+		uint32_t draws = 0; //glDraw* calls
+		uint32_t triangles = 0; //triangles drawn (GL_TRIANGLES draws only)
+		uint32_t program_binds = 0; //glUseProgram calls
+		uint32_t vao_binds = 0; //glBindVertexArray calls
+		uint32_t texture_binds = 0; //glBindTexture calls
+		uint64_t upload_bytes = 0; //bytes sent by glBufferData / glBufferSubData
+		uint32_t visible = 0; //scene drawables that passed culling
+		uint32_t culled = 0; //scene drawables outside the view frustum
+		uint32_t occluded = 0; //scene drawables hidden behind occluders
+	};
+
+	//counts for the frame in progress:
+	Frame frame;
+
+	//finish the frame in progress: time it, add it to the history, and start a new one:
+	void end_frame();
+
+	//recent frames, oldest first (at most History of them):
+	enum : uint32_t { History = 240 };
+	std::vector< Frame > recent() const;
+
+	//draw the most recent frame's counts and a frame-time graph over the whole window:
+	// (uses DrawLines, so the HUD's own draw is counted in the frame it's drawn in)
+	bool show_hud = false;
+	void draw_hud(glm::uvec2 const &drawable_size) const;
+
+	//recent frames as JSON ({"frames":[{...},...], oldest first) plus the latest GPUProfiler pass timings ("passes":[...]}):
+	void write_json(std::ostream &to) const;
+	//..or to a file (throws if the file can't be written):
+	void write_json(std::string const &filename) const;
+
+	//-- internals --
+	std::vector< Frame > frames; //ring buffer of History frames
+	uint32_t next = 0; //slot the next finished frame goes in
+	uint32_t count = 0; //frames filed so far (up to History)
+	std::chrono::high_resolution_clock::time_point frame_start = std::chrono::high_resolution_clock::now();
+};
+
+extern RenderStats render_stats;
@@ -1,11 +1,29 @@
 #include "Scene.hpp"
 
+#include "LightClusters.hpp"
+#include "Mesh.hpp"
+#include "GPUProfiler.hpp"
+#include "OcclusionBuffer.hpp"
+#include "RenderStats.hpp"
+#include "UniformBlocks.hpp"
+#include "WorkerPool.hpp"
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_CULL_SSE
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
+#include <unordered_set>
 
 //-------------------------
 
@@ -56,18 +74,168 @@ glm::mat4x3 Scene::Transform::make_parent_to_local() const {
 	);
 }
 
-glm::mat4x3 Scene::Transform::make_local_to_world() const {
+void Scene::Transform::update_world_cache() const {
+	//ancestors first, so their versions are current:
+	if (parent) parent->update_world_cache();
+	update_world_cache_from_parent();
+}
+
+void Scene::Transform::update_world_cache_from_parent() const {
+	WorldCache &cache = world_cache;
+
+	//nothing changed since last computation? then nothing to do:
+	if (cache.version != 0
+	 && cache.position == position
+	 && cache.rotation == rotation
+	 && cache.scale == scale
+	 && cache.parent == parent
+	 && (!parent || cache.parent_version == parent->world_cache.version)) {
+		return;
+	}
+
+	cache.position = position;
+	cache.rotation = rotation;
+	cache.scale = scale;
+	cache.parent = parent;
+
 	if (!parent) {
-		return make_local_to_parent();
+		cache.parent_version = 0;
+		cache.local_to_world = make_local_to_parent();
 	} else {
-		return parent->make_local_to_world() * glm::mat4(make_local_to_parent()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		cache.parent_version = parent->world_cache.version;
+		cache.local_to_world = parent->world_cache.local_to_world * glm::mat4(make_local_to_parent()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
 	}
+	cache.world_to_local_valid = false;
+
+	//bump version so children notice the change (skipping 0, which means "never computed"):
+	cache.version += 1;
+	if (cache.version == 0) cache.version = 1;
+}
+
+glm::mat4x3 Scene::Transform::make_local_to_world() const {
+	update_world_cache();
+	return world_cache.local_to_world;
 }
 glm::mat4x3 Scene::Transform::make_world_to_local() const {
-	if (!parent) {
-		return make_parent_to_local();
-	} else {
-		return make_parent_to_local() * glm::mat4(parent->make_world_to_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+	update_world_cache();
+	if (!world_cache.world_to_local_valid) {
+		if (!parent) {
+			world_cache.world_to_local = make_parent_to_local();
+		} else {
+			world_cache.world_to_local = make_parent_to_local() * glm::mat4(parent->make_world_to_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		}
+		world_cache.world_to_local_valid = true;
+	}
+	return world_cache.world_to_local;
+}
+
+//-------------------------
+
+void Scene::build_world_arrays() const {
+	WorldArrays &wa = world_arrays;
+	size_t count = transforms.size();
+
+	//sort transforms by depth in the hierarchy (counting sort), so that each level only depends on the one above:
+	// (depth is found by walking up parent pointers rather than relying on list order, since game code may
+	//  attach transforms it creates to ones created later; this only happens when the hierarchy changes)
+	std::vector< uint32_t > depths;
+	depths.reserve(count);
+	wa.levels.clear();
+	for (auto const &transform : transforms) {
+		uint32_t depth = 0;
+		for (Transform const *t = transform.parent; t; t = t->parent) ++depth;
+		depths.emplace_back(depth);
+		if (depth + 1 >= wa.levels.size()) wa.levels.resize(depth + 2, 0);
+		wa.levels[depth + 1] += 1;
+	}
+	//(levels[d] is now the count at depth d-1; make it the start of depth d)
+	for (size_t d = 1; d < wa.levels.size(); ++d) {
+		wa.levels[d] += wa.levels[d-1];
+	}
+
+	wa.slot.resize(count);
+	{
+		std::vector< uint32_t > next(wa.levels);
+		for (size_t i = 0; i < count; ++i) {
+			wa.slot[i] = next[depths[i]]++;
+		}
+	}
+
+	wa.parent_transform.resize(count);
+	wa.index.resize(count);
+	wa.parent.assign(count, WorldArrays::NoParent);
+	wa.changed.assign(count, 0);
+	for (size_t i = 0; i < count; ++i) {
+		Transform const &transform = transforms[i];
+		uint32_t s = wa.slot[i];
+		wa.parent_transform[i] = transform.parent;
+		wa.index[s] = uint32_t(i);
+		if (!transform.parent) continue;
+		size_t p = transforms.index_of(transform.parent);
+		if (p != count) wa.parent[s] = wa.slot[p];
+	}
+	wa.transform_count = count;
+}
+
+void Scene::update_world_matrices() const {
+	//an instance's transforms may hang off of base transforms, so bring those up to date first:
+	if (base) base->update_world_matrices();
+	for (Scene const *scene : attached) scene->update_world_matrices();
+
+	WorldArrays &wa = world_arrays;
+
+	//find transforms whose world matrix is stale, walking 'transforms' in order:
+	// (game code writes positions directly, so comparing against the values world_cache was computed from is the
+	//  only way to tell; it does no matrix math) the depth order is rebuilt first if transforms were added or re-parented
+	bool rebuild = (wa.transform_count != transforms.size());
+	for (size_t i = 0; !rebuild && i < transforms.size(); ++i) {
+		Transform const &t = transforms[i];
+		if (t.parent != wa.parent_transform[i]) {
+			rebuild = true;
+			break;
+		}
+		Transform::WorldCache const &cache = t.world_cache;
+		//(a transform never computed -- e.g., a new one in a re-used pool slot -- counts as changed, as does one whose
+		// parent was recomputed outside this pass, e.g. by make_local_to_world() or in the base scene)
+		wa.changed[wa.slot[i]] = (cache.version == 0
+			|| t.position != cache.position || t.rotation != cache.rotation || t.scale != cache.scale
+			|| cache.parent != t.parent || (t.parent && cache.parent_version != t.parent->world_cache.version));
+	}
+	if (rebuild) {
+		build_world_arrays();
+		wa.changed.assign(transforms.size(), 1);
+	}
+
+	//..then pass changes down to descendants (slots are in depth order, so parents are decided first):
+	uint32_t changed_total = 0;
+	wa.level_changed.assign(wa.levels.empty() ? 0 : wa.levels.size() - 1, 0);
+	for (size_t d = 0; d + 1 < wa.levels.size(); ++d) {
+		for (uint32_t s = wa.levels[d]; s < wa.levels[d+1]; ++s) {
+			if (wa.parent[s] != WorldArrays::NoParent) wa.changed[s] |= wa.changed[wa.parent[s]];
+			wa.level_changed[d] += wa.changed[s];
+		}
+		changed_total += wa.level_changed[d];
+	}
+	if (changed_total == 0) return;
+
+	auto update_slot = [this, &wa](uint32_t s) {
+		if (!wa.changed[s]) return;
+		transforms[wa.index[s]].update_world_cache_from_parent(); //(a no-op if make_local_to_world() already brought it up to date)
+	};
+
+	//update one level at a time, splitting levels with enough work across the worker pool:
+	// (a transform's update only writes its own cache, and reads its parent's, which the previous level finished)
+	for (size_t d = 0; d + 1 < wa.levels.size(); ++d) {
+		if (wa.level_changed[d] == 0) continue;
+		uint32_t begin = wa.levels[d];
+		uint32_t end = wa.levels[d+1];
+		if (wa.level_changed[d] < WorldMatricesGrain) {
+			for (uint32_t s = begin; s < end; ++s) update_slot(s);
+		} else {
+			worker_pool->parallel_for(end - begin, WorldMatricesGrain, [&update_slot, begin](size_t b, size_t e) {
+				for (size_t s = begin + b; s < begin + e; ++s) update_slot(uint32_t(s));
+			});
+		}
 	}
 }
 
@@ -87,83 +255,695 @@ void Scene::draw(Camera const &camera) const {
 	draw(world_to_clip, world_to_light);
 }
 
-void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+//Sort key for the render queue. From most to least significant:
+//  program (16 bits), vertex array (16 bits), first texture (16 bits), depth or first vertex (16 bits)
+//Records that may be instanced use their first vertex in place of depth, so that copies of the same
+// mesh sort next to each other and can be gathered into one instanced draw.
+//GL object names wider than 16 bits only make the sort less effective -- the submission
+// loop compares the actual state, so correctness never depends on the key.
+static uint64_t make_draw_key(Scene::Drawable::Pipeline const &pipeline, GLuint start, float depth, bool instancable) {
+	uint32_t low_bits;
+	if (instancable) {
+		low_bits = (start + GLuint(pipeline.base_vertex)) & 0xffff;
+	} else {
+		//non-negative floats sort the same way as their bit patterns, so the top 16 bits give a coarse depth:
+		depth = std::max(depth, 0.0f);
+		uint32_t depth_bits;
+		static_assert(sizeof(depth_bits) == sizeof(depth), "float is 32 bits");
+		std::memcpy(&depth_bits, &depth, sizeof(depth));
+		low_bits = depth_bits >> 16;
+	}
 
-	//Iterate through all drawables, sending each one to OpenGL:
-	for (auto const &drawable : drawables) {
-		if (!drawable.transform->include) continue;
-		
-		//Reference to drawable's pipeline for convenience:
-		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+	return (uint64_t(pipeline.program & 0xffff) << 48)
+	     | (uint64_t(pipeline.vao & 0xffff) << 32)
+	     | (uint64_t(pipeline.textures[0].texture & 0xffff) << 16)
+	     | uint64_t(low_bits);
+}
 
-		//skip any drawables without a shader program set:
-		if (pipeline.program == 0) continue;
-		//skip any drawables that don't reference any vertex array:
-		if (pipeline.vao == 0) continue;
-		//skip any drawables that don't contain any vertices:
-		if (pipeline.count == 0) continue;
+//can this pipeline be drawn as part of an instanced group?
+// (custom uniforms might differ per drawable, so those pipelines always draw alone)
+static bool is_instancable(Scene::Drawable::Pipeline const &pipeline) {
+	return pipeline.instancing.program != 0 && !pipeline.set_uniforms;
+}
 
+//do two (instancable) records draw the same thing with the same state?
+static bool same_instance_group(Scene::DrawRecord const &ra, Scene::DrawRecord const &rb) {
+	if (ra.start != rb.start || ra.count != rb.count || ra.base_vertex != rb.base_vertex) return false;
+	Scene::Drawable::Pipeline const &a = ra.drawable->pipeline;
+	Scene::Drawable::Pipeline const &b = rb.drawable->pipeline;
+	if (a.program != b.program || a.vao != b.vao) return false;
+	if (a.type != b.type || a.index_type != b.index_type) return false;
+	if (a.instancing.program != b.instancing.program) return false;
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (a.textures[i].texture != b.textures[i].texture) return false;
+		if (a.textures[i].texture != 0 && a.textures[i].target != b.textures[i].target) return false;
+	}
+	return true;
+}
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
+//can two (single-draw) records go in one multi-draw?
+// (same state and same matrices, since everything but the vertex range is shared)
+static bool same_multi_draw_group(Scene::DrawRecord const &ra, Scene::DrawRecord const &rb) {
+	Scene::Drawable::Pipeline const &a = ra.drawable->pipeline;
+	Scene::Drawable::Pipeline const &b = rb.drawable->pipeline;
+	if (a.set_uniforms || b.set_uniforms) return false;
+	if (a.program != b.program || a.vao != b.vao) return false;
+	if (a.type != b.type || a.index_type != b.index_type) return false;
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (a.textures[i].texture != b.textures[i].texture) return false;
+		if (a.textures[i].texture != 0 && a.textures[i].target != b.textures[i].target) return false;
+	}
+	if (a.position_offset != b.position_offset || a.position_scale != b.position_scale) return false;
+	return ra.object_to_world == rb.object_to_world;
+}
 
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+//matrix taking a pipeline's vertex positions to world space:
+// (the same as object_to_world, except for quantized meshes -- see Drawable::Pipeline::position_offset)
+static glm::mat4x3 position_to_world(glm::mat4x3 const &object_to_world, Scene::Drawable::Pipeline const &pipeline) {
+	return glm::mat4x3(
+		object_to_world[0] * pipeline.position_scale.x,
+		object_to_world[1] * pipeline.position_scale.y,
+		object_to_world[2] * pipeline.position_scale.z,
+		object_to_world * glm::vec4(pipeline.position_offset, 1.0f)
+	);
+}
 
-		//Configure program uniforms:
+//issue the draw call for a record (instanced if 'instances' is more than one):
+static void draw_range(Scene::Drawable::Pipeline const &pipeline, Scene::DrawRecord const &record, GLsizei instances) {
+	if (pipeline.index_type == GL_NONE) {
+		if (instances > 1) glDrawArraysInstanced(pipeline.type, record.start, record.count, instances);
+		else glDrawArrays(pipeline.type, record.start, record.count);
+	} else {
+		GLsizei index_size = (pipeline.index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+		GLbyte const *offset = (GLbyte const *)0 + size_t(record.start) * index_size;
+		if (instances > 1) glDrawElementsInstancedBaseVertex(pipeline.type, record.count, pipeline.index_type, offset, instances, record.base_vertex);
+		else glDrawElementsBaseVertex(pipeline.type, record.count, pipeline.index_type, offset, record.base_vertex);
+	}
+}
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+//Level of detail for a drawable whose bounding sphere has projected radius 'size' (see Scene::lod_size):
+// starts from 'last', the level used last frame, and only moves past a boundary once clear of it by the hysteresis margin
+static uint32_t select_lod(Scene::Drawable const &drawable, uint32_t last, float size, float lod_size, float lod_hysteresis) {
+	uint32_t count = std::min(drawable.lod_count, uint32_t(Scene::Drawable::MaxLODs));
+	uint32_t lod = std::min(last, count - 1);
+	//boundary between level l-1 and level l:
+	auto boundary = [&](uint32_t l) { return lod_size * std::ldexp(1.0f, -int32_t(l - 1)); };
+	while (lod + 1 < count && size < boundary(lod + 1) * (1.0f - lod_hysteresis)) lod += 1;
+	while (lod > 0 && size > boundary(lod) * (1.0f + lod_hysteresis)) lod -= 1;
+	return lod;
+}
 
-		//OBJECT_TO_CLIP takes vertices from object space to clip space:
-		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
-			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+//Instance data for all instanced draws is streamed through one shared buffer:
+static GLuint instance_buffer = 0;
+
+//point the instance attribute locations of the (currently bound) vertex array at instance_buffer:
+// (only done once per vertex array; vertex arrays remember this state)
+static void add_instance_attributes(GLuint vao) {
+	static std::unordered_set< GLuint > instanced_vaos;
+	if (!instanced_vaos.insert(vao).second) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	//matrix attributes occupy one location per column:
+	for (GLuint c = 0; c < 4; ++c) {
+		GLuint location = Scene::InstanceAttribLocation + c;
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(Scene::InstanceData),
+			(GLbyte *)0 + offsetof(Scene::InstanceData, OBJECT_TO_WORLD) + c * sizeof(glm::vec3));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+	for (GLuint c = 0; c < 3; ++c) {
+		GLuint location = Scene::InstanceAttribLocation + 4 + c;
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(Scene::InstanceData),
+			(GLbyte *)0 + offsetof(Scene::InstanceData, NORMAL_TO_LIGHT) + c * sizeof(glm::vec3));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//-------------------------
+//Frustum culling helpers.
+
+//Each frustum plane is a sum or difference of rows of world_to_clip. For example, the left plane is
+// x_clip >= -w_clip, i.e., dot(row[3] + row[0], x) >= 0.
+// (with the infinite projection from Camera::make_projection, the far plane never culls anything)
+void Scene::make_frustum_planes(glm::mat4 const &world_to_clip, glm::vec4 planes[6]) {
+	glm::vec4 row[4];
+	for (uint32_t i = 0; i < 4; ++i) {
+		row[i] = glm::vec4(world_to_clip[0][i], world_to_clip[1][i], world_to_clip[2][i], world_to_clip[3][i]);
+	}
+	planes[0] = row[3] + row[0]; //left
+	planes[1] = row[3] - row[0]; //right
+	planes[2] = row[3] + row[1]; //bottom
+	planes[3] = row[3] - row[1]; //top
+	planes[4] = row[3] + row[2]; //near
+	planes[5] = row[3] - row[2]; //far
+}
+
+void Scene::Drawable::set_mesh(Mesh const &mesh) {
+	pipeline.type = mesh.type;
+	pipeline.start = mesh.start;
+	pipeline.count = mesh.count;
+	pipeline.index_type = mesh.index_type;
+	pipeline.base_vertex = mesh.base_vertex;
+	pipeline.position_offset = mesh.position_offset;
+	pipeline.position_scale = mesh.position_scale;
+
+	min = mesh.min;
+	max = mesh.max;
+
+	lod_count = uint32_t(std::min< size_t >(mesh.lods.size(), MaxLODs));
+	for (uint32_t l = 0; l < lod_count; ++l) {
+		lods[l].start = mesh.lods[l].start;
+		lods[l].count = mesh.lods[l].count;
+		lods[l].base_vertex = mesh.lods[l].base_vertex;
+	}
+}
+
+void Scene::Drawable::make_world_box(glm::mat4x3 const &object_to_world, glm::vec3 *center_, glm::vec3 *radius_) const {
+	assert(center_ && radius_);
+	glm::vec3 center = 0.5f * (min + max);
+	glm::vec3 radius = 0.5f * (max - min);
+	*center_ = object_to_world * glm::vec4(center, 1.0f);
+	*radius_ = glm::abs(object_to_world[0]) * radius.x
+	         + glm::abs(object_to_world[1]) * radius.y
+	         + glm::abs(object_to_world[2]) * radius.z;
+}
+
+bool Scene::box_outside(glm::vec4 const planes[6], glm::vec3 const &center, glm::vec3 const &radius) {
+	for (uint32_t p = 0; p < 6; ++p) {
+		glm::vec3 n = glm::vec3(planes[p]);
+		if (glm::dot(n, center) + planes[p].w + glm::dot(glm::abs(n), radius) < 0.0f) return true;
+	}
+	return false;
+}
+
+void Scene::CullBoxes::clear() {
+	center_x.clear(); center_y.clear(); center_z.clear();
+	radius_x.clear(); radius_y.clear(); radius_z.clear();
+	record.clear();
+}
+
+void Scene::CullBoxes::push_back(glm::vec3 const &center, glm::vec3 const &radius, uint32_t record_) {
+	center_x.emplace_back(center.x); center_y.emplace_back(center.y); center_z.emplace_back(center.z);
+	radius_x.emplace_back(radius.x); radius_y.emplace_back(radius.y); radius_z.emplace_back(radius.z);
+	record.emplace_back(record_);
+}
+
+//test all gathered boxes; clears the 'drawable' of every render queue record whose box is outside:
+static void cull_batch(glm::vec4 const planes[6], Scene::CullBoxes const &boxes, std::vector< Scene::DrawRecord > &render_queue) {
+	size_t count = boxes.record.size();
+	size_t b = 0;
+
+	#ifdef SCENE_CULL_SSE
+	//four boxes at a time:
+	__m128 plane_n[6][3], plane_abs_n[6][3], plane_d[6];
+	for (uint32_t p = 0; p < 6; ++p) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			plane_n[p][c] = _mm_set1_ps(planes[p][c]);
+			plane_abs_n[p][c] = _mm_set1_ps(std::abs(planes[p][c]));
+		}
+		plane_d[p] = _mm_set1_ps(planes[p].w);
+	}
+	__m128 zero = _mm_setzero_ps();
+	for (; b + 4 <= count; b += 4) {
+		__m128 cx = _mm_loadu_ps(&boxes.center_x[b]);
+		__m128 cy = _mm_loadu_ps(&boxes.center_y[b]);
+		__m128 cz = _mm_loadu_ps(&boxes.center_z[b]);
+		__m128 rx = _mm_loadu_ps(&boxes.radius_x[b]);
+		__m128 ry = _mm_loadu_ps(&boxes.radius_y[b]);
+		__m128 rz = _mm_loadu_ps(&boxes.radius_z[b]);
+		__m128 outside = zero;
+		for (uint32_t p = 0; p < 6; ++p) {
+			//dist = dot(n, center) + d + dot(|n|, radius):
+			__m128 dist = plane_d[p];
+			dist = _mm_add_ps(dist, _mm_mul_ps(plane_n[p][0], cx));
+			dist = _mm_add_ps(dist, _mm_mul_ps(plane_n[p][1], cy));
+			dist = _mm_add_ps(dist, _mm_mul_ps(plane_n[p][2], cz));
+			dist = _mm_add_ps(dist, _mm_mul_ps(plane_abs_n[p][0], rx));
+			dist = _mm_add_ps(dist, _mm_mul_ps(plane_abs_n[p][1], ry));
+			dist = _mm_add_ps(dist, _mm_mul_ps(plane_abs_n[p][2], rz));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, zero));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (uint32_t i = 0; i < 4; ++i) {
+			if (mask & (1 << i)) render_queue[boxes.record[b + i]].drawable = nullptr;
 		}
+	}
+	#endif
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+	//remaining boxes (or all of them, without SSE):
+	for (; b < count; ++b) {
+		glm::vec3 center(boxes.center_x[b], boxes.center_y[b], boxes.center_z[b]);
+		glm::vec3 radius(boxes.radius_x[b], boxes.radius_y[b], boxes.radius_z[b]);
+		if (Scene::box_outside(planes, center, radius)) render_queue[boxes.record[b]].drawable = nullptr;
+	}
+}
 
-		//OBJECT_TO_CLIP takes vertices from object space to light space:
-		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
+void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	static_assert(sizeof(InstanceData) == (12 + 9) * sizeof(float), "InstanceData is tightly packed");
+
+	GPUProfiler::Scope scope("scene");
+
+	draw_stats = DrawStats();
+
+	//compute world matrices up front (in parallel) rather than one drawable at a time below:
+	update_world_matrices();
+
+	glm::vec4 frustum_planes[6];
+	if (cull_mode != CullNone) make_frustum_planes(world_to_clip, frustum_planes);
+
+	//a world-space length r at clip-space w spans about r * lod_scale / w of half the view height:
+	// (the length of the clip-y row is the projection's y scale, as long as the view has no scaling)
+	float lod_scale = glm::length(glm::vec3(world_to_clip[0][1], world_to_clip[1][1], world_to_clip[2][1]));
+
+	//draw occluders into the software depth buffer (needs current world matrices, so comes after the above):
+	bool test_occlusion = (occlusion && !occlusion->occluders.empty());
+	if (test_occlusion) occlusion->render(world_to_clip);
+
+	//Gather the drawables to consider:
+	draw_sources.clear();
+	draw_sources.reserve(drawables.size() + (base ? base->drawables.size() : 0));
+	for_each_drawable([&](Drawable const &drawable, Transform const &transform) {
+		draw_sources.emplace_back(DrawSource{ &drawable, &transform });
+	});
+
+	//Build a draw record for every drawable (in parallel tasks); records that won't draw anything are left with a null drawable:
+	render_queue.resize(draw_sources.size());
+	draw_lods.resize(draw_sources.size());
+	uint32_t tasks = (uint32_t(draw_sources.size()) + DrawTaskGrain - 1) / DrawTaskGrain;
+	if (cull_boxes.size() < tasks) cull_boxes.resize(tasks);
+	std::atomic< uint32_t > culled(0);
+	std::atomic< uint32_t > occluded(0);
+	worker_pool->parallel_for(draw_sources.size(), DrawTaskGrain, [&](size_t begin, size_t end) {
+		CullBoxes &boxes = cull_boxes[begin / DrawTaskGrain];
+		boxes.clear();
+		uint32_t task_culled = 0;
+		uint32_t task_occluded = 0;
+
+		for (size_t i = begin; i < end; ++i) {
+			Drawable const &drawable = *draw_sources[i].drawable;
+			Transform const &transform = *draw_sources[i].transform;
+			DrawRecord &record = render_queue[i];
+			record.drawable = nullptr;
+
+			if (!transform.include) continue;
+
+			//Reference to drawable's pipeline for convenience:
+			Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+
+			//skip any drawables without a shader program set:
+			if (pipeline.program == 0) continue;
+			//skip any drawables that don't reference any vertex array:
+			if (pipeline.vao == 0) continue;
+			//skip any drawables that don't contain any vertices:
+			if (pipeline.count == 0) continue;
+
+			//(world matrices are current after update_world_matrices(), so read the cache directly)
+			glm::mat4x3 object_to_world = transform.world_cache.local_to_world;
+
+			glm::vec3 center, radius;
+			bool has_bounds = drawable.has_bounds();
+			if (has_bounds) drawable.make_world_box(object_to_world, &center, &radius);
+
+			//skip (or queue for batch testing) drawables whose bounds are outside the view frustum:
+			if (cull_mode != CullNone && has_bounds) {
+				if (cull_mode == CullScalar) {
+					if (box_outside(frustum_planes, center, radius)) {
+						task_culled += 1;
+						continue;
+					}
+				} else { assert(cull_mode == CullBatch);
+					boxes.push_back(center, radius, uint32_t(i));
+				}
+			}
+
+			//clip-space w of the object's origin is its distance in front of the camera:
+			float depth = (world_to_clip * glm::vec4(object_to_world[3], 1.0f)).w;
+
+			//pick a level of detail from the size of the drawable's bounds on screen:
+			GLuint start = pipeline.start;
+			GLuint count = pipeline.count;
+			GLint base_vertex = pipeline.base_vertex;
+			uint32_t lod = 0;
+			if (drawable.lod_count > 1 && has_bounds && lod_size > 0.0f) {
+				float center_w = (world_to_clip * glm::vec4(center, 1.0f)).w;
+				float r = glm::length(radius);
+				//(bounds reaching behind the camera count as huge)
+				float size = (center_w > r ? lod_scale * r / center_w : std::numeric_limits< float >::infinity());
+				DrawLOD &last = draw_lods[i];
+				lod = select_lod(drawable, (last.drawable == &drawable ? last.lod : 0), size, lod_size, lod_hysteresis);
+				last = DrawLOD{ &drawable, lod };
+				start = drawable.lods[lod].start;
+				count = drawable.lods[lod].count;
+				base_vertex = drawable.lods[lod].base_vertex;
+			}
+
+			record = DrawRecord{ make_draw_key(pipeline, start, depth, is_instancable(pipeline)), &drawable, object_to_world, start, count, base_vertex, lod };
 		}
 
-		//NORMAL_TO_CLIP takes normals from object space to light space:
-		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
-			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+		//batch culling marks culled records by clearing their drawable:
+		if (!boxes.record.empty()) {
+			cull_batch(frustum_planes, boxes, render_queue);
+			for (uint32_t r : boxes.record) task_culled += (render_queue[r].drawable == nullptr);
 		}
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+		//boxes that made it through frustum culling are then tested against the occlusion buffer:
+		// (done after the frustum test, which is much cheaper)
+		if (test_occlusion) {
+			for (size_t i = begin; i < end; ++i) {
+				DrawRecord &record = render_queue[i];
+				if (record.drawable == nullptr || !record.drawable->has_bounds()) continue;
+				glm::vec3 center, radius;
+				record.drawable->make_world_box(record.object_to_world, &center, &radius);
+				if (occlusion->box_occluded(center, radius)) {
+					record.drawable = nullptr;
+					task_occluded += 1;
+				}
+			}
+		}
+
+		culled += task_culled;
+		occluded += task_occluded;
+	});
+	draw_stats.culled = culled;
+	draw_stats.occluded = occluded;
+
+	//remove records that won't draw:
+	render_queue.erase(std::remove_if(render_queue.begin(), render_queue.end(), [](DrawRecord const &r) { return r.drawable == nullptr; }), render_queue.end());
+	draw_stats.visible = uint32_t(render_queue.size());
+
+	//Sort by state (and front-to-back within a state):
+	// (stable so that drawables with identical keys keep their list order)
+	std::stable_sort(render_queue.begin(), render_queue.end(), [](DrawRecord const &a, DrawRecord const &b) {
+		return a.key < b.key;
+	});
+
+	//Currently-bound state, used to skip redundant binds:
+	GLuint bound_program = 0;
+	GLuint bound_vao = 0;
+	GLuint active_texture = 0;
+	Drawable::Pipeline::TextureInfo bound_textures[Drawable::Pipeline::TextureCount];
+
+	//bind program, vertex array, and textures for a draw; returns the number of binds issued:
+	auto bind_state = [&](GLuint program, Drawable::Pipeline const &pipeline) -> uint32_t {
+		uint32_t state_changes = 0;
+
+		//Set shader program:
+		if (program != bound_program) {
+			glUseProgram(program);
+			bound_program = program;
+			state_changes += 1;
+			render_stats.frame.program_binds += 1;
+		}
+
+		//Set attribute sources:
+		if (pipeline.vao != bound_vao) {
+			glBindVertexArray(pipeline.vao);
+			bound_vao = pipeline.vao;
+			state_changes += 1;
+			render_stats.frame.vao_binds += 1;
+		}
 
 		//set up textures:
+		// (a unit this drawable doesn't use is un-bound if something is left there, matching per-drawable submission)
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
+			Drawable::Pipeline::TextureInfo const &want = pipeline.textures[i];
+			Drawable::Pipeline::TextureInfo &have = bound_textures[i];
+			if (want.texture == have.texture && (want.texture == 0 || want.target == have.target)) continue;
+			if (active_texture != i) {
 				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+				active_texture = i;
+			}
+			if (want.texture != 0) {
+				glBindTexture(want.target, want.texture);
+				have = want;
+			} else {
+				glBindTexture(have.target, 0);
+				have.texture = 0;
 			}
+			state_changes += 1;
+			render_stats.frame.texture_binds += 1;
 		}
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+		return state_changes;
+	};
 
-		//un-bind textures:
+	//(per-drawable submission would use program + vao, then bind and un-bind each texture)
+	auto count_naive_state_changes = [](Drawable::Pipeline const &pipeline) -> uint32_t {
+		uint32_t naive_state_changes = 2;
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
+			if (pipeline.textures[i].texture != 0) naive_state_changes += 2;
+		}
+		return naive_state_changes;
+	};
+
+	//(triangles drawn, and saved by LOD selection)
+	auto count_triangles = [this](DrawRecord const &record) {
+		Drawable const &drawable = *record.drawable;
+		draw_stats.lod_draws[record.lod] += 1;
+		if (drawable.pipeline.type != GL_TRIANGLES) return;
+		draw_stats.triangles += record.count / 3;
+		if (drawable.pipeline.count > record.count) draw_stats.triangles_saved += (drawable.pipeline.count - record.count) / 3;
+	};
+
+	//issue one multi-draw for all the records in a batch:
+	auto draw_multi = [this](Drawable::Pipeline const &pipeline, DrawBatch const &batch) {
+		multi_first.clear();
+		multi_count.clear();
+		multi_offset.clear();
+		GLsizei index_size = (pipeline.index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+		for (uint32_t i = batch.begin; i < batch.end; ++i) {
+			DrawRecord const &record = render_queue[i];
+			multi_count.emplace_back(GLsizei(record.count));
+			if (pipeline.index_type == GL_NONE) {
+				multi_first.emplace_back(GLint(record.start));
+			} else {
+				multi_first.emplace_back(record.base_vertex);
+				multi_offset.emplace_back((GLbyte const *)0 + size_t(record.start) * index_size);
+			}
+		}
+		if (pipeline.index_type == GL_NONE) {
+			glMultiDrawArrays(pipeline.type, multi_first.data(), multi_count.data(), GLsizei(multi_count.size()));
+		} else {
+			glMultiDrawElementsBaseVertex(pipeline.type, multi_count.data(), pipeline.index_type, multi_offset.data(), GLsizei(multi_count.size()), multi_first.data());
+		}
+	};
+
+	//Split the sorted records into batches: runs of records that share one instanced draw or multi-draw, or single records:
+	draw_batches.clear();
+	for (uint32_t r = 0; r < uint32_t(render_queue.size()); /* advanced below */) {
+		Scene::Drawable::Pipeline const &pipeline = render_queue[r].drawable->pipeline;
+
+		uint32_t end = r + 1;
+		if (is_instancable(pipeline)) {
+			while (end < uint32_t(render_queue.size())) {
+				Scene::Drawable::Pipeline const &next = render_queue[end].drawable->pipeline;
+				if (!is_instancable(next) || !same_instance_group(render_queue[r], render_queue[end])) break;
+				++end;
 			}
 		}
-		glActiveTexture(GL_TEXTURE0);
+		if (end - r < MinInstances) end = r + 1;
 
+		bool multi = false;
+		if (end == r + 1) {
+			while (end < uint32_t(render_queue.size()) && same_multi_draw_group(render_queue[r], render_queue[end])) ++end;
+			multi = (end > r + 1);
+		}
+
+		draw_batches.emplace_back(DrawBatch{ r, end, 0, multi });
+		r = end;
 	}
 
+	//Lay out per-draw data: 'Object' block data gets a slot at the aligned stride; instance data is stored by record index:
+	GLuint object_stride = (GLuint(sizeof(UniformBlocks::Object)) + uniform_blocks->offset_alignment - 1)
+		/ uniform_blocks->offset_alignment * uniform_blocks->offset_alignment;
+	size_t object_size = 0;
+	bool any_instanced = false;
+	for (auto &batch : draw_batches) {
+		if (batch.instanced()) { //(instanced draws get per-instance data instead)
+			any_instanced = true;
+			continue;
+		}
+		if (render_queue[batch.begin].drawable->pipeline.Object_block == -1U) continue;
+		batch.object_offset = object_size;
+		object_size += object_stride;
+	}
+	object_uniforms.resize(object_size);
+	draw_packets.resize(draw_batches.size());
+	if (any_instanced) instance_queue.resize(render_queue.size());
+
+	//Fill per-draw data (in parallel tasks):
+	worker_pool->parallel_for(draw_batches.size(), DrawTaskGrain, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b) {
+			DrawBatch const &batch = draw_batches[b];
+
+			if (batch.instanced()) {
+				Scene::Drawable::Pipeline const &pipeline = render_queue[batch.begin].drawable->pipeline;
+				for (uint32_t i = batch.begin; i < batch.end; ++i) {
+					glm::mat4x3 const &object_to_world = render_queue[i].object_to_world;
+					glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+					instance_queue[i] = InstanceData{
+						position_to_world(object_to_world, pipeline),
+						glm::inverse(glm::transpose(glm::mat3(object_to_light)))
+					};
+				}
+				continue;
+			}
+
+			DrawRecord const &record = render_queue[batch.begin];
+			Scene::Drawable::Pipeline const &pipeline = record.drawable->pipeline;
+
+			//the object-to-world matrix is used in all three of these:
+			// OBJECT_TO_CLIP takes vertices from object space to clip space
+			// OBJECT_TO_LIGHT takes vertices from object space to light space
+			// NORMAL_TO_LIGHT takes normals from object space to light space
+			//(for quantized meshes, the first two take quantized positions instead -- see position_to_world)
+			DrawPacket &packet = draw_packets[b];
+			glm::mat4 position_to_world_ = glm::mat4(position_to_world(record.object_to_world, pipeline));
+			packet.object_to_clip = world_to_clip * position_to_world_;
+			packet.object_to_light = world_to_light * position_to_world_;
+			packet.normal_to_light = glm::inverse(glm::transpose(glm::mat3(world_to_light * glm::mat4(record.object_to_world))));
+
+			if (pipeline.Object_block != -1U) {
+				UniformBlocks::Object object_block;
+				object_block.OBJECT_TO_CLIP = packet.object_to_clip;
+				object_block.OBJECT_TO_LIGHT = glm::mat4(packet.object_to_light);
+				object_block.NORMAL_TO_LIGHT = glm::mat3x4(packet.normal_to_light);
+				std::memcpy(object_uniforms.data() + batch.object_offset, &object_block, sizeof(object_block));
+			}
+		}
+	});
+
+	//----- everything from here on just replays the above through GL -----
+
+	//Camera data, for programs that read the 'Camera' uniform block:
+	UniformBlocks::Camera camera_block;
+	camera_block.WORLD_TO_CLIP = world_to_clip;
+	camera_block.WORLD_TO_LIGHT = glm::mat4(world_to_light);
+	uniform_blocks->set_camera(camera_block);
+
+	//Lights, binned into view clusters for programs that use clustered_lighting():
+	light_clusters->update(*this, world_to_clip, world_to_light);
+
+	//Per-draw object data, for programs that read the 'Object' uniform block:
+	// (all of it goes up in one buffer upload; each draw then binds its own range)
+	if (!object_uniforms.empty()) {
+		glBindBuffer(GL_UNIFORM_BUFFER, uniform_blocks->object_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, object_uniforms.size(), object_uniforms.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		render_stats.frame.upload_bytes += object_uniforms.size();
+	}
+
+	//Submit batches in sorted order:
+	for (size_t b = 0; b < draw_batches.size(); ++b) {
+		DrawBatch const &batch = draw_batches[b];
+		DrawRecord const &record = render_queue[batch.begin];
+		Scene::Drawable::Pipeline const &pipeline = record.drawable->pipeline;
+
+		if (batch.instanced()) {
+			//----- instanced draw -----
+			uint32_t instances = batch.end - batch.begin;
+
+			uint32_t state_changes = bind_state(pipeline.instancing.program, pipeline);
+
+			if (instance_buffer == 0) glGenBuffers(1, &instance_buffer);
+			add_instance_attributes(pipeline.vao);
+
+			glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+			glBufferData(GL_ARRAY_BUFFER, instances * sizeof(InstanceData), instance_queue.data() + batch.begin, GL_STREAM_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			render_stats.frame.upload_bytes += instances * sizeof(InstanceData);
+
+			//Configure program uniforms:
+			// (programs reading the 'Camera' block already have these)
+			if (pipeline.instancing.WORLD_TO_CLIP_mat4 != -1U) {
+				glUniformMatrix4fv(pipeline.instancing.WORLD_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+			}
+			if (pipeline.instancing.WORLD_TO_LIGHT_mat4x3 != -1U) {
+				glUniformMatrix4x3fv(pipeline.instancing.WORLD_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(world_to_light));
+			}
+
+			//draw all the objects:
+			draw_range(pipeline, record, GLsizei(instances));
+			for (uint32_t i = batch.begin; i < batch.end; ++i) count_triangles(render_queue[i]);
+
+			draw_stats.draws += 1;
+			draw_stats.instanced_draws += 1;
+			draw_stats.instances += instances;
+			draw_stats.state_changes += state_changes;
+			uint32_t naive_state_changes = instances * count_naive_state_changes(pipeline);
+			if (naive_state_changes > state_changes) {
+				draw_stats.state_changes_saved += naive_state_changes - state_changes;
+			}
+
+			continue;
+		}
+
+		//----- single draw (or multi-draw) -----
+		uint32_t state_changes = bind_state(pipeline.program, pipeline);
+
+		//Configure program uniforms:
+
+		//per-object matrices from the 'Object' block (computed above):
+		if (pipeline.Object_block != -1U) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, UniformBlocks::ObjectBinding, uniform_blocks->object_buffer,
+				batch.object_offset, sizeof(UniformBlocks::Object));
+		}
+
+		//per-object matrices as uniforms (computed above):
+		DrawPacket const &packet = draw_packets[b];
+		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
+			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(packet.object_to_clip));
+		}
+		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(packet.object_to_light));
+		}
+		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
+			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(packet.normal_to_light));
+		}
+
+		//set any requested custom uniforms:
+		if (pipeline.set_uniforms) pipeline.set_uniforms();
+
+		//draw the object(s):
+		if (batch.multi) {
+			draw_multi(pipeline, batch);
+			for (uint32_t i = batch.begin; i < batch.end; ++i) count_triangles(render_queue[i]);
+			draw_stats.multi_draws += 1;
+			draw_stats.multi_drawn += batch.end - batch.begin;
+		} else {
+			draw_range(pipeline, record, 1);
+			count_triangles(record);
+		}
+
+		draw_stats.draws += 1;
+		draw_stats.state_changes += state_changes;
+		uint32_t naive_state_changes = (batch.end - batch.begin) * count_naive_state_changes(pipeline);
+		if (naive_state_changes > state_changes) {
+			draw_stats.state_changes_saved += naive_state_changes - state_changes;
+		}
+	}
+
+	//un-bind textures:
+	for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+		if (bound_textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(bound_textures[i].target, 0);
+		}
+	}
+	glActiveTexture(GL_TEXTURE0);
+
 	glUseProgram(0);
 	glBindVertexArray(0);
 
+	//add this draw to the frame's totals (for the performance HUD):
+	render_stats.frame.draws += draw_stats.draws;
+	render_stats.frame.triangles += draw_stats.triangles;
+	render_stats.frame.visible += draw_stats.visible;
+	render_stats.frame.culled += draw_stats.culled;
+	render_stats.frame.occluded += draw_stats.occluded;
+
 	GL_ERRORS();
 }
 
@@ -225,6 +1005,8 @@ void Scene::load(std::string const &filename,
 
 	std::vector< Transform * > hierarchy_transforms;
 	hierarchy_transforms.reserve(hierarchy.size());
+	transforms.reserve(transforms.size() + hierarchy.size());
+	NameIndex &indexed_names = edit_name_index();
 
 	for (auto const &h : hierarchy) {
 		transforms.emplace_back();
@@ -246,9 +1028,17 @@ void Scene::load(std::string const &filename,
 		t->rotation = h.rotation;
 		t->scale = h.scale;
 
+		//(like index_name(), but sorting the new names once at the end)
+		if (indexed_names.add(t->name, uint32_t(transforms.size() - 1))) {
+			indexed_names.sorted_names.emplace_back(indexed_names.named.size() - 1);
+		}
+
 		hierarchy_transforms.emplace_back(t);
 	}
 	assert(hierarchy_transforms.size() == hierarchy.size());
+	std::sort(indexed_names.sorted_names.begin(), indexed_names.sorted_names.end(), [&indexed_names](NameID a, NameID b) {
+		return *indexed_names.id_names[a] < *indexed_names.id_names[b];
+	});
 
 	for (auto const &m : meshes) {
 		if (m.transform >= hierarchy_transforms.size()) {
@@ -329,51 +1119,246 @@ Scene &Scene::operator=(Scene const &other) {
 	return *this;
 }
 
-void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map_) {
-
-	std::unordered_map< Transform const *, Transform * > t2t_temp;
-	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
-
-	transform_to_transform.clear();
-
-	//null transform maps to itself:
-	transform_to_transform.insert(std::make_pair(nullptr, nullptr));
+void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map) {
+	//Transforms are matched up by index -- other.transforms[i] is copied to transforms[i] -- so pointer
+	// fixup is an index_of() lookup (a binary search over blocks) instead of a hash map:
+	auto map_transform = [&](Transform const *t) -> Transform * {
+		if (t == nullptr) return nullptr;
+		size_t index = other.transforms.index_of(t);
+		if (index == other.transforms.size()) {
+			//instances refer to (unchanging) base transforms directly, and copies keep sharing them:
+			if (other.base && other.base->transforms.index_of(t) != other.base->transforms.size()) {
+				return const_cast< Transform * >(t);
+			}
+			throw std::runtime_error("Scene::set: transform '" + t->name + "' is not in the scene being copied.");
+		}
+		return &transforms[index];
+	};
 
-	//Copy transforms and store mapping:
+	//Copy transforms:
 	transforms.clear();
+	transforms.reserve(other.transforms.size());
+	world_arrays = WorldArrays(); //(the depth order is rebuilt for the new transforms on the next pass)
 	for (auto const &t : other.transforms) {
 		transforms.emplace_back();
 		transforms.back().name = t.name;
+		transforms.back().include = t.include;
 		transforms.back().position = t.position;
 		transforms.back().rotation = t.rotation;
 		transforms.back().scale = t.scale;
-		transforms.back().parent = t.parent; //will update later
-
-		//store mapping between transforms old and new:
-		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
-		assert(ret.second);
 	}
 
-	//update transform parents:
-	for (auto &t : transforms) {
-		t.parent = transform_to_transform.at(t.parent);
+	//update transform parents (and carry over cached world matrices, which stay valid after the same fixup):
+	for (size_t i = 0; i < transforms.size(); ++i) {
+		Transform const &from = other.transforms[i];
+		Transform &to = transforms[i];
+		to.parent = map_transform(from.parent);
+		to.world_cache = from.world_cache;
+		//(a cache that was stale stays stale -- no transform is its own parent)
+		to.world_cache.parent = (from.world_cache.parent == from.parent ? to.parent : &to);
 	}
 
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
-		d.transform = transform_to_transform.at(d.transform);
+		d.transform = map_transform(d.transform);
 	}
 
 	//copy other's cameras, updating transform pointers:
 	cameras = other.cameras;
 	for (auto &c : cameras) {
-		c.transform = transform_to_transform.at(c.transform);
+		c.transform = map_transform(c.transform);
 	}
 
 	//copy other's lights, updating transform pointers:
 	lights = other.lights;
 	for (auto &l : lights) {
-		l.transform = transform_to_transform.at(l.transform);
+		l.transform = map_transform(l.transform);
+	}
+
+	//share other's base and attached scenes (if any), updating override pointers:
+	base = other.base;
+	attached = other.attached;
+	base_overrides = other.base_overrides;
+	for (auto &o : base_overrides) {
+		o = map_transform(o);
 	}
+
+	//share other's name index (it refers to transforms by index, so needs no fixup):
+	name_index = other.name_index;
+
+	cull_mode = other.cull_mode;
+	lod_size = other.lod_size;
+	lod_hysteresis = other.lod_hysteresis;
+	occlusion = other.occlusion;
+
+	//only build the old->new map if the caller asked for it:
+	if (transform_map) {
+		transform_map->clear();
+		transform_map->reserve(transforms.size() + 1);
+		transform_map->insert(std::make_pair(nullptr, nullptr)); //null transform maps to itself
+		for (size_t i = 0; i < transforms.size(); ++i) {
+			transform_map->insert(std::make_pair(&other.transforms[i], &transforms[i]));
+		}
+	}
+}
+
+Scene::NameIndex::NameIndex(NameIndex const &other) : name_ids(other.name_ids), named(other.named), tagged(other.tagged), sorted_names(other.sorted_names) {
+	id_names.assign(other.id_names.size(), nullptr);
+	for (auto const &ni : name_ids) {
+		id_names[ni.second] = &ni.first;
+	}
+}
+
+bool Scene::NameIndex::add(std::string const &name, uint32_t transform) {
+	auto ret = name_ids.emplace(name, NameID(named.size()));
+	if (ret.second) {
+		id_names.emplace_back(&ret.first->first);
+		named.emplace_back();
+	}
+	named[ret.first->second].emplace_back(transform);
+	tagged[tag_of(name)].emplace_back(transform);
+	return ret.second;
+}
+
+Scene::NameIndex &Scene::edit_name_index() {
+	if (!name_index) name_index = std::make_shared< NameIndex >();
+	else if (name_index.use_count() > 1) name_index = std::make_shared< NameIndex >(*name_index);
+	return *name_index;
+}
+
+Scene::NameID Scene::find_name(std::string const &name) const {
+	if (!name_index) return NoName;
+	auto f = name_index->name_ids.find(name);
+	return (f == name_index->name_ids.end() ? NameID(NoName) : f->second);
+}
+
+Scene::Transform *Scene::find(std::string const &name) const {
+	NameID id = find_name(name);
+	if (id == NoName || name_index->named[id].empty()) return nullptr;
+	return indexed(name_index->named[id][0]);
+}
+
+std::vector< Scene::Transform * > Scene::find_all(std::string const &name) const {
+	std::vector< Transform * > ret;
+	NameID id = find_name(name);
+	if (id == NoName) return ret;
+	ret.reserve(name_index->named[id].size());
+	for (uint32_t t : name_index->named[id]) ret.emplace_back(indexed(t));
+	return ret;
+}
+
+std::vector< Scene::Transform * > Scene::find_tagged(std::string const &tag) const {
+	std::vector< Transform * > ret;
+	if (!name_index) return ret;
+	auto f = name_index->tagged.find(tag);
+	if (f == name_index->tagged.end()) return ret;
+	ret.reserve(f->second.size());
+	for (uint32_t t : f->second) ret.emplace_back(indexed(t));
+	return ret;
+}
+
+void Scene::find_prefix(std::string const &prefix, std::vector< Transform * > *out) const {
+	assert(out);
+	if (!name_index) return;
+	NameIndex const &index = *name_index;
+	//names starting with 'prefix' are a contiguous run in name order, starting at the first name >= prefix:
+	auto begin = std::lower_bound(index.sorted_names.begin(), index.sorted_names.end(), prefix, [&index](NameID a, std::string const &p) {
+		return *index.id_names[a] < p;
+	});
+	for (auto i = begin; i != index.sorted_names.end(); ++i) {
+		std::string const &name = *index.id_names[*i];
+		if (name.compare(0, prefix.size(), prefix) != 0) break;
+		for (uint32_t t : index.named[*i]) out->emplace_back(indexed(t));
+	}
+}
+
+void Scene::index_name(Transform *transform) {
+	assert(transform);
+	size_t at = transforms.index_of(transform);
+	if (at == transforms.size()) {
+		throw std::runtime_error("Scene::index_name: transform '" + transform->name + "' is not in this scene.");
+	}
+	NameIndex &index = edit_name_index();
+	if (index.add(transform->name, uint32_t(at))) {
+		//keep sorted_names in name order (which find_prefix() relies on):
+		NameID id = NameID(index.named.size() - 1);
+		auto before = std::upper_bound(index.sorted_names.begin(), index.sorted_names.end(), id, [&index](NameID a, NameID b) {
+			return *index.id_names[a] < *index.id_names[b];
+		});
+		index.sorted_names.insert(before, id);
+	}
+}
+
+std::string Scene::tag_of(std::string const &name) {
+	size_t end = name.size();
+	while (end > 0 && name[end-1] >= '0' && name[end-1] <= '9') --end;
+	if (end == name.size()) return name; //no trailing number
+	if (end > 0 && (name[end-1] == '.' || name[end-1] == '_')) --end;
+	return name.substr(0, end);
+}
+
+void Scene::instance(Scene const &base_) {
+	if (base_.base) {
+		throw std::runtime_error("Scene::instance: base scene must not itself be an instance.");
+	}
+	transforms.clear();
+	drawables.clear();
+	cameras.clear();
+	lights.clear();
+	name_index.reset();
+	base = &base_;
+	base_overrides.clear();
+}
+
+Scene::Transform *Scene::override_transform(Transform const *base_transform) {
+	if (base == nullptr) {
+		throw std::runtime_error("Scene::override_transform: scene is not an instance.");
+	}
+	size_t index = base->transforms.index_of(base_transform);
+	if (index == base->transforms.size()) {
+		throw std::runtime_error("Scene::override_transform: transform is not in the base scene.");
+	}
+	if (base_overrides.empty()) base_overrides.assign(base->transforms.size(), nullptr);
+	if (base_overrides[index]) return base_overrides[index];
+
+	auto copy = [this](size_t i) {
+		Transform const &from = base->transforms[i];
+		transforms.emplace_back();
+		Transform &to = transforms.back();
+		to.name = from.name;
+		to.include = from.include;
+		to.position = from.position;
+		to.rotation = from.rotation;
+		to.scale = from.scale;
+		//n.b. this may be a base transform, which must not be modified through the pointer:
+		to.parent = (from.parent ? const_cast< Transform * >(resolve(from.parent)) : nullptr);
+		base_overrides[i] = &to;
+	};
+	copy(index);
+
+	//base transforms whose parent is now overridden need to follow it, so override them too:
+	// (loaded scenes list parents before children, so a single pass catches grandchildren as well)
+	for (size_t i = index + 1; i < base->transforms.size(); ++i) {
+		Transform const &t = base->transforms[i];
+		if (base_overrides[i] == nullptr && t.parent && resolve(t.parent) != t.parent) copy(i);
+	}
+
+	return base_overrides[index];
+}
+
+bool Scene::has_global_light() const {
+	bool found = false;
+	for_each_light([&found](Light const &light, Transform const &) {
+		if (light.type == Light::Hemisphere || light.type == Light::Directional) found = true;
+	});
+	return found;
+}
+
+Scene::Transform const *Scene::resolve(Transform const *transform) const {
+	if (base_overrides.empty()) return transform;
+	assert(base);
+	size_t index = base->transforms.index_of(transform);
+	if (index >= base_overrides.size() || base_overrides[index] == nullptr) return transform;
+	return base_overrides[index];
 }
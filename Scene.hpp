@@ -11,17 +11,21 @@
  */
 
 #include "GL.hpp"
+#include "Pool.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
-#include <list>
 #include <memory>
 #include <functional>
+#include <limits>
 #include <string>
 #include <vector>
 #include <unordered_map>
 
+struct OcclusionBuffer;
+struct Mesh;
+
 struct Scene {
 	struct Transform {
 		//Transform names are useful for debugging and looking up locations in a loaded scene:
@@ -43,9 +47,32 @@ struct Scene {
 		glm::mat4x3 make_local_to_parent() const;
 		glm::mat4x3 make_parent_to_local() const;
 		// ..relative to the world:
+		// (these are cached -- see 'world_cache' below -- so repeated calls on a static hierarchy do no matrix math)
 		glm::mat4x3 make_local_to_world() const;
 		glm::mat4x3 make_world_to_local() const;
 
+		//World matrices are cached along with the local values they were computed from.
+		// Since position/rotation/scale/parent are written directly by game code, staleness is
+		// detected by comparing against those stored values on access; a recompute bumps 'version',
+		// which is how changes propagate down to children (each child remembers its parent's version).
+		struct WorldCache {
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale = glm::vec3(1.0f);
+			Transform const *parent = nullptr;
+			uint32_t parent_version = 0; //parent's version when local_to_world was computed
+			uint32_t version = 0; //bumped whenever local_to_world is recomputed; 0 means "never computed"
+			bool world_to_local_valid = false; //world_to_local is computed lazily from local_to_world's inputs
+			glm::mat4x3 local_to_world = glm::mat4x3(1.0f);
+			glm::mat4x3 world_to_local = glm::mat4x3(1.0f);
+		};
+		mutable WorldCache world_cache;
+
+		//bring world_cache.local_to_world up to date (including all ancestors):
+		void update_world_cache() const;
+		//..assuming the parent's cache is already up to date (as in Scene::update_world_matrices):
+		void update_world_cache_from_parent() const;
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -57,6 +84,28 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//Object-space bounding box (usually copied from the Mesh), used by draw() to skip off-screen drawables:
+		// left empty (min > max) for drawables that should never be culled -- e.g., skinned meshes
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+		bool has_bounds() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+		//world-space box (as center +/- radius) that contains the object-space box:
+		void make_world_box(glm::mat4x3 const &object_to_world, glm::vec3 *center, glm::vec3 *radius) const;
+
+		//(optional) coarser versions of the mesh, for draw() to use when the drawable is small on screen:
+		// lods[0] is the full-detail range (the same as pipeline.start and count); see Mesh::lods and Scene::lod_size
+		enum : uint32_t { MaxLODs = 4 };
+		struct LOD {
+			GLuint start = 0;
+			GLuint count = 0;
+			GLint base_vertex = 0;
+		} lods[MaxLODs];
+		uint32_t lod_count = 0; //zero (or one) means there is only the range in 'pipeline'
+
+		//copy a mesh's vertex range (type, start, count, index_type, base_vertex, position_offset/scale),
+		// bounds, and levels of detail into this drawable; the caller still sets pipeline.program, vao, etc.:
+		void set_mesh(Mesh const &mesh);
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -68,13 +117,33 @@ struct Scene {
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
+			//..or, for indexed meshes (see Mesh.hpp), start and count are a range of the vao's element array:
+			GLenum index_type = GL_NONE; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT; passed to glDrawElementsBaseVertex
+			GLint base_vertex = 0; //added to each index; passed to glDrawElementsBaseVertex
+
+			//quantized meshes (see Mesh.hpp) store positions as 'position_offset + position_scale * Position':
+			// draw() folds this into the matrices it sends for positions (OBJECT_TO_CLIP, OBJECT_TO_LIGHT, and OBJECT_TO_WORLD)
+			glm::vec3 position_offset = glm::vec3(0.0f);
+			glm::vec3 position_scale = glm::vec3(1.0f);
+
 			//uniforms:
 			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
 			GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
+			//..or, for programs that read the above from the 'Object' uniform block (see UniformBlocks.hpp):
+			GLuint Object_block = -1U; //uniform block index; draw() binds this draw's range of the object buffer
 
 			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
 
+			//(optional) instanced variant of 'program':
+			// drawables that share program, vao, type, start, count, and textures (and have no set_uniforms)
+			// are drawn together with a single glDrawArraysInstanced (or glDrawElementsInstancedBaseVertex) using this program
+			struct Instancing {
+				GLuint program = 0; //reads Scene::InstanceData attributes starting at Scene::InstanceAttribLocation
+				GLuint WORLD_TO_CLIP_mat4 = -1U; //uniform location for world to clip space matrix
+				GLuint WORLD_TO_LIGHT_mat4x3 = -1U; //uniform location for world to light space matrix
+			} instancing;
+
 			//texture objects to bind for the first TextureCount textures:
 			enum : uint32_t { TextureCount = 4 };
 			struct TextureInfo {
@@ -120,10 +189,118 @@ struct Scene {
 	};
 
 	//Scenes, of course, may have many of the above objects:
-	std::list< Transform > transforms;
-	std::list< Drawable > drawables;
-	std::list< Camera > cameras;
-	std::list< Light > lights;
+	// (stored in Pools -- blocks of contiguous storage -- so pointers to them stay valid as more are added)
+	Pool< Transform > transforms;
+	Pool< Drawable > drawables;
+	Pool< Camera > cameras;
+	Pool< Light > lights;
+
+	//Prefab instances:
+	// a scene may share the transforms, drawables, cameras, and lights of an unchanging 'base' scene (e.g., a
+	// level as loaded) rather than holding copies of them. Only base transforms that this scene needs to change
+	// are copied into 'transforms' ("overridden"); draw() and lighting treat base and own contents as one scene.
+	// (base cameras are not merged -- look them up in base->cameras if needed)
+	Scene const *base = nullptr; //n.b. must outlive this scene, and must not itself have a base
+	std::vector< Transform * > base_overrides; //per base transform (by index): its override, or nullptr (empty if none)
+
+	//clear this scene and make it an instance of 'base':
+	void instance(Scene const &base);
+
+	//copy a base transform into this scene and use the copy in its place from then on:
+	// (its base descendants are overridden as well, so their world matrices follow the copy)
+	// returns the existing copy if the transform is already overridden; throws if it isn't a base transform
+	Transform *override_transform(Transform const *base_transform);
+
+	//the transform that is actually in effect for a base or own transform:
+	Transform const *resolve(Transform const *transform) const;
+
+	//Attached scenes:
+	// other scenes (e.g., streamed level cells -- see LevelStreamer.hpp) whose drawables and lights are drawn and lit
+	// along with this scene's. They keep their own transforms and must outlive their attachment.
+	// (copies of this scene share the same attached scenes)
+	std::vector< Scene const * > attached;
+
+	//call f(drawable, transform) / f(light, transform) for every drawable / light of the base, this scene, and
+	// attached scenes, with each one's transform resolved as above:
+	template< typename F > void for_each_drawable(F const &f) const;
+	template< typename F > void for_each_light(F const &f) const;
+
+	//does any of those lights light the whole scene (i.e., is a Hemisphere or Directional light)?
+	// (modes use this to decide whether to add their own default sky light)
+	bool has_global_light() const;
+
+	//bring the world matrices of all transforms (and those of the base and attached scenes) up to date in one pass:
+	// only transforms whose position, rotation, scale, or parent changed -- and their descendants -- are recomputed;
+	// when there are enough of those, each depth of the hierarchy is split across worker_pool (see WorkerPool.hpp)
+	// (draw() calls this first; until game code changes something, Transform::world_cache is then current)
+	void update_world_matrices() const;
+	enum : uint32_t { WorldMatricesGrain = 256 }; //transforms per worker task
+
+	//The hierarchy as seen by update_world_matrices(), as parallel arrays:
+	// transforms are given "slots" in depth order, so a parent's slot always comes before its children's, and each
+	// depth is a contiguous range. The order is only rebuilt when transforms are added or re-parented; from frame
+	// to frame, the pass just compares each transform's local values against those in its world_cache.
+	struct WorldArrays {
+		enum : uint32_t { NoParent = -1U };
+		//by index in 'transforms':
+		std::vector< Transform const * > parent_transform; //(to notice re-parenting)
+		std::vector< uint32_t > slot;
+		//by slot:
+		std::vector< uint32_t > index; //index in 'transforms'
+		std::vector< uint32_t > parent; //slot of parent (NoParent for roots and for parents in other scenes, e.g. the base)
+		std::vector< uint8_t > changed; //needs a new world matrix this pass
+		//by depth:
+		std::vector< uint32_t > levels; //slots [levels[d], levels[d+1]) are at depth d
+		std::vector< uint32_t > level_changed; //slots in each level that changed this pass
+		size_t transform_count = 0; //transforms.size() when the order was built
+	};
+	mutable WorldArrays world_arrays;
+	void build_world_arrays() const; //(re-)sort transforms into slots
+
+	//Name index:
+	// transforms added by load() (or passed to index_name()) can be looked up without scanning 'transforms':
+	// - by name, through a hash of interned names
+	// - by tag: a name without any trailing number, so "bead", "bead7", and "bead.012" are all tagged "bead"
+	// - by name prefix, through a sorted list of names (O(log names + matches))
+	// The index holds names as they were when indexed; call index_name() again after renaming a transform.
+	// (instances don't index their base's transforms -- look those up in *base and use override_transform())
+	typedef uint32_t NameID; //interned name
+	enum : NameID { NoName = -1U };
+	NameID find_name(std::string const &name) const; //NoName if no indexed transform has this name
+
+	//first indexed transform with a name (or nullptr), and all of them (in the order they were indexed):
+	Transform *find(std::string const &name) const;
+	std::vector< Transform * > find_all(std::string const &name) const;
+	//indexed transforms with a tag (e.g., find_tagged("bead") for bead1, bead2, ...):
+	std::vector< Transform * > find_tagged(std::string const &tag) const;
+	//append indexed transforms whose name starts with 'prefix' to *out (in name order):
+	void find_prefix(std::string const &prefix, std::vector< Transform * > *out) const;
+
+	//add a transform (e.g., one made by game code) to the index under its current name:
+	void index_name(Transform *transform);
+	//tag of a name (the name without a trailing number and the '.' or '_' before it):
+	static std::string tag_of(std::string const &name);
+
+	//-- name index internals --
+	//the index refers to transforms by their position in 'transforms', so it stays valid in copies (which match
+	// transforms up by index) and set() shares it rather than copying it; index_name() copies it first if it is shared:
+	struct NameIndex {
+		NameIndex() = default;
+		NameIndex(NameIndex const &); //(points id_names into the copy's name_ids)
+		NameIndex &operator=(NameIndex const &) = delete;
+
+		std::unordered_map< std::string, NameID > name_ids;
+		std::vector< std::string const * > id_names; //name of each NameID (points into name_ids)
+		std::vector< std::vector< uint32_t > > named; //indexed transforms by NameID
+		std::unordered_map< std::string, std::vector< uint32_t > > tagged; //indexed transforms by tag
+		std::vector< NameID > sorted_names; //NameIDs in name order
+
+		//add transforms[transform] under 'name'; returns true if the name is new (and so not yet in sorted_names):
+		bool add(std::string const &name, uint32_t transform);
+	};
+	std::shared_ptr< NameIndex > name_index; //(null until something is indexed)
+	NameIndex &edit_name_index(); //name_index, made unshared first
+	Transform *indexed(uint32_t transform) const { return const_cast< Transform * >(&transforms[transform]); }
 
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
 	void draw(Camera const &camera) const;
@@ -131,6 +308,133 @@ struct Scene {
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//Per-instance data for instanced drawing, as read by instanced programs:
+	// NOTE: to keep using the same vao for both variants of a program, its vertex attributes must sit
+	//  below InstanceAttribLocation (e.g., via layout(location=...) qualifiers); draw() points the
+	//  locations from InstanceAttribLocation up at the instance buffer the first time it instances a vao.
+	struct InstanceData {
+		glm::mat4x3 OBJECT_TO_WORLD; //occupies four attribute locations (one per column)
+		glm::mat3 NORMAL_TO_LIGHT; //occupies three attribute locations
+	};
+	enum : GLuint {
+		InstanceAttribLocation = 4, //OBJECT_TO_WORLD location; NORMAL_TO_LIGHT follows at +4
+		MinInstances = 2 //smallest group worth drawing instanced
+	};
+
+	//draw() doesn't submit drawables in list order; it first builds a compact record per drawable,
+	// sorts the records by (program, vao, texture, depth), and then submits them, skipping any
+	// program / vertex array / texture binds that would re-bind what is already bound.
+	// (instancable records sort by first vertex instead of depth, so copies of a mesh end up adjacent)
+	struct DrawRecord {
+		uint64_t key; //sort key; see make_draw_key() in Scene.cpp
+		Drawable const *drawable;
+		glm::mat4x3 object_to_world;
+		GLuint start, count; //vertex (or index) range to draw (pipeline.start and count, or those of the selected LOD)
+		GLint base_vertex; //(likewise, pipeline.base_vertex or the selected LOD's)
+		uint32_t lod; //level of detail drawn (0 for drawables without LODs)
+	};
+	mutable std::vector< DrawRecord > render_queue; //kept around between frames to avoid re-allocating
+	mutable std::vector< InstanceData > instance_queue; //per-instance data, by render_queue index (likewise kept around)
+
+	//sorted records are then split into batches -- each one draw call -- before submission:
+	// - copies of one mesh are drawn instanced
+	// - adjacent records with the same state *and* the same matrices (and no set_uniforms) are drawn with one
+	//   glMultiDrawArrays or glMultiDrawElementsBaseVertex; meshes in different files can share state when their
+	//   buffers are in the mesh arena (see MeshArena.hpp). (records with different matrices can't share a multi-draw
+	//   without gl_DrawID, which GL 3.3 doesn't have.)
+	struct DrawBatch {
+		uint32_t begin, end; //range of render_queue; more than one record means an instanced draw, unless 'multi'
+		size_t object_offset; //offset of this draw's 'Object' uniform block data (if the program uses one)
+		bool multi; //records drawn by one multi-draw (which otherwise goes like a single draw)
+		bool instanced() const { return end - begin > 1 && !multi; }
+	};
+	mutable std::vector< DrawBatch > draw_batches;
+	//per-record arguments for multi-draws (kept around between frames to avoid re-allocating):
+	mutable std::vector< GLint > multi_first; //first vertex or, for indexed draws, base vertex
+	mutable std::vector< GLsizei > multi_count;
+	mutable std::vector< void const * > multi_offset; //(indexed draws) offset of first index
+	mutable std::vector< char > object_uniforms; //'Object' block data for the whole frame, uploaded in one go
+
+	//draw() works in two stages:
+	// - GL-free CPU work (culling, sort keys, and per-draw matrices) is split into tasks of DrawTaskGrain
+	//   drawables (or batches) and run on worker_pool (see WorkerPool.hpp), filling the arrays above and below
+	// - then the calling (GL) thread replays the results: binds, uniform uploads, set_uniforms, and draw calls
+	enum : uint32_t { DrawTaskGrain = 256 };
+	struct DrawSource { //drawable to consider, along with its (resolved) transform
+		Drawable const *drawable;
+		Transform const *transform;
+	};
+	mutable std::vector< DrawSource > draw_sources;
+	//level of detail each draw source was drawn at last frame (by draw_sources index), for LOD hysteresis:
+	// kept by the drawing scene rather than on the drawable, since instances of one base draw the same drawables
+	// at different distances (an entry left by a different drawable -- e.g., after drawables were added -- starts over)
+	struct DrawLOD {
+		Drawable const *drawable = nullptr;
+		uint32_t lod = 0;
+	};
+	mutable std::vector< DrawLOD > draw_lods;
+	struct DrawPacket { //per-draw uniform values, for single draws of programs that don't use the 'Object' block
+		glm::mat4 object_to_clip;
+		glm::mat4x3 object_to_light;
+		glm::mat3 normal_to_light;
+	};
+	mutable std::vector< DrawPacket > draw_packets; //one per draw_batches entry (unused for instanced or 'Object' block draws)
+
+	//draw() skips drawables whose bounding box is outside the view frustum:
+	enum CullMode : uint8_t {
+		CullNone, //draw everything
+		CullScalar, //test each drawable's box against the frustum planes as it is visited
+		CullBatch, //gather world-space boxes, then test them four at a time (with SSE, where available)
+	} cull_mode = CullBatch;
+
+	//view frustum as six planes (n, d), with "inside" meaning dot(n, x) + d >= 0:
+	static void make_frustum_planes(glm::mat4 const &world_to_clip, glm::vec4 planes[6]);
+	//is a box entirely on the outside of any one of the planes?
+	// (conservative -- boxes near frustum corners may be kept even though they are not visible)
+	static bool box_outside(glm::vec4 const planes[6], glm::vec3 const &center, glm::vec3 const &radius);
+
+	//draw() picks a level of detail for drawables with LODs from the size of their bounds on screen:
+	// LOD 1 is used once the projected bounding sphere radius falls below 'lod_size' (as a fraction of half the
+	// view height), and each further LOD at half the size of the one before. To keep drawables near a boundary
+	// from popping back and forth, a drawable only moves to a coarser level once it is 'lod_hysteresis' (as a
+	// fraction of the boundary) below the boundary, and only back once it is that far above.
+	// (a lod_size of zero turns LOD selection off)
+	float lod_size = 0.2f;
+	float lod_hysteresis = 0.15f;
+
+	//draw() also skips drawables whose bounding box is hidden behind the occluders of 'occlusion' (if set):
+	// the occluders are rasterized on the CPU first thing in draw() (see OcclusionBuffer.hpp)
+	// (copies of this scene share the same buffer)
+	OcclusionBuffer *occlusion = nullptr;
+
+	//boxes gathered for CullBatch, as parallel arrays so they can be loaded four at a time:
+	struct CullBoxes {
+		std::vector< float > center_x, center_y, center_z; //world-space box center
+		std::vector< float > radius_x, radius_y, radius_z; //world-space box half-extents
+		std::vector< uint32_t > record; //index in render_queue
+		void clear();
+		void push_back(glm::vec3 const &center, glm::vec3 const &radius, uint32_t record);
+	};
+	mutable std::vector< CullBoxes > cull_boxes; //one per draw task (see below); kept around between frames to avoid re-allocating
+
+	//counts from the most recent draw() call:
+	struct DrawStats {
+		uint32_t visible = 0; //drawables that passed culling (and so were drawn)
+		uint32_t culled = 0; //drawables skipped because their bounds were outside the view frustum
+		uint32_t occluded = 0; //drawables skipped because their bounds were hidden behind occluders
+		uint32_t draws = 0; //draw calls (glDrawArrays, glDrawElementsBaseVertex, or their instanced or multi versions) issued
+		uint32_t instanced_draws = 0; //..of which were instanced
+		uint32_t instances = 0; //drawables drawn by those instanced draws
+		uint32_t multi_draws = 0; //draw calls that were multi-draws
+		uint32_t multi_drawn = 0; //drawables drawn by those multi-draws
+		uint32_t triangles = 0; //triangles drawn (by GL_TRIANGLES draws)
+		uint32_t triangles_saved = 0; //..and how many fewer that is than drawing every drawable at full detail
+		uint32_t lod_draws[Drawable::MaxLODs] = { }; //drawables drawn at each level of detail (drawables without LODs count as 0)
+		uint32_t state_changes = 0; //program + vertex array + texture binds actually issued
+		uint32_t state_changes_saved = 0; //binds that per-drawable submission (bind, draw, unbind) would have issued on top of those
+	};
+	mutable DrawStats draw_stats;
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
@@ -149,8 +453,33 @@ struct Scene {
 	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
 
 	//copy a scene (with proper pointer fixup):
+	// (copies of an instance share its base, and copy only its overrides)
 	Scene(Scene const &); //...as a constructor
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
+	// (copies are matched up by index, so no mapping is built -- and nothing is hashed -- unless one is asked for)
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
+
+	//move a scene:
+	// (the pools hand over their blocks, so pointers to transforms and objects stay valid and need no fixup)
+	Scene(Scene &&) = default;
+	Scene &operator=(Scene &&) = default;
 };
+
+template< typename F >
+void Scene::for_each_drawable(F const &f) const {
+	if (base) {
+		for (auto const &drawable : base->drawables) f(drawable, *resolve(drawable.transform));
+	}
+	for (auto const &drawable : drawables) f(drawable, *drawable.transform);
+	for (Scene const *scene : attached) scene->for_each_drawable(f);
+}
+
+template< typename F >
+void Scene::for_each_light(F const &f) const {
+	if (base) {
+		for (auto const &light : base->lights) f(light, *resolve(light.transform));
+	}
+	for (auto const &light : lights) f(light, *light.transform);
+	for (Scene const *scene : attached) scene->for_each_light(f);
+}
@@ -0,0 +1,330 @@
+#include "SceneBVH.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//-------------------------
+//Box helpers:
+
+static void expand(SceneBVH::Box *box, SceneBVH::Box const &other) {
+	box->min = glm::min(box->min, other.min);
+	box->max = glm::max(box->max, other.max);
+}
+
+static bool operator==(SceneBVH::Box const &a, SceneBVH::Box const &b) {
+	return a.min == b.min && a.max == b.max;
+}
+
+static bool included(SceneBVH::Item const &item) {
+	return item.transform->include;
+}
+
+//-------------------------
+
+bool SceneBVH::update_item(Item &item) {
+	assert(item.drawable);
+	Scene::Transform const *transform = item.transform;
+	assert(transform);
+
+	//transforms track when their world matrix changes, so unmoved items are cheap to skip:
+	transform->update_world_cache();
+	if (item.version != 0 && item.version == transform->world_cache.version) return false;
+	item.version = transform->world_cache.version;
+
+	glm::mat4x3 const &object_to_world = transform->world_cache.local_to_world;
+	Box box;
+	if (item.drawable->has_bounds()) {
+		glm::vec3 center, radius;
+		item.drawable->make_world_box(object_to_world, &center, &radius);
+		box.min = center - radius;
+		box.max = center + radius;
+	} else {
+		//no bounds? treat as a point at the origin:
+		box.min = box.max = object_to_world[3];
+	}
+
+	if (box == item.box) return false;
+	item.box = box;
+	return true;
+}
+
+void SceneBVH::build(Scene const &scene, std::function< bool(Scene::Drawable const &, Scene::Transform const &) > const &is_dynamic) {
+	static_items.clear();
+	dynamic_items.clear();
+	nodes.clear();
+
+	scene.for_each_drawable([&](Scene::Drawable const &drawable, Scene::Transform const &transform) {
+		Item item;
+		item.drawable = &drawable;
+		item.transform = &transform;
+		update_item(item);
+		if (!drawable.has_bounds() || (is_dynamic && is_dynamic(drawable, transform))) {
+			dynamic_items.emplace_back(item);
+		} else {
+			static_items.emplace_back(item);
+		}
+	});
+
+	if (!static_items.empty()) {
+		nodes.reserve(2 * static_items.size()); //(a binary tree over n leaves has fewer than 2n nodes)
+		nodes.emplace_back();
+		build_node(0, 0, uint32_t(static_items.size()));
+	}
+}
+
+void SceneBVH::build_node(uint32_t index, uint32_t begin, uint32_t end) {
+	assert(begin < end);
+
+	//n.b. nodes may be re-allocated by recursive calls, so always access via index:
+	nodes[index].first = begin;
+	nodes[index].count = end - begin;
+
+	Box box, centers;
+	for (uint32_t i = begin; i < end; ++i) {
+		expand(&box, static_items[i].box);
+		glm::vec3 center = 0.5f * (static_items[i].box.min + static_items[i].box.max);
+		expand(&centers, Box{ center, center });
+	}
+	nodes[index].box = box;
+
+	if (end - begin <= MaxLeafItems) {
+		for (uint32_t i = begin; i < end; ++i) {
+			static_items[i].leaf = index;
+		}
+		return;
+	}
+
+	//split at the median along the axis where item centers are most spread out:
+	glm::vec3 spread = centers.max - centers.min;
+	uint32_t axis = 0;
+	if (spread.y > spread[axis]) axis = 1;
+	if (spread.z > spread[axis]) axis = 2;
+
+	uint32_t mid = (begin + end) / 2;
+	std::nth_element(static_items.begin() + begin, static_items.begin() + mid, static_items.begin() + end,
+		[axis](Item const &a, Item const &b) {
+			return a.box.min[axis] + a.box.max[axis] < b.box.min[axis] + b.box.max[axis];
+		});
+
+	uint32_t child = uint32_t(nodes.size());
+	nodes.emplace_back();
+	nodes.emplace_back();
+	nodes[index].child = child;
+	nodes[child].parent = index;
+	nodes[child + 1].parent = index;
+
+	build_node(child, begin, mid);
+	build_node(child + 1, mid, end);
+}
+
+bool SceneBVH::refit_node(uint32_t index) {
+	Node &node = nodes[index];
+	Box box;
+	if (node.child == -1U) {
+		for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+			expand(&box, static_items[i].box);
+		}
+	} else {
+		expand(&box, nodes[node.child].box);
+		expand(&box, nodes[node.child + 1].box);
+	}
+	if (box == node.box) return false;
+	node.box = box;
+	return true;
+}
+
+void SceneBVH::refit() {
+	//static items: refit the leaves of moved items, then their ancestors (until a box stops changing):
+	std::vector< uint32_t > moved_leaves;
+	for (auto &item : static_items) {
+		if (update_item(item)) moved_leaves.emplace_back(item.leaf);
+	}
+	std::sort(moved_leaves.begin(), moved_leaves.end());
+	moved_leaves.erase(std::unique(moved_leaves.begin(), moved_leaves.end()), moved_leaves.end());
+
+	for (uint32_t leaf : moved_leaves) {
+		for (uint32_t index = leaf; index != -1U; index = nodes[index].parent) {
+			if (!refit_node(index)) break;
+		}
+	}
+
+	//dynamic items: just update:
+	for (auto &item : dynamic_items) {
+		update_item(item);
+	}
+}
+
+//-------------------------
+//Queries:
+
+//Shared traversal for the box-overlap-style queries:
+// 'test(box)' says whether a box might hold results (and, for items, whether they are results)
+// 'contains(box)' says whether everything in a box is a result (so a subtree can be added without further tests)
+// 'unbounded' says whether to return dynamic items without bounds regardless of 'test'
+template< typename Test, typename Contains >
+static void query_bvh(SceneBVH const &bvh, Test const &test, Contains const &contains, bool unbounded,
+	std::vector< Scene::Drawable const * > *out) {
+	assert(out);
+
+	if (!bvh.nodes.empty()) {
+		uint32_t stack[64]; //tree depth is ~log2(items / MaxLeafItems), so this is plenty
+		uint32_t stack_size = 0;
+		stack[stack_size++] = 0;
+		while (stack_size) {
+			SceneBVH::Node const &node = bvh.nodes[stack[--stack_size]];
+			if (!test(node.box)) continue;
+
+			if (node.child == -1U || contains(node.box)) {
+				bool test_items = (node.child == -1U); //(a contained subtree needs no per-item tests)
+				for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+					SceneBVH::Item const &item = bvh.static_items[i];
+					if (!included(item)) continue;
+					if (test_items && !test(item.box)) continue;
+					out->emplace_back(item.drawable);
+				}
+			} else {
+				assert(stack_size + 2 <= 64);
+				stack[stack_size++] = node.child;
+				stack[stack_size++] = node.child + 1;
+			}
+		}
+	}
+
+	for (auto const &item : bvh.dynamic_items) {
+		if (!included(item)) continue;
+		if ((unbounded && !item.drawable->has_bounds()) || test(item.box)) {
+			out->emplace_back(item.drawable);
+		}
+	}
+}
+
+void SceneBVH::query_frustum(glm::mat4 const &world_to_clip, std::vector< Scene::Drawable const * > *out) const {
+	glm::vec4 planes[6];
+	Scene::make_frustum_planes(world_to_clip, planes);
+
+	auto test = [&planes](Box const &box) {
+		return !Scene::box_outside(planes, 0.5f * (box.min + box.max), 0.5f * (box.max - box.min));
+	};
+	auto contains = [&planes](Box const &box) {
+		glm::vec3 center = 0.5f * (box.min + box.max);
+		glm::vec3 radius = 0.5f * (box.max - box.min);
+		for (uint32_t p = 0; p < 6; ++p) {
+			glm::vec3 n = glm::vec3(planes[p]);
+			if (glm::dot(n, center) + planes[p].w - glm::dot(glm::abs(n), radius) < 0.0f) return false;
+		}
+		return true;
+	};
+	query_bvh(*this, test, contains, true, out);
+}
+
+void SceneBVH::query_sphere(glm::vec3 const &center, float radius, std::vector< Scene::Drawable const * > *out) const {
+	auto test = [&center, radius](Box const &box) {
+		glm::vec3 close = glm::clamp(center, box.min, box.max);
+		glm::vec3 diff = center - close;
+		return glm::dot(diff, diff) <= radius * radius;
+	};
+	auto contains = [](Box const &) { return false; };
+	query_bvh(*this, test, contains, false, out);
+}
+
+void SceneBVH::query_box(glm::vec3 const &min, glm::vec3 const &max, std::vector< Scene::Drawable const * > *out) const {
+	auto test = [&min, &max](Box const &box) {
+		return box.min.x <= max.x && min.x <= box.max.x
+		    && box.min.y <= max.y && min.y <= box.max.y
+		    && box.min.z <= max.z && min.z <= box.max.z;
+	};
+	auto contains = [&min, &max](Box const &box) {
+		return min.x <= box.min.x && box.max.x <= max.x
+		    && min.y <= box.min.y && box.max.y <= max.y
+		    && min.z <= box.min.z && box.max.z <= max.z;
+	};
+	query_bvh(*this, test, contains, false, out);
+}
+
+//ray vs. box ("slab" test); returns the entry time, or infinity on a miss:
+static float ray_box(glm::vec3 const &origin, glm::vec3 const &inv_direction, float max_t, SceneBVH::Box const &box) {
+	glm::vec3 t0 = (box.min - origin) * inv_direction;
+	glm::vec3 t1 = (box.max - origin) * inv_direction;
+	glm::vec3 near = glm::min(t0, t1);
+	glm::vec3 far = glm::max(t0, t1);
+	float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+	float exit = std::min(std::min(far.x, far.y), std::min(far.z, max_t));
+	if (enter > exit) return std::numeric_limits< float >::infinity();
+	return enter;
+}
+
+bool SceneBVH::ray_cast(glm::vec3 const &origin, glm::vec3 const &direction, float max_t,
+	Scene::Drawable const **hit, float *hit_t,
+	std::function< bool(Scene::Drawable const &, Box const &) > const &filter) const {
+	assert(hit);
+
+	glm::vec3 inv_direction = 1.0f / direction;
+	Scene::Drawable const *best = nullptr;
+	float best_t = max_t;
+
+	auto consider = [&](Item const &item) {
+		if (!included(item)) return;
+		float t = ray_box(origin, inv_direction, best_t, item.box);
+		if (t <= best_t && (!filter || filter(*item.drawable, item.box))) {
+			best = item.drawable;
+			best_t = t;
+		}
+	};
+
+	if (!nodes.empty()) {
+		uint32_t stack[64];
+		uint32_t stack_size = 0;
+		stack[stack_size++] = 0;
+		while (stack_size) {
+			Node const &node = nodes[stack[--stack_size]];
+			//skip nodes that are missed or only hit beyond the best hit so far:
+			if (!(ray_box(origin, inv_direction, best_t, node.box) <= best_t)) continue;
+
+			if (node.child == -1U) {
+				for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+					consider(static_items[i]);
+				}
+			} else {
+				//visit the nearer child first (it's pushed last), so farther subtrees are more likely to be pruned:
+				float t_left = ray_box(origin, inv_direction, best_t, nodes[node.child].box);
+				float t_right = ray_box(origin, inv_direction, best_t, nodes[node.child + 1].box);
+				assert(stack_size + 2 <= 64);
+				if (t_left <= t_right) {
+					stack[stack_size++] = node.child + 1;
+					stack[stack_size++] = node.child;
+				} else {
+					stack[stack_size++] = node.child;
+					stack[stack_size++] = node.child + 1;
+				}
+			}
+		}
+	}
+
+	for (auto const &item : dynamic_items) {
+		consider(item);
+	}
+
+	if (!best) return false;
+	*hit = best;
+	if (hit_t) *hit_t = best_t;
+	return true;
+}
+
+glm::vec3 SceneBVH::clear_view(glm::vec3 const &target, glm::vec3 const &eye, float clearance,
+	std::function< bool(Scene::Drawable const &) > const &ignore) const {
+	glm::vec3 to_eye = eye - target;
+	float distance = glm::length(to_eye);
+	if (!(distance > 0.0f)) return eye;
+	glm::vec3 direction = to_eye / distance;
+
+	Scene::Drawable const *blocker = nullptr;
+	float blocker_t = distance;
+	bool blocked = ray_cast(target, direction, distance, &blocker, &blocker_t, [&](Scene::Drawable const &drawable, Box const &box) {
+		bool around_target = box.min.x <= target.x && target.x <= box.max.x
+			&& box.min.y <= target.y && target.y <= box.max.y
+			&& box.min.z <= target.z && target.z <= box.max.z;
+		return !around_target && !(ignore && ignore(drawable));
+	});
+	if (!blocked) return eye;
+	return target + direction * std::max(0.0f, blocker_t - clearance);
+}
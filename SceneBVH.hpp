@@ -0,0 +1,103 @@
+#pragma once
+
+/*
+ * A SceneBVH is a bounding volume hierarchy over the world-space bounds of
+ *  a Scene's drawables, for answering "what is near here?" questions
+ *  (frustum, sphere, box, and ray queries) without scanning every drawable.
+ *
+ * Drawables are split into two groups when the tree is built:
+ *  - static drawables go into a binary tree of boxes, which refit() adjusts
+ *    in place when (occasionally) one of them moves
+ *  - dynamic drawables (characters, anything without bounds) are kept in a
+ *    flat list that refit() recomputes every time
+ *
+ * The BVH stores pointers to drawables, so rebuild it if drawables are added
+ *  to (or the Scene is copied over, or base transforms are overridden in) the
+ *  scene it was built from.
+ *
+ */
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+struct SceneBVH {
+	//build over all drawables in 'scene' (including those of its base, if it is an instance):
+	// drawables without bounds are always dynamic; otherwise 'is_dynamic(drawable, transform)' (if given) decides.
+	void build(Scene const &scene, std::function< bool(Scene::Drawable const &, Scene::Transform const &) > const &is_dynamic = nullptr);
+
+	//bring boxes up to date with the drawables' transforms:
+	// (call once per frame after moving things and before querying)
+	void refit();
+
+	//Queries append matching drawables to *out.
+	// drawables whose transform has 'include' set to false are skipped.
+	// (for instances, a base drawable's transform may be overridden -- use Scene::resolve to find the one in effect)
+
+	//drawables whose box might be inside the view frustum:
+	// (drawables without bounds are always returned)
+	void query_frustum(glm::mat4 const &world_to_clip, std::vector< Scene::Drawable const * > *out) const;
+	//drawables whose box touches a sphere:
+	// (drawables without bounds are treated as a point at their transform's origin)
+	void query_sphere(glm::vec3 const &center, float radius, std::vector< Scene::Drawable const * > *out) const;
+	//drawables whose box touches an (axis-aligned, world-space) box:
+	void query_box(glm::vec3 const &min, glm::vec3 const &max, std::vector< Scene::Drawable const * > *out) const;
+
+	//nearest drawable whose box is hit by the ray origin + t * direction, 0 <= t <= max_t:
+	// returns false if nothing is hit; otherwise sets *hit and (if non-null) *hit_t.
+	// 'filter' (if given) is called with each drawable the ray hits, along with its world-space box, and returns
+	// false to ignore it -- e.g., a camera occlusion check can skip boxes around the character it looks at.
+	// (n.b. this hits boxes, not triangles, so it's a coarse pick)
+	struct Box;
+	bool ray_cast(glm::vec3 const &origin, glm::vec3 const &direction, float max_t,
+		Scene::Drawable const **hit, float *hit_t = nullptr,
+		std::function< bool(Scene::Drawable const &, Box const &) > const &filter = nullptr) const;
+
+	//camera occlusion: where to put a camera that looks at 'target' from 'eye' so that no drawable's box is in between:
+	// returns 'eye' if the view is clear; otherwise a point 'clearance' in front of the nearest blocking box.
+	// boxes that contain 'target' (the character being looked at, the ground under it) don't block, and neither do
+	// drawables that 'ignore' (if given) returns true for.
+	glm::vec3 clear_view(glm::vec3 const &target, glm::vec3 const &eye, float clearance,
+		std::function< bool(Scene::Drawable const &) > const &ignore = nullptr) const;
+
+	//-- internals --
+
+	struct Box {
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+	};
+
+	struct Item {
+		Scene::Drawable const *drawable = nullptr;
+		Scene::Transform const *transform = nullptr; //drawable's transform, resolved (see Scene::resolve)
+		Box box; //world-space
+		uint32_t version = 0; //transform's world_cache.version when 'box' was computed
+		uint32_t leaf = -1U; //(static items) index of the node that holds this item
+	};
+
+	//static items are ordered so that each leaf holds a contiguous range:
+	std::vector< Item > static_items;
+	std::vector< Item > dynamic_items;
+
+	struct Node {
+		Box box;
+		uint32_t parent = -1U;
+		uint32_t child = -1U; //left child (right child is child + 1), or -1U for leaves
+		uint32_t first = 0; //first item (in static_items) in this subtree
+		uint32_t count = 0; //number of items in this subtree
+	};
+	std::vector< Node > nodes; //nodes[0] is the root (if there are any static items)
+
+	enum : uint32_t { MaxLeafItems = 4 };
+
+	//update an item's box from its drawable; returns true if the box changed:
+	static bool update_item(Item &item);
+	//recursively split static_items[begin,end) under nodes[index]:
+	void build_node(uint32_t index, uint32_t begin, uint32_t end);
+	//recompute a node's box from its children (or items); returns true if the box changed:
+	bool refit_node(uint32_t index);
+};
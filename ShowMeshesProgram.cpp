@@ -1,5 +1,6 @@
 #include "ShowMeshesProgram.hpp"
 
+#include "Mesh.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -33,10 +34,12 @@ ShowMeshesProgram::ShowMeshesProgram() {
 		"out vec3 normal;\n"
 		"out vec4 color;\n"
 		"out vec2 texCoord;\n"
+		+ MeshBuffer::VertexGLSL +
 		"void main() {\n"
-		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
-		"	position = OBJECT_TO_LIGHT * Position;\n"
-		"	normal = NORMAL_TO_LIGHT * Normal;\n"
+		"	vec4 object_position = mesh_position(Position);\n"
+		"	gl_Position = OBJECT_TO_CLIP * object_position;\n"
+		"	position = OBJECT_TO_LIGHT * object_position;\n"
+		"	normal = NORMAL_TO_LIGHT * mesh_normal(Position, Normal);\n"
 		"	color = Color;\n"
 		"	texCoord = TexCoord;\n"
 		"}\n"
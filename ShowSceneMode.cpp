@@ -2,6 +2,7 @@
 #include "DrawLines.hpp"
 
 #include <iostream>
+#include <limits>
 
 ShowSceneMode::ShowSceneMode(Scene const &scene_) : scene(scene_) {
 
@@ -14,6 +15,8 @@ ShowSceneMode::ShowSceneMode(Scene const &scene_) : scene(scene_) {
 		scene_camera->near = 0.01f;
 		//scene_camera->transform and scene_camera->aspect will be set in draw()
 	}
+
+	bvh.build(scene);
 }
 
 ShowSceneMode::~ShowSceneMode() {
@@ -61,6 +64,28 @@ bool ShowSceneMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_
 			return true;
 		}
 	}
+	//right click: pick
+	if (evt.type == SDL_MOUSEBUTTONDOWN && evt.button.button == SDL_BUTTON_RIGHT) {
+		//ray from the camera through the clicked point:
+		// (the camera looks down its -z axis, and sees [-aspect,aspect]x[-1,1] * tan(fovy/2) at unit distance)
+		glm::vec2 at;
+		at.x = (evt.button.x + 0.5f) / float(window_size.x) * 2.0f - 1.0f;
+		at.y = (evt.button.y + 0.5f) / float(window_size.y) *-2.0f + 1.0f;
+		float tan_half_fovy = std::tan(0.5f * scene_camera->fovy);
+		glm::vec3 direction = scene_camera->transform->rotation * glm::normalize(glm::vec3(
+			at.x * tan_half_fovy * scene_camera->aspect,
+			at.y * tan_half_fovy,
+			-1.0f
+		));
+
+		picked = nullptr;
+		float distance = 0.0f;
+		if (bvh.ray_cast(scene_camera->transform->position, direction, std::numeric_limits< float >::infinity(), &picked, &distance)) {
+			std::cout << "Picked '" << picked->transform->name << "' (distance " << distance << ")." << std::endl;
+		}
+		return true;
+	}
+
 	//mouse wheel: dolly
 	if (evt.type == SDL_MOUSEWHEEL) {
 		camera.radius *= std::pow(0.5f, 0.1f * evt.wheel.y);
@@ -128,6 +153,19 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 				glm::u8vec4(0xff, 0xff, 0xff, 0xff)
 			);
 		}
+
+		//outline the picked drawable:
+		if (picked && picked->has_bounds()) {
+			glm::mat4x3 local_to_world = picked->transform->make_local_to_world();
+			glm::vec3 center = 0.5f * (picked->max + picked->min);
+			glm::vec3 radius = 0.5f * (picked->max - picked->min);
+			draw_lines.draw_box(glm::mat4x3(
+				local_to_world[0] * radius.x,
+				local_to_world[1] * radius.y,
+				local_to_world[2] * radius.z,
+				local_to_world * glm::vec4(center, 1.0f)
+			), glm::u8vec4(0xff, 0x88, 0x00, 0xff));
+		}
 		/*
 		glEnable(GL_LINE_SMOOTH);
 		glEnable(GL_BLEND);
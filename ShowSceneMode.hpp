@@ -9,6 +9,7 @@
 
 #include "Mode.hpp"
 #include "Scene.hpp"
+#include "SceneBVH.hpp"
 #include "Mesh.hpp"
 
 struct ShowSceneMode : Mode {
@@ -33,4 +34,8 @@ struct ShowSceneMode : Mode {
 	//mode uses a secondary Scene to hold a camera:
 	Scene camera_scene;
 	Scene::Camera *scene_camera = nullptr;
+
+	//right-click picks the drawable under the mouse (by its bounds), which is then outlined:
+	SceneBVH bvh;
+	Scene::Drawable const *picked = nullptr;
 };
@@ -18,6 +18,7 @@
 #include <list>
 
 #include "TextRendering.hpp"
+#include "AssetCache.hpp"
 
 struct SplashScreenMode : public Mode {
 	SplashScreenMode();
@@ -30,8 +31,9 @@ struct SplashScreenMode : public Mode {
 
 	// TextRenderer *roboto_renderer = new TextRenderer(data_path("fonts/Roboto-Medium.ttf"), 54);
 	// TextRenderer *patua_renderer = new TextRenderer(data_path("fonts/PatuaOne-Regular.ttf"), 54);
-	TextRenderer *rubik_renderer = new TextRenderer(data_path("fonts/Mansalva-Regular.ttf"), 200);
-	TextRenderer *main_text_renderer = rubik_renderer;
+	//(from the asset cache, so every mode draws with the same glyph textures)
+	std::shared_ptr< TextRenderer > rubik_renderer = assets.font(data_path("fonts/Mansalva-Regular.ttf"), 200);
+	TextRenderer *main_text_renderer = rubik_renderer.get();
 
 	float main_text_size = 0.5f;
     glm::vec3 main_text_color = glm::vec3(0.5f, 0.5f, 0.5f);
@@ -1,4 +1,6 @@
 #include "TextRendering.hpp"
+#include "GPUProfiler.hpp"
+#include "RenderStats.hpp"
 
 #include <sstream>
 
@@ -59,6 +61,8 @@ glm::vec2 TextRenderer::get_screen_pos(const glm::vec2 &rel_pos) {
 // https://www.freetype.org/freetype2/docs/tutorial/step1.html
 // https://github.com/harfbuzz/harfbuzz-tutorial/blob/master/hello-harfbuzz-freetype.c
 void TextRenderer::renderLine(std::string &line, float x, float y, float scale, glm::vec3 color) {
+    GPUProfiler::Scope scope("text");
+
     // OpenGL state
 	// ------------
 	glEnable(GL_CULL_FACE);
@@ -190,6 +194,13 @@ void TextRenderer::renderLine(std::string &line, float x, float y, float scale,
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.Advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
     }
+    // count the work for the performance HUD (one textured quad per glyph)
+    render_stats.frame.program_binds += 1;
+    render_stats.frame.vao_binds += 1;
+    render_stats.frame.texture_binds += glyph_len;
+    render_stats.frame.draws += glyph_len;
+    render_stats.frame.triangles += 2 * glyph_len;
+    render_stats.frame.upload_bytes += glyph_len * sizeof(float) * 6 * 4;
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
     // end of openGL text rendering tutorial code
@@ -2,11 +2,14 @@
 
 #include "WormMode.hpp"
 
+#include "AssetCache.hpp"
 #include "LitColorTextureProgram.hpp"
+#include "UniformBlocks.hpp"
 #include "BoneLitColorTextureProgram.hpp"
 #include "DrawLines.hpp"
 #include "Load.hpp"
 #include "Mesh.hpp"
+#include "MeshLoader.hpp"
 #include "Scene.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
@@ -23,54 +26,48 @@
 #include <cstddef>
 #include <random>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 // ************************* MESH ******************************
+//(loaded in the background, and set -- along with tutorial_worm_scene -- once it arrives; see load_tutorial_worm_meshes below)
 GLuint tutorial_worm_meshes_for_lit_color_texture_program = 0;
-Load< MeshBuffer > tutorial_worm_meshes(LoadTagDefault, [](){
-	// auto ret = new MeshBuffer(data_path("worm.pnct"));
-    auto ret = new MeshBuffer(data_path("level.pnct"));
-    tutorial_worm_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
-	return ret;
-});
+MeshBuffer const *tutorial_worm_meshes = nullptr;
 
 // ************************ ANIMATION **************************
+//(the same files as WormMode's; the asset cache hands both modes the same animations and vertex arrays)
+std::shared_ptr< BoneAnimation const > tutorial_worm_banims;
 BoneAnimation::Animation const *tutorial_worm_banim_crawl = nullptr;
-Load< BoneAnimation > tutorial_worm_banims(LoadTagDefault, [](){
-	auto ret = new BoneAnimation(data_path("level.banims"));
-	tutorial_worm_banim_crawl = &(ret->lookup("Crawl"));
-	return ret;
+GLuint tutorial_worm_banims_for_bone_lit_color_texture_program = 0;
+Load< void > load_tutorial_worm_banims(LoadTagDefault, [](){
+	tutorial_worm_banims = assets.bone_animation(data_path("level.banims"));
+	tutorial_worm_banim_crawl = &(tutorial_worm_banims->lookup("Crawl"));
+	tutorial_worm_banims_for_bone_lit_color_texture_program = assets.vao_for_program(tutorial_worm_banims, bone_lit_color_texture_program->program);
 });
 
+std::shared_ptr< BoneAnimation const > tutorial_rect_banims;
 BoneAnimation::Animation const *tutorial_rect_banim_moveY = nullptr;
-Load< BoneAnimation > tutorial_rect_banims(LoadTagDefault, [](){
-	auto ret = new BoneAnimation(data_path("rect.banims"));
-	tutorial_rect_banim_moveY = &(ret->lookup("MoveY"));
-	return ret;
+GLuint tutorial_rect_banims_for_bone_lit_color_texture_program = 0;
+Load< void > load_tutorial_rect_banims(LoadTagDefault, [](){
+	tutorial_rect_banims = assets.bone_animation(data_path("rect.banims"));
+	tutorial_rect_banim_moveY = &(tutorial_rect_banims->lookup("MoveY"));
+	tutorial_rect_banims_for_bone_lit_color_texture_program = assets.vao_for_program(tutorial_rect_banims, bone_lit_color_texture_program->program);
 });
 
+std::shared_ptr< BoneAnimation const > tutorial_blob_banims;
 BoneAnimation::Animation const *tutorial_blob_banim_walk = nullptr;
 BoneAnimation::Animation const *tutorial_blob_banim_flip = nullptr;
-Load< BoneAnimation > tutorial_blob_banims(LoadTagDefault, [](){
-	auto ret = new BoneAnimation(data_path("blob.banims"));
-	tutorial_blob_banim_walk = &(ret->lookup("Walk"));
-	tutorial_blob_banim_flip = &(ret->lookup("Flip"));
-	return ret;
-});
-
-Load< GLuint > tutorial_worm_banims_for_bone_lit_color_texture_program(LoadTagDefault, [](){
-	return new GLuint(tutorial_worm_banims->make_vao_for_program(bone_lit_color_texture_program->program));
-});
-
-Load< GLuint > tutorial_rect_banims_for_bone_lit_color_texture_program(LoadTagDefault, [](){
-	return new GLuint(tutorial_rect_banims->make_vao_for_program(bone_lit_color_texture_program->program));
-});
-
-Load< GLuint > tutorial_blob_banims_for_bone_lit_color_texture_program(LoadTagDefault, [](){
-	return new GLuint(tutorial_blob_banims->make_vao_for_program(bone_lit_color_texture_program->program));
+GLuint tutorial_blob_banims_for_bone_lit_color_texture_program = 0;
+Load< void > load_tutorial_blob_banims(LoadTagDefault, [](){
+	tutorial_blob_banims = assets.bone_animation(data_path("blob.banims"));
+	tutorial_blob_banim_walk = &(tutorial_blob_banims->lookup("Walk"));
+	tutorial_blob_banim_flip = &(tutorial_blob_banims->lookup("Flip"));
+	tutorial_blob_banims_for_bone_lit_color_texture_program = assets.vao_for_program(tutorial_blob_banims, bone_lit_color_texture_program->program);
 });
 
 // ************************** SCENE ****************************
-Load< Scene > tutorial_worm_scene(LoadTagDefault, []() -> Scene const * {
+Scene const *tutorial_worm_scene = nullptr; //(made once tutorial_worm_meshes has loaded)
+static Scene const *load_tutorial_worm_scene() {
 	// return new Scene(data_path("worm.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
     return new Scene(data_path("level.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
 		Mesh const &mesh = tutorial_worm_meshes->lookup(mesh_name);
@@ -81,39 +78,50 @@ Load< Scene > tutorial_worm_scene(LoadTagDefault, []() -> Scene const * {
 		drawable.pipeline = lit_color_texture_program_pipeline;
 
 		drawable.pipeline.vao = tutorial_worm_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
+		drawable.set_mesh(mesh);
 
 	});
+}
+
+//the level's meshes are the biggest file, so they load while the intro and splash screens play:
+Load< void > load_tutorial_worm_meshes(LoadTagDefault, [](){
+	// mesh_loader.load(data_path("worm.pnct"), ...
+	mesh_loader.load(data_path("level.pnct"), [](std::shared_ptr< MeshBuffer const > const &buffer){
+		tutorial_worm_meshes = buffer.get();
+		tutorial_worm_meshes_for_lit_color_texture_program = assets.vao_for_program(buffer, lit_color_texture_program->program);
+		tutorial_worm_scene = load_tutorial_worm_scene();
+	});
 });
 
 // *************************** WALK MESH ***********************
 WalkMesh const *tutorial_walkmesh = nullptr;
-Load< WalkMeshes > tutorial_worm_walkmeshes(LoadTagDefault, []() -> WalkMeshes const * {
-	// WalkMeshes *ret = new WalkMeshes(data_path("worm.w"));
-    WalkMeshes *ret = new WalkMeshes(data_path("level.w"));
-	tutorial_walkmesh = &ret->lookup("WalkMesh");
-	return ret;
+std::shared_ptr< WalkMeshes const > tutorial_worm_walkmeshes;
+Load< void > load_tutorial_worm_walkmeshes(LoadTagDefault, [](){
+	// tutorial_worm_walkmeshes = assets.walkmeshes(data_path("worm.w"));
+    tutorial_worm_walkmeshes = assets.walkmeshes(data_path("level.w"));
+	tutorial_walkmesh = &tutorial_worm_walkmeshes->lookup("WalkMesh");
 });
 
 // ************************ WORM MODE **************************
-TutorialMode::TutorialMode() : scene(*tutorial_worm_scene) {
+TutorialMode::TutorialMode() {
+    //(the level may still be loading if the intro was skipped quickly)
+    mesh_loader.finish();
+
     // MESH & WALKMESH SETUP ---------------------------------------------------
     {
+        //share the loaded level rather than copying it; only the transforms gameplay changes are copied:
+        scene.instance(*tutorial_worm_scene);
+
         //create a player transform:
         scene.transforms.emplace_back();
         player.transform = &scene.transforms.back();
 
-        //get character mesh
-        for (auto &transform : scene.transforms) {
-            if (transform.name == "Catball") catball.ch_transform = &transform;
-            if (transform.name == "Rectangle") rectangle.ch_transform = &transform;
-            //if (transform.name == "Blob") blob.ch_transform = &transform;
-            if (transform.name.substr(0, transform.name.size()-1) == "bead") {
-                beads.push_back(&transform);
-            }
-            // if (transform.name.substr(0, 4) == "")
+        //get character mesh (through the level's name index, rather than scanning every transform)
+        if (Scene::Transform *transform = tutorial_worm_scene->find("Catball")) catball.ch_transform = scene.override_transform(transform);
+        if (Scene::Transform *transform = tutorial_worm_scene->find("Rectangle")) rectangle.ch_transform = scene.override_transform(transform);
+        //if (Scene::Transform *transform = tutorial_worm_scene->find("Blob")) blob.ch_transform = scene.override_transform(transform);
+        for (Scene::Transform *transform : tutorial_worm_scene->find_tagged("bead")) { // bead1, bead2, ...
+            beads.push_back(scene.override_transform(transform));
         }
 
         // Bead count 
@@ -141,7 +149,7 @@ TutorialMode::TutorialMode() : scene(*tutorial_worm_scene) {
 		Scene::Drawable::Pipeline worm_info;
 		worm_info = bone_lit_color_texture_program_pipeline;
 
-		worm_info.vao = *tutorial_worm_banims_for_bone_lit_color_texture_program;
+		worm_info.vao = tutorial_worm_banims_for_bone_lit_color_texture_program;
 		worm_info.start = tutorial_worm_banims->mesh.start;
 		worm_info.count = tutorial_worm_banims->mesh.count;
 
@@ -178,7 +186,7 @@ TutorialMode::TutorialMode() : scene(*tutorial_worm_scene) {
 		Scene::Drawable::Pipeline rect_info;
 		rect_info = bone_lit_color_texture_program_pipeline;
 
-		rect_info.vao = *tutorial_rect_banims_for_bone_lit_color_texture_program;
+		rect_info.vao = tutorial_rect_banims_for_bone_lit_color_texture_program;
 		rect_info.start = tutorial_rect_banims->mesh.start;
 		rect_info.count = tutorial_rect_banims->mesh.count;
 
@@ -215,7 +223,7 @@ TutorialMode::TutorialMode() : scene(*tutorial_worm_scene) {
 		Scene::Drawable::Pipeline blob_info;
 		blob_info = bone_lit_color_texture_program_pipeline;
 
-		blob_info.vao = *tutorial_blob_banims_for_bone_lit_color_texture_program;
+		blob_info.vao = tutorial_blob_banims_for_bone_lit_color_texture_program;
 		blob_info.start = tutorial_blob_banims->mesh.start;
 		blob_info.count = tutorial_blob_banims->mesh.count;
 
@@ -276,6 +284,14 @@ TutorialMode::TutorialMode() : scene(*tutorial_worm_scene) {
         //rectangle.ch_transform->position = character_off_pos;
     }
 
+    // SPATIAL QUERIES ---------------------------------------------------------
+    {
+        //the level is static except for the characters (which move every frame):
+        drawable_bvh.build(scene, [this](Scene::Drawable const &, Scene::Transform const &transform) {
+            return &transform == catball.ch_transform || &transform == rectangle.ch_transform;
+        });
+    }
+
 }
 
 TutorialMode::~TutorialMode() {
@@ -745,6 +761,13 @@ void TutorialMode::update(float elapsed) {
         // Update camera location and rotation
         camera->transform->rotation = player.transform->rotation * camera_offset_rot;
         camera->transform->position = (player.transform->position + (player.transform->rotation *camera_offset_pos));
+
+        // Move the camera in front of any level geometry between it and the player (beads are too small to matter)
+        drawable_bvh.refit();
+        camera->transform->position = drawable_bvh.clear_view(player.transform->position, camera->transform->position,
+            camera_clearance, [this](Scene::Drawable const &drawable) {
+                return std::find(beads.begin(), beads.end(), scene.resolve(drawable.transform)) != beads.end();
+            });
     }
     
     // Check for collision with beads
@@ -881,12 +904,16 @@ void TutorialMode::draw(glm::uvec2 const &drawable_size) {
 
 	//Draw scene:
     //set up light type and position for lit_color_texture_program:
-	// TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
+	// (the 'Light' uniform block is shared by every lit program, so this is one buffer update)
+	// the scene's own Light(s) are shaded by Scene::draw (see LightClusters.hpp); this default sky light
+	// stays on as ambient fill under point and spot lights, and is only dropped if the scene brings its own sky or sun:
+	{
+		UniformBlocks::Light light;
+		light.LIGHT_TYPE = 1;
+		light.LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f,-1.0f);
+		light.LIGHT_ENERGY = (scene.has_global_light() ? glm::vec3(0.0f) : glm::vec3(1.0f, 1.0f, 0.95f));
+		uniform_blocks->set_light(light);
+	}
 
     // grey world background 
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
@@ -1063,8 +1090,16 @@ void TutorialMode::beadCollision(float eps) {
         threshold = 6.5f + eps; 
     }
 
-    for (size_t i = 0; i < beads.size(); i++) { 
-        auto bead = beads[i];
+    //only beads whose bounds are within reach can be collected:
+    drawable_bvh.refit();
+    std::vector< Scene::Drawable const * > nearby;
+    drawable_bvh.query_sphere(ch_pos, std::sqrt(threshold), &nearby);
+
+    for (Scene::Drawable const *drawable : nearby) { 
+        //(beads are overrides of level transforms, so look up the one in effect)
+        auto found = std::find(beads.begin(), beads.end(), scene.resolve(drawable->transform));
+        if (found == beads.end()) continue;
+        Scene::Transform *bead = *found;
         if (!bead->include) continue;
         glm::vec3 bead_pos = bead->position; 
         glm::vec3 pos_diff = ch_pos - bead_pos;
@@ -5,6 +5,7 @@
 #include "BoneAnimation.hpp"
 #include "GL.hpp"
 #include "Scene.hpp"
+#include "SceneBVH.hpp"
 #include "WalkMesh.hpp"
 
 #include "data_path.hpp"
@@ -18,6 +19,7 @@
 #include <list>
 
 #include "TextRendering.hpp"
+#include "AssetCache.hpp"
 
 struct TutorialMode : public Mode {
 	TutorialMode();
@@ -43,6 +45,7 @@ struct TutorialMode : public Mode {
 	glm::quat camera_offset_rot = glm::angleAxis(glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     	glm::vec3 character_off_pos = glm::vec3(-100.0f, -100.0f, -100.0f);
 	glm::quat cam_init_rot;
+	float camera_clearance = 0.5f; // distance kept between the camera and geometry that would block its view
 
 	// Scene:
 	Scene scene;
@@ -109,6 +112,9 @@ struct TutorialMode : public Mode {
 	std::vector< Scene::Transform* > beads;
 	size_t num_beads; 
 
+	// Spatial index over the scene's drawables (used for bead pickup and keeping the camera's view clear):
+	SceneBVH drawable_bvh;
+
 	// Lives and collisions 
 	uint8_t num_lives = 3;
 	std::vector < Scene::Transform* > obstacles;
@@ -117,8 +123,9 @@ struct TutorialMode : public Mode {
 	float game_time = 0.0f;
 
 	// Font
-	TextRenderer *mansalva_renderer = new TextRenderer(data_path("fonts/Mansalva-Regular.ttf"), 200);
-	TextRenderer *main_text_renderer = mansalva_renderer;
+	//(from the asset cache, so every mode draws with the same glyph textures)
+	std::shared_ptr< TextRenderer > mansalva_renderer = assets.font(data_path("fonts/Mansalva-Regular.ttf"), 200);
+	TextRenderer *main_text_renderer = mansalva_renderer.get();
 
 	float main_text_size = 0.3f;
     glm::vec3 main_text_color = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -0,0 +1,94 @@
+#include "UniformBlocks.hpp"
+
+#include "RenderStats.hpp"
+#include "gl_errors.hpp"
+
+Load< UniformBlocks > uniform_blocks(LoadTagEarly, []() -> UniformBlocks const * {
+	return new UniformBlocks();
+});
+
+std::string const UniformBlocks::CameraGLSL =
+	"layout(std140) uniform Camera {\n"
+	"	mat4 WORLD_TO_CLIP;\n"
+	"	mat4x3 WORLD_TO_LIGHT;\n"
+	"};\n"
+;
+
+std::string const UniformBlocks::LightGLSL =
+	"layout(std140) uniform Light {\n"
+	"	vec3 LIGHT_LOCATION;\n"
+	"	float LIGHT_CUTOFF;\n"
+	"	vec3 LIGHT_DIRECTION;\n"
+	"	int LIGHT_TYPE;\n"
+	"	vec3 LIGHT_ENERGY;\n"
+	"};\n"
+;
+
+std::string const UniformBlocks::ObjectGLSL =
+	"layout(std140) uniform Object {\n"
+	"	mat4 OBJECT_TO_CLIP;\n"
+	"	mat4x3 OBJECT_TO_LIGHT;\n"
+	"	mat3 NORMAL_TO_LIGHT;\n"
+	"};\n"
+;
+
+UniformBlocks::UniformBlocks() {
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) offset_alignment = GLuint(alignment);
+
+	//allocate per-frame buffers (with default contents) and leave them bound to their binding points:
+	auto make_buffer = [](GLuint binding, GLsizeiptr size, void const *data) -> GLuint {
+		GLuint buffer = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+		return buffer;
+	};
+
+	Camera camera;
+	camera_buffer = make_buffer(CameraBinding, sizeof(camera), &camera);
+	Light light;
+	light_buffer = make_buffer(LightBinding, sizeof(light), &light);
+
+	//object data is (re-)allocated and bound by Scene::draw:
+	glGenBuffers(1, &object_buffer);
+
+	GL_ERRORS();
+}
+
+UniformBlocks::~UniformBlocks() {
+	glDeleteBuffers(1, &camera_buffer);
+	camera_buffer = 0;
+	glDeleteBuffers(1, &light_buffer);
+	light_buffer = 0;
+	glDeleteBuffers(1, &object_buffer);
+	object_buffer = 0;
+}
+
+void UniformBlocks::bind_blocks(GLuint program) {
+	auto bind = [program](char const *name, GLuint binding) {
+		GLuint index = glGetUniformBlockIndex(program, name);
+		if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+	};
+	bind("Camera", CameraBinding);
+	bind("Light", LightBinding);
+	bind("Object", ObjectBinding);
+	bind("Clusters", ClustersBinding);
+}
+
+void UniformBlocks::set_camera(Camera const &camera) const {
+	glBindBuffer(GL_UNIFORM_BUFFER, camera_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera), &camera);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	render_stats.frame.upload_bytes += sizeof(camera);
+}
+
+void UniformBlocks::set_light(Light const &light) const {
+	glBindBuffer(GL_UNIFORM_BUFFER, light_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(light), &light);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	render_stats.frame.upload_bytes += sizeof(light);
+}
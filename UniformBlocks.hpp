@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * Uniform blocks shared between shader programs.
+ *
+ * Rather than uploading camera, lighting, and object matrices to each
+ *  program with glUniform* calls, programs declare these std140 blocks
+ *  (pasting in the GLSL below) and read them from buffers bound at fixed
+ *  binding points:
+ *  - 'Camera' and 'Light' are written once per frame
+ *  - 'Object' is written for every draw by Scene::draw(), which packs all of
+ *    a frame's object data into one buffer and binds a range of it per draw
+ *
+ */
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+
+struct UniformBlocks {
+	UniformBlocks();
+	~UniformBlocks();
+
+	//binding points used for each block:
+	enum : GLuint {
+		CameraBinding = 0,
+		LightBinding = 1,
+		ObjectBinding = 2,
+		ClustersBinding = 3, //'Clusters' block; see LightClusters.hpp
+	};
+
+	//std140 layouts of each block:
+	// (n.b. std140 pads vec3 to 16 bytes, and pads matrix columns to vec4)
+	struct Camera {
+		glm::mat4 WORLD_TO_CLIP = glm::mat4(1.0f);
+		glm::mat4 WORLD_TO_LIGHT = glm::mat4(1.0f); //declared as mat4x3 in GLSL (last row ignored)
+	};
+	static_assert(sizeof(Camera) == 128, "Camera matches std140 layout.");
+
+	struct Light {
+		glm::vec3 LIGHT_LOCATION = glm::vec3(0.0f);
+		float LIGHT_CUTOFF = 1.0f;
+		glm::vec3 LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f, -1.0f);
+		int32_t LIGHT_TYPE = 1; //0: point, 1: hemisphere, 2: spot, 3: directional
+		glm::vec3 LIGHT_ENERGY = glm::vec3(1.0f);
+		float padding_ = 0.0f;
+	};
+	static_assert(sizeof(Light) == 48, "Light matches std140 layout.");
+
+	struct Object {
+		glm::mat4 OBJECT_TO_CLIP = glm::mat4(1.0f);
+		glm::mat4 OBJECT_TO_LIGHT = glm::mat4(1.0f); //declared as mat4x3 in GLSL (last row ignored)
+		glm::mat3x4 NORMAL_TO_LIGHT = glm::mat3x4(1.0f); //declared as mat3 in GLSL (last row ignored)
+	};
+	static_assert(sizeof(Object) == 176, "Object matches std140 layout.");
+
+	//GLSL declarations of the above blocks, for inclusion in shader code:
+	static std::string const CameraGLSL;
+	static std::string const LightGLSL;
+	static std::string const ObjectGLSL;
+
+	//connect whichever of the blocks 'program' declares to the binding points above:
+	// (call once after compiling each program that uses the blocks)
+	static void bind_blocks(GLuint program);
+
+	//buffers holding the data for each block:
+	GLuint camera_buffer = 0;
+	GLuint light_buffer = 0;
+	GLuint object_buffer = 0; //(written and bound by Scene::draw)
+
+	//ranges bound with glBindBufferRange must start at multiples of this:
+	GLuint offset_alignment = 256;
+
+	//per-frame updates (each is a single buffer update):
+	void set_camera(Camera const &camera) const;
+	void set_light(Light const &light) const;
+};
+
+extern Load< UniformBlocks > uniform_blocks;
@@ -96,6 +96,8 @@ struct WalkMesh {
 struct WalkMeshes {
 	//load a list of named WalkMeshes from a file:
 	WalkMeshes(std::string const &filename);
+	//..or start with none:
+	WalkMeshes() = default;
 
 	//retrieve a WalkMesh by name:
 	WalkMesh const &lookup(std::string const &name) const;
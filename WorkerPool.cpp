@@ -0,0 +1,108 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+Load< WorkerPool > worker_pool(LoadTagEarly, []() -> WorkerPool const * {
+	return new WorkerPool();
+});
+
+//set while a thread is running part of a job, so nested parallel_for calls run serially instead of deadlocking:
+static thread_local bool in_job = false;
+
+WorkerPool::WorkerPool(uint32_t count) {
+	if (count == 0) {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		count = (hardware > 1 ? hardware - 1 : 0);
+	}
+	workers.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		workers.emplace_back(&WorkerPool::worker_main, this);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void WorkerPool::run_job() const {
+	bool was_in_job = in_job;
+	in_job = true;
+	while (true) {
+		size_t begin = job_next.fetch_add(job_grain);
+		if (begin >= job_count) break;
+		size_t end = std::min(job_count, begin + job_grain);
+		try {
+			(*job)(begin, end);
+		} catch (...) {
+			std::unique_lock< std::mutex > lock(mutex);
+			if (!job_error) job_error = std::current_exception();
+		}
+	}
+	in_job = was_in_job;
+}
+
+void WorkerPool::worker_main() {
+	uint64_t seen = 0;
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		wake.wait(lock, [&]() { return quit || generation != seen; });
+		if (quit) break;
+		seen = generation;
+
+		lock.unlock();
+		run_job();
+		lock.lock();
+
+		assert(busy > 0);
+		busy -= 1;
+		if (busy == 0) done.notify_one();
+	}
+}
+
+void WorkerPool::parallel_for(size_t count, size_t grain, std::function< void(size_t, size_t) > const &f) const {
+	if (count == 0) return;
+	grain = std::max< size_t >(grain, 1);
+
+	//not worth splitting (or already inside a job)? just run it here:
+	if (workers.empty() || count <= grain || in_job) {
+		f(0, count);
+		return;
+	}
+
+	std::unique_lock< std::mutex > call_lock(call_mutex);
+
+	{ //start the job:
+		std::unique_lock< std::mutex > lock(mutex);
+		job = &f;
+		job_count = count;
+		job_grain = grain;
+		job_next = 0;
+		job_error = nullptr;
+		busy = uint32_t(workers.size());
+		generation += 1;
+	}
+	wake.notify_all();
+
+	//help out:
+	run_job();
+
+	//wait for the workers to finish up:
+	// (every worker runs every job -- possibly finding nothing left to do -- so 'busy' reaching zero means all ranges are done)
+	std::exception_ptr error;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		done.wait(lock, [this]() { return busy == 0; });
+		job = nullptr;
+		std::swap(error, job_error);
+	}
+
+	if (error) std::rethrow_exception(error);
+}
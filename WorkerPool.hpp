@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ * WorkerPool keeps a set of worker threads around for splitting up
+ *  data-parallel work (e.g., Scene::update_world_matrices).
+ *
+ * parallel_for() hands out chunks of an index range to the workers and
+ *  the calling thread, and returns once every chunk is done. Work is split
+ *  only when it's big enough to be worth it, and calls made from inside a
+ *  chunk just run serially.
+ *
+ */
+
+#include "Load.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerPool {
+	//start 'count' workers (or, if zero, one fewer than the number of hardware threads):
+	explicit WorkerPool(uint32_t count = 0);
+	~WorkerPool();
+
+	//call f(begin, end) on consecutive ranges (at most 'grain' long) covering [0, count):
+	// ranges may run at the same time on different threads, so f must be safe to call that way
+	// if f throws, the (first) exception is re-thrown here once the remaining ranges finish
+	void parallel_for(size_t count, size_t grain, std::function< void(size_t, size_t) > const &f) const;
+
+	//number of worker threads (not counting threads that call parallel_for):
+	uint32_t worker_count() const { return uint32_t(workers.size()); }
+
+	//-- internals --
+	std::vector< std::thread > workers;
+
+	mutable std::mutex call_mutex; //one parallel_for at a time
+	mutable std::mutex mutex; //guards everything below
+	mutable std::condition_variable wake; //signalled when a job starts (or workers should quit)
+	mutable std::condition_variable done; //signalled when the last worker finishes a job
+	bool quit = false;
+	mutable uint64_t generation = 0; //bumped for each job
+	mutable uint32_t busy = 0; //workers still running the current job
+
+	//current job:
+	mutable std::function< void(size_t, size_t) > const *job = nullptr;
+	mutable size_t job_count = 0;
+	mutable size_t job_grain = 1;
+	mutable std::atomic< size_t > job_next{0}; //start of next range to hand out
+	mutable std::exception_ptr job_error;
+
+	void run_job() const; //grab and run ranges until none are left
+	void worker_main();
+};
+
+extern Load< WorkerPool > worker_pool;
@@ -1,10 +1,14 @@
 #include "WormMode.hpp"
 
+#include "AssetCache.hpp"
 #include "LitColorTextureProgram.hpp"
+#include "UniformBlocks.hpp"
 #include "BoneLitColorTextureProgram.hpp"
 #include "DrawLines.hpp"
 #include "Load.hpp"
 #include "Mesh.hpp"
+#include "MeshLoader.hpp"
+#include "OcclusionBuffer.hpp"
 #include "Scene.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
@@ -21,56 +25,76 @@
 #include <cstddef>
 #include <random>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+// ************************ STREAMING **************************
+//if the level has been split into streaming cells (see scenes/split-cells.py), only its resident part
+// (characters, beads, ...) is loaded up front, and LevelStreamer loads the rest around the player:
+static bool level_is_streamed() {
+    static bool streamed = std::ifstream(data_path("level.cells"), std::ios::binary).good();
+    return streamed;
+}
 
 // ************************* MESH ******************************
+//(loaded in the background, and set -- along with worm_scene -- once it arrives; see load_worm_meshes below)
 GLuint worm_meshes_for_lit_color_texture_program = 0;
-Load< MeshBuffer > worm_meshes(LoadTagDefault, [](){
-	// auto ret = new MeshBuffer(data_path("worm.pnct"));
-    auto ret = new MeshBuffer(data_path("level.pnct"));
-    worm_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
-	return ret;
-});
+MeshBuffer const *worm_meshes = nullptr;
 
 // ************************ ANIMATION **************************
+//(shared with TutorialMode through the asset cache, vertex arrays included)
+std::shared_ptr< BoneAnimation const > worm_banims;
 BoneAnimation::Animation const *worm_banim_crawl = nullptr;
-Load< BoneAnimation > worm_banims(LoadTagDefault, [](){
-	auto ret = new BoneAnimation(data_path("level.banims"));
-	worm_banim_crawl = &(ret->lookup("Crawl"));
-	return ret;
+GLuint worm_banims_for_bone_lit_color_texture_program = 0;
+Load< void > load_worm_banims(LoadTagDefault, [](){
+	worm_banims = assets.bone_animation(data_path("level.banims"));
+	worm_banim_crawl = &(worm_banims->lookup("Crawl"));
+	worm_banims_for_bone_lit_color_texture_program = assets.vao_for_program(worm_banims, bone_lit_color_texture_program->program);
 });
 
+std::shared_ptr< BoneAnimation const > rect_banims;
 BoneAnimation::Animation const *rect_banim_moveY = nullptr;
-Load< BoneAnimation > rect_banims(LoadTagDefault, [](){
-	auto ret = new BoneAnimation(data_path("rect.banims"));
-	rect_banim_moveY = &(ret->lookup("MoveY"));
-	return ret;
+GLuint rect_banims_for_bone_lit_color_texture_program = 0;
+Load< void > load_rect_banims(LoadTagDefault, [](){
+	rect_banims = assets.bone_animation(data_path("rect.banims"));
+	rect_banim_moveY = &(rect_banims->lookup("MoveY"));
+	rect_banims_for_bone_lit_color_texture_program = assets.vao_for_program(rect_banims, bone_lit_color_texture_program->program);
 });
 
+std::shared_ptr< BoneAnimation const > blob_banims;
 BoneAnimation::Animation const *blob_banim_walk = nullptr;
 BoneAnimation::Animation const *blob_banim_flip = nullptr;
-Load< BoneAnimation > blob_banims(LoadTagDefault, [](){
-	auto ret = new BoneAnimation(data_path("blob.banims"));
-	blob_banim_walk = &(ret->lookup("Walk"));
-	blob_banim_flip = &(ret->lookup("Flip"));
-	return ret;
-});
-
-Load< GLuint > worm_banims_for_bone_lit_color_texture_program(LoadTagDefault, [](){
-	return new GLuint(worm_banims->make_vao_for_program(bone_lit_color_texture_program->program));
+GLuint blob_banims_for_bone_lit_color_texture_program = 0;
+Load< void > load_blob_banims(LoadTagDefault, [](){
+	blob_banims = assets.bone_animation(data_path("blob.banims"));
+	blob_banim_walk = &(blob_banims->lookup("Walk"));
+	blob_banim_flip = &(blob_banims->lookup("Flip"));
+	blob_banims_for_bone_lit_color_texture_program = assets.vao_for_program(blob_banims, bone_lit_color_texture_program->program);
 });
 
-Load< GLuint > rect_banims_for_bone_lit_color_texture_program(LoadTagDefault, [](){
-	return new GLuint(rect_banims->make_vao_for_program(bone_lit_color_texture_program->program));
-});
-
-Load< GLuint > blob_banims_for_bone_lit_color_texture_program(LoadTagDefault, [](){
-	return new GLuint(blob_banims->make_vao_for_program(bone_lit_color_texture_program->program));
-});
+// ************************ OCCLUDERS **************************
+//objects named "Occluder..." in the level are simplified stand-ins for big things (houses, fences, ...);
+// they aren't drawn, but are rasterized on the CPU to skip drawing what they hide (see OcclusionBuffer.hpp):
+// (their triangles are read from the level's meshes when the scene names its first occluder, so levels without any
+//  don't read the file a second time)
+static std::unique_ptr< OccluderMeshes const > worm_occluder_meshes;
+static std::vector< OcclusionBuffer::Occluder > worm_occluders; //filled in as worm_scene loads
 
 // ************************** SCENE ****************************
-Load< Scene > worm_scene(LoadTagDefault, []() -> Scene const * {
+Scene const *worm_scene = nullptr; //(made once worm_meshes has loaded)
+static Scene const *load_worm_scene() {
 	// return new Scene(data_path("worm.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-    return new Scene(data_path("level.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+    return new Scene(data_path(level_is_streamed() ? "level-resident.scene" : "level.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+		if (transform->name.substr(0, 8) == "Occluder") {
+			if (!worm_occluder_meshes) {
+				worm_occluder_meshes.reset(new OccluderMeshes(data_path(level_is_streamed() ? "level-resident.pnct" : "level.pnct")));
+			}
+			worm_occluders.emplace_back();
+			worm_occluders.back().transform = transform;
+			worm_occluders.back().triangles = &worm_occluder_meshes->lookup(mesh_name);
+			return;
+		}
+
 		Mesh const &mesh = worm_meshes->lookup(mesh_name);
 
 		scene.drawables.emplace_back(transform);
@@ -79,39 +103,66 @@ Load< Scene > worm_scene(LoadTagDefault, []() -> Scene const * {
 		drawable.pipeline = lit_color_texture_program_pipeline;
 
 		drawable.pipeline.vao = worm_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
+		drawable.set_mesh(mesh);
 
 	});
+}
+
+//the level's meshes are the biggest file, so they load while the intro and splash screens play:
+Load< void > load_worm_meshes(LoadTagDefault, [](){
+	// mesh_loader.load(data_path("worm.pnct"), ...
+	mesh_loader.load(data_path(level_is_streamed() ? "level-resident.pnct" : "level.pnct"), [](std::shared_ptr< MeshBuffer const > const &buffer){
+		worm_meshes = buffer.get();
+		worm_meshes_for_lit_color_texture_program = assets.vao_for_program(buffer, lit_color_texture_program->program);
+		worm_scene = load_worm_scene();
+	});
 });
 
 // *************************** WALK MESH ***********************
 WalkMesh const *walkmesh = nullptr;
-Load< WalkMeshes > worm_walkmeshes(LoadTagDefault, []() -> WalkMeshes const * {
-	// WalkMeshes *ret = new WalkMeshes(data_path("worm.w"));
-    WalkMeshes *ret = new WalkMeshes(data_path("level.w"));
-	walkmesh = &ret->lookup("WalkMesh");
-	return ret;
+std::shared_ptr< WalkMeshes const > worm_walkmeshes;
+Load< void > load_worm_walkmeshes(LoadTagDefault, [](){
+	// worm_walkmeshes = assets.walkmeshes(data_path("worm.w"));
+    if (level_is_streamed()) return; //(WormMode uses the streamed walkmesh instead)
+    worm_walkmeshes = assets.walkmeshes(data_path("level.w"));
+	walkmesh = &worm_walkmeshes->lookup("WalkMesh");
 });
 
 // ************************ WORM MODE **************************
-WormMode::WormMode() : scene(*worm_scene) {
+WormMode::WormMode() {
+    //(the level may still be loading if the intro was skipped quickly)
+    mesh_loader.finish();
+
     // MESH & WALKMESH SETUP ---------------------------------------------------
     {
+        //share the loaded level rather than copying it; only the transforms gameplay changes are copied:
+        scene.instance(*worm_scene);
+
+        //skip drawing things hidden behind the level's occluders (if it has any):
+        // (occluders are level geometry, so never overridden -- their base transforms are the ones in effect)
+        if (!worm_occluders.empty()) {
+            occlusion.occluders = worm_occluders;
+            scene.occlusion = &occlusion;
+        }
+
+        //streamed level? load the cells around the start position (and walk on their walkmesh):
+        if (level_is_streamed()) {
+            level_cells.reset(new LevelStreamer(data_path("level.cells"), lit_color_texture_program_pipeline));
+            level_cells->load_now(start_pos);
+            scene.attached = level_cells->resident_scenes();
+            walkmesh = &level_cells->walkmesh;
+        }
+
         //create a player transform:
         scene.transforms.emplace_back();
         player.transform = &scene.transforms.back();
 
-        //get character mesh
-        for (auto &transform : scene.transforms) {
-            if (transform.name == "Catball") catball.ch_transform = &transform;
-            if (transform.name == "Rectangle") rectangle.ch_transform = &transform;
-            //if (transform.name == "Blob") blob.ch_transform = &transform;
-            if (transform.name.substr(0, transform.name.size()-1) == "bead") {
-                beads.push_back(&transform);
-            }
-            // if (transform.name.substr(0, 4) == "")
+        //get character mesh (through the level's name index, rather than scanning every transform)
+        if (Scene::Transform *transform = worm_scene->find("Catball")) catball.ch_transform = scene.override_transform(transform);
+        if (Scene::Transform *transform = worm_scene->find("Rectangle")) rectangle.ch_transform = scene.override_transform(transform);
+        //if (Scene::Transform *transform = worm_scene->find("Blob")) blob.ch_transform = scene.override_transform(transform);
+        for (Scene::Transform *transform : worm_scene->find_tagged("bead")) { // bead1, bead2, ...
+            beads.push_back(scene.override_transform(transform));
         }
 
         // Bead count 
@@ -139,7 +190,7 @@ WormMode::WormMode() : scene(*worm_scene) {
 		Scene::Drawable::Pipeline worm_info;
 		worm_info = bone_lit_color_texture_program_pipeline;
 
-		worm_info.vao = *worm_banims_for_bone_lit_color_texture_program;
+		worm_info.vao = worm_banims_for_bone_lit_color_texture_program;
 		worm_info.start = worm_banims->mesh.start;
 		worm_info.count = worm_banims->mesh.count;
 
@@ -176,7 +227,7 @@ WormMode::WormMode() : scene(*worm_scene) {
 		Scene::Drawable::Pipeline rect_info;
 		rect_info = bone_lit_color_texture_program_pipeline;
 
-		rect_info.vao = *rect_banims_for_bone_lit_color_texture_program;
+		rect_info.vao = rect_banims_for_bone_lit_color_texture_program;
 		rect_info.start = rect_banims->mesh.start;
 		rect_info.count = rect_banims->mesh.count;
 
@@ -213,7 +264,7 @@ WormMode::WormMode() : scene(*worm_scene) {
 		Scene::Drawable::Pipeline blob_info;
 		blob_info = bone_lit_color_texture_program_pipeline;
 
-		blob_info.vao = *blob_banims_for_bone_lit_color_texture_program;
+		blob_info.vao = blob_banims_for_bone_lit_color_texture_program;
 		blob_info.start = blob_banims->mesh.start;
 		blob_info.count = blob_banims->mesh.count;
 
@@ -274,6 +325,16 @@ WormMode::WormMode() : scene(*worm_scene) {
         //rectangle.ch_transform->position = character_off_pos;
     }
 
+    // SPATIAL QUERIES ---------------------------------------------------------
+    build_drawable_bvh();
+
+}
+
+void WormMode::build_drawable_bvh() {
+    //the level is static except for the characters (which move every frame):
+    drawable_bvh.build(scene, [this](Scene::Drawable const &, Scene::Transform const &transform) {
+        return &transform == catball.ch_transform || &transform == rectangle.ch_transform;
+    });
 }
 
 WormMode::~WormMode() {
@@ -365,6 +426,11 @@ bool WormMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
         camera->transform->position = camera_offset_pos;
 
         player.transform->position = start_pos;
+        if (level_cells) { //(the start may have been streamed out)
+            level_cells->load_now(start_pos);
+            scene.attached = level_cells->resident_scenes();
+            build_drawable_bvh();
+        }
         player.at = walkmesh->nearest_walk_point(player.transform->position);
 
         //rotate camera facing direction (-z) to player facing direction (+y):
@@ -438,6 +504,13 @@ bool WormMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 
 void WormMode::update(float elapsed) {
     game_time += elapsed;
+
+    // Stream level cells in and out around the player
+    if (level_cells && level_cells->update(player.transform->position)) {
+        player.at = level_cells->remap(player.at);
+        scene.attached = level_cells->resident_scenes();
+        build_drawable_bvh();
+    }
     
     // Change character if input provided 
     this->morphCharacter(false); 
@@ -733,6 +806,13 @@ void WormMode::update(float elapsed) {
         // Update camera location and rotation
         camera->transform->rotation = player.transform->rotation * camera_offset_rot;
         camera->transform->position = (player.transform->position + (player.transform->rotation *camera_offset_pos));
+
+        // Move the camera in front of any level geometry between it and the player (beads are too small to matter)
+        drawable_bvh.refit();
+        camera->transform->position = drawable_bvh.clear_view(player.transform->position, camera->transform->position,
+            camera_clearance, [this](Scene::Drawable const &drawable) {
+                return std::find(beads.begin(), beads.end(), scene.resolve(drawable.transform)) != beads.end();
+            });
     }
     
     // Check for collision with beads
@@ -758,12 +838,16 @@ void WormMode::draw(glm::uvec2 const &drawable_size) {
 
 	//Draw scene:
     //set up light type and position for lit_color_texture_program:
-	// TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
+	// (the 'Light' uniform block is shared by every lit program, so this is one buffer update)
+	// the scene's own Light(s) are shaded by Scene::draw (see LightClusters.hpp); this default sky light
+	// stays on as ambient fill under point and spot lights, and is only dropped if the scene brings its own sky or sun:
+	{
+		UniformBlocks::Light light;
+		light.LIGHT_TYPE = 1;
+		light.LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f,-1.0f);
+		light.LIGHT_ENERGY = (scene.has_global_light() ? glm::vec3(0.0f) : glm::vec3(1.0f, 1.0f, 0.95f));
+		uniform_blocks->set_light(light);
+	}
 
     // grey world background 
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
@@ -896,8 +980,16 @@ void WormMode::beadCollision(float eps) {
         threshold = 6.5f + eps; 
     }
 
-    for (size_t i = 0; i < beads.size(); i++) { 
-        auto bead = beads[i];
+    //only beads whose bounds are within reach can be collected:
+    drawable_bvh.refit();
+    std::vector< Scene::Drawable const * > nearby;
+    drawable_bvh.query_sphere(ch_pos, std::sqrt(threshold), &nearby);
+
+    for (Scene::Drawable const *drawable : nearby) { 
+        //(beads are overrides of level transforms, so look up the one in effect)
+        auto found = std::find(beads.begin(), beads.end(), scene.resolve(drawable->transform));
+        if (found == beads.end()) continue;
+        Scene::Transform *bead = *found;
         if (!bead->include) continue;
         glm::vec3 bead_pos = bead->position; 
         glm::vec3 pos_diff = ch_pos - bead_pos;
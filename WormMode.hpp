@@ -4,7 +4,10 @@
 
 #include "BoneAnimation.hpp"
 #include "GL.hpp"
+#include "LevelStreamer.hpp"
+#include "OcclusionBuffer.hpp"
 #include "Scene.hpp"
+#include "SceneBVH.hpp"
 #include "WalkMesh.hpp"
 
 #include "data_path.hpp"
@@ -13,11 +16,13 @@
 #include <glm/glm.hpp>
 
 #include <vector>
+#include <memory>
 #include <map> 
 #include <deque>
 #include <list>
 
 #include "TextRendering.hpp"
+#include "AssetCache.hpp"
 
 struct WormMode : public Mode {
 	WormMode();
@@ -43,6 +48,7 @@ struct WormMode : public Mode {
 	glm::quat camera_offset_rot = glm::angleAxis(glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 	glm::vec3 character_off_pos = glm::vec3(-100.0f);
 	glm::quat cam_init_rot;
+	float camera_clearance = 0.5f; // distance kept between the camera and geometry that would block its view
 
 	// Scene:
 	Scene scene;
@@ -110,6 +116,16 @@ struct WormMode : public Mode {
 	std::vector< Scene::Transform* > beads;
 	size_t num_beads; 
 
+	// Spatial index over the scene's drawables (used for bead pickup and keeping the camera's view clear):
+	SceneBVH drawable_bvh;
+	void build_drawable_bvh(); // (re-)build after drawables come or go
+
+	// Software depth buffer for skipping drawables hidden behind the level's occluders (see scene.occlusion):
+	OcclusionBuffer occlusion;
+
+	// Streamed level cells (null unless the level was split with scenes/split-cells.py):
+	std::unique_ptr< LevelStreamer > level_cells;
+
 	// Lives and collisions 
 	uint8_t num_lives = 3;
 	std::vector < Scene::Transform* > obstacles;
@@ -118,8 +134,9 @@ struct WormMode : public Mode {
 	float game_time = 0.0f;
 
 	// Font
-	TextRenderer *mansalva_renderer = new TextRenderer(data_path("fonts/Mansalva-Regular.ttf"), 200);
-	TextRenderer *main_text_renderer = mansalva_renderer;
+	//(from the asset cache, so every mode draws with the same glyph textures)
+	std::shared_ptr< TextRenderer > mansalva_renderer = assets.font(data_path("fonts/Mansalva-Regular.ttf"), 200);
+	TextRenderer *main_text_renderer = mansalva_renderer.get();
 
 	float main_text_size = 0.3f;
     glm::vec3 main_text_color = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -0,0 +1,229 @@
+//bench-pool times the per-frame transform work of Scene with three ways of storing transforms:
+// bench-pool [count ...]        (default: 10000 100000)
+//
+// - std::list, as Scene used before Pool, both freshly built and "shuffled" (nodes re-linked in a random
+//   order, like a heap that has seen levels load and unload) -- every step follows a node pointer
+// - Pool (see Pool.hpp), as Scene::transforms is now -- nodes packed into contiguous blocks
+// - parallel arrays of position, rotation, scale, and parent index in depth order, as Scene::WorldArrays
+//
+//For each, it times:
+// - "update": compute every world matrix from its parent's (as update_world_matrices does when everything moved)
+// - "scan": compare every transform's local values against the ones its matrix was computed from (as
+//   update_world_matrices does every frame; for a static level, this is all it does)
+//
+//Times are the best of several runs, in nanoseconds per transform. Cache misses aren't counted here (there is
+// no portable way to); run under a profiler -- e.g., 'perf stat -e cache-misses' -- to see them.
+//
+//Command-line only, so it uses a stand-in for Scene::Transform (same fields) instead of including Scene.hpp.
+
+#include "Pool.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+//stand-in for Scene::Transform:
+struct Node {
+	std::string name;
+	bool include = true;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+	Node *parent = nullptr;
+	//(like Scene::Transform::WorldCache)
+	glm::vec3 cached_position = glm::vec3(0.0f);
+	glm::quat cached_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 cached_scale = glm::vec3(1.0f);
+	glm::mat4x3 local_to_world = glm::mat4x3(1.0f);
+};
+
+//same math as Scene::Transform::make_local_to_parent:
+static glm::mat4x3 local_to_parent(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
+	glm::mat3 rot = glm::mat3_cast(rotation);
+	return glm::mat4x3(rot[0] * scale.x, rot[1] * scale.y, rot[2] * scale.z, position);
+}
+
+static void update(Node &node) {
+	node.cached_position = node.position;
+	node.cached_rotation = node.rotation;
+	node.cached_scale = node.scale;
+	node.local_to_world = local_to_parent(node.position, node.rotation, node.scale);
+	if (node.parent) node.local_to_world = node.parent->local_to_world * glm::mat4(node.local_to_world);
+}
+
+static bool changed(Node const &node) {
+	return node.position != node.cached_position || node.rotation != node.cached_rotation || node.scale != node.cached_scale;
+}
+
+//..and as parallel arrays (slots in depth order, so parents come first):
+struct Arrays {
+	std::vector< glm::vec3 > position;
+	std::vector< glm::quat > rotation;
+	std::vector< glm::vec3 > scale;
+	std::vector< uint32_t > parent; //-1U for roots
+	std::vector< glm::vec3 > cached_position;
+	std::vector< glm::quat > cached_rotation;
+	std::vector< glm::vec3 > cached_scale;
+	std::vector< glm::mat4x3 > local_to_world;
+	std::vector< uint8_t > changed;
+};
+
+//best time (in nanoseconds per transform) of running f:
+static double best_ns(size_t count, std::function< void() > const &f) {
+	double best = std::numeric_limits< double >::infinity();
+	for (uint32_t run = 0; run < 7; ++run) {
+		auto before = std::chrono::high_resolution_clock::now();
+		f();
+		auto after = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::nano >(after - before).count() / double(count));
+	}
+	return best;
+}
+
+//keeps the compiler from dropping results:
+static volatile float sink = 0.0f;
+
+static void bench(size_t count) {
+	std::mt19937 mt(0x5eed);
+	auto rand01 = [&]() { return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt); };
+
+	//a level-like hierarchy: parents always come before children, most transforms have one
+	std::vector< uint32_t > parents(count);
+	std::vector< glm::vec3 > positions(count);
+	for (size_t i = 0; i < count; ++i) {
+		parents[i] = (i == 0 || mt() % 8 == 0 ? -1U : uint32_t(mt() % i));
+		positions[i] = glm::vec3(rand01(), rand01(), rand01());
+	}
+	auto fill = [&](auto &nodes, std::vector< Node * > &by_index) {
+		for (size_t i = 0; i < count; ++i) {
+			nodes.emplace_back();
+			Node &node = nodes.back();
+			node.name = "Transform.level-object-" + std::to_string(i); //(long enough to be heap-allocated, as in loaded scenes)
+			node.position = positions[i];
+			if (parents[i] != -1U) node.parent = by_index[parents[i]];
+			by_index.emplace_back(&node);
+		}
+	};
+
+	std::list< Node > list;
+	std::vector< Node * > list_nodes;
+	fill(list, list_nodes);
+
+	std::list< Node > shuffled;
+	std::vector< Node * > shuffled_nodes;
+	{
+		//build in a random order, then put the nodes back in hierarchy order by re-linking (not moving) them:
+		std::vector< uint32_t > order(count);
+		for (uint32_t i = 0; i < count; ++i) order[i] = i;
+		std::shuffle(order.begin(), order.end(), mt);
+		std::vector< std::list< Node >::iterator > at(count);
+		for (uint32_t i : order) {
+			shuffled.emplace_back();
+			shuffled.back().position = positions[i];
+			shuffled.back().name = "Transform.level-object-" + std::to_string(i);
+			at[i] = std::prev(shuffled.end());
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			shuffled.splice(shuffled.end(), shuffled, at[i]);
+			if (parents[i] != -1U) at[i]->parent = &*at[parents[i]];
+			shuffled_nodes.emplace_back(&*at[i]);
+		}
+	}
+
+	Pool< Node > pool;
+	std::vector< Node * > pool_nodes;
+	fill(pool, pool_nodes);
+
+	Arrays arrays;
+	arrays.position = positions;
+	arrays.rotation.assign(count, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	arrays.scale.assign(count, glm::vec3(1.0f));
+	arrays.parent = parents;
+	arrays.cached_position.assign(count, glm::vec3(0.0f));
+	arrays.cached_rotation.assign(count, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	arrays.cached_scale.assign(count, glm::vec3(1.0f));
+	arrays.local_to_world.assign(count, glm::mat4x3(1.0f));
+	arrays.changed.assign(count, 0);
+
+	auto update_nodes = [](auto &nodes) {
+		return [&nodes]() {
+			for (auto &node : nodes) update(node);
+			sink = sink + nodes.back().local_to_world[3].x;
+		};
+	};
+	auto scan_nodes = [](auto &nodes) {
+		return [&nodes]() {
+			uint32_t total = 0;
+			for (auto const &node : nodes) total += changed(node);
+			sink = sink + float(total);
+		};
+	};
+	auto update_arrays = [&arrays, count]() {
+		for (size_t i = 0; i < count; ++i) {
+			arrays.cached_position[i] = arrays.position[i];
+			arrays.cached_rotation[i] = arrays.rotation[i];
+			arrays.cached_scale[i] = arrays.scale[i];
+			glm::mat4x3 local = local_to_parent(arrays.position[i], arrays.rotation[i], arrays.scale[i]);
+			uint32_t p = arrays.parent[i];
+			arrays.local_to_world[i] = (p == -1U ? local : arrays.local_to_world[p] * glm::mat4(local));
+		}
+		sink = sink + arrays.local_to_world.back()[3].x;
+	};
+	auto scan_arrays = [&arrays, count]() {
+		uint32_t total = 0;
+		for (size_t i = 0; i < count; ++i) {
+			arrays.changed[i] = (arrays.position[i] != arrays.cached_position[i]
+				|| arrays.rotation[i] != arrays.cached_rotation[i] || arrays.scale[i] != arrays.cached_scale[i]);
+			total += arrays.changed[i];
+		}
+		sink = sink + float(total);
+	};
+
+	struct Row {
+		char const *name;
+		double update, scan;
+	};
+	std::vector< Row > rows;
+	rows.emplace_back(Row{ "std::list", best_ns(count, update_nodes(list)), best_ns(count, scan_nodes(list)) });
+	rows.emplace_back(Row{ "std::list (shuffled)", best_ns(count, update_nodes(shuffled)), best_ns(count, scan_nodes(shuffled)) });
+	rows.emplace_back(Row{ "Pool", best_ns(count, update_nodes(pool)), best_ns(count, scan_nodes(pool)) });
+	rows.emplace_back(Row{ "arrays", best_ns(count, update_arrays), best_ns(count, scan_arrays) });
+
+	std::cout << count << " transforms (ns per transform):\n";
+	std::cout << "  " << std::left << std::setw(22) << "" << std::right << std::setw(10) << "update" << std::setw(10) << "scan" << '\n';
+	for (auto const &row : rows) {
+		std::cout << "  " << std::left << std::setw(22) << row.name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << row.update << std::setw(10) << row.scan << '\n';
+	}
+	std::cout.flush();
+}
+
+int main(int argc, char **argv) {
+	std::vector< size_t > counts;
+	for (int i = 1; i < argc; ++i) {
+		long count = std::atol(argv[i]);
+		if (count <= 0) {
+			std::cerr << "Usage:\n\t" << argv[0] << " [count ...]\n"
+				"Times Scene's per-frame transform work with std::list, Pool, and parallel-array storage." << std::endl;
+			return 1;
+		}
+		counts.emplace_back(size_t(count));
+	}
+	if (counts.empty()) counts = { 10000, 100000 };
+
+	for (size_t count : counts) bench(count);
+
+	return 0;
+}
@@ -8,6 +8,8 @@
 
 //Deal with calling resource loading functions:
 #include "Load.hpp"
+//..and with meshes that load in the background:
+#include "MeshLoader.hpp"
 
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
@@ -18,6 +20,11 @@
 //for screenshots:
 #include "load_save_png.hpp"
 
+//for the performance HUD (and the stats dump, which lists loaded assets too):
+#include "RenderStats.hpp"
+#include "GPUProfiler.hpp"
+#include "AssetCache.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -98,6 +105,7 @@ int main(int argc, char **argv) {
 	//SDL_ShowCursor(SDL_DISABLE);
 
 	//------------ load resources --------------
+	//(big mesh files are only queued here, and arrive over the first few frames -- see MeshLoader)
 	call_load_functions();
 
 	//------------ create game mode + make current --------------
@@ -152,11 +160,28 @@ int main(int argc, char **argv) {
 						px.a = 0xff;
 					}
 					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F3) {
+					// --- performance HUD toggle key ---
+					render_stats.show_hud = !render_stats.show_hud;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F4) {
+					// --- render stats dump key ---
+					std::string filename = "render-stats.json";
+					std::cout << "Saving render stats to '" << filename << "'." << std::endl;
+					try {
+						render_stats.write_json(filename);
+					} catch (std::exception &e) {
+						std::cerr << e.what() << std::endl;
+					}
+					std::cout << "Loaded assets:\n";
+					assets.report(std::cout);
 				}
 			}
 			if (!Mode::current) break;
 		}
 
+		//upload some of any meshes still loading (this frame's share of MeshLoader::upload_budget):
+		mesh_loader.update();
+
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
@@ -173,12 +198,20 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			//(pass timings are only needed while the HUD shows them)
+			gpu_profiler.active = render_stats.show_hud;
+
 			Mode::current->draw(drawable_size);
+
+			if (render_stats.show_hud) render_stats.draw_hud(drawable_size);
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(window);
+
+		//file this frame's render counts (and time) for the HUD:
+		render_stats.end_frame();
+		gpu_profiler.end_frame();
 	}
 
 
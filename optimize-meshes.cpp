@@ -0,0 +1,127 @@
+//optimize-meshes reorders the triangles and vertices of every mesh in a .pnct file so they draw faster:
+// optimize-meshes <in.pnct> <out.pnct> [--threshold T]
+//
+//Each mesh gets (see optimize_mesh.hpp):
+// - its triangles ordered for the post-transform vertex cache
+// - runs of those triangles reordered so outward-facing parts draw first, which cuts overdraw; runs are only
+//   split where that costs at most T (default 1.05) times the cache miss ratio
+// - its vertices renumbered in the order they're first used
+//
+//The cache miss ratios (ACMR, vertices transformed per triangle, and ATVR, per vertex) of each mesh are
+// printed before and after, for a simulated 16-vertex FIFO cache.
+//
+//Output is always indexed (see Mesh.hpp); triangle-soup input is welded first. Run this after
+// simplify-meshes and before quantize-meshes (which only reads unquantized files). MeshBuffer::optimize()
+// does the same at load time.
+
+#include "optimize_mesh.hpp"
+#include "pnct_file.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::string in_file, out_file;
+	float threshold = 1.05f;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--threshold" && argi + 1 < argc) {
+			threshold = std::stof(argv[++argi]);
+		} else if (in_file == "") {
+			in_file = arg;
+		} else if (out_file == "") {
+			out_file = arg;
+		} else {
+			in_file = "";
+			break;
+		}
+	}
+	if (in_file == "" || out_file == "" || !(threshold >= 1.0f)) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <in.pnct> <out.pnct> [--threshold T]\n"
+			"Reorders each mesh's triangles and vertices for the vertex cache and for less overdraw, giving up\n"
+			"at most T (default 1.05, at least 1) times the cache miss ratio for the overdraw order." << std::endl;
+		return 1;
+	}
+
+	//read (each mesh as vertices + indices counting from its first vertex):
+	PnctFile pnct;
+	read_pnct(in_file, &pnct);
+	if (pnct.quantized) {
+		throw std::runtime_error("'" + in_file + "' is quantized; optimize meshes before quantizing them.");
+	}
+	bool was_indexed = pnct.indexed();
+	pnct.weld(); //(weld identical vertices within each mesh of triangle soup)
+
+	//optimize each mesh in place:
+	std::vector< PnctVertex > const data = pnct.vertices;
+	std::vector< PnctVertex > &out_data = pnct.vertices;
+	std::vector< uint32_t > &indices = pnct.indices;
+	uint64_t triangles_total = 0;
+	double misses_before = 0.0, misses_after = 0.0;
+	std::cout << std::fixed << std::setprecision(3);
+	for (auto const &entry : pnct.meshes) {
+		uint32_t vertex_count = entry.vertex_end - entry.vertex_begin;
+		std::vector< uint32_t > mesh(indices.begin() + entry.index_begin, indices.begin() + entry.index_end);
+		uint32_t triangles = uint32_t(mesh.size() / 3);
+		if (triangles == 0) continue;
+
+		//(soup meshes were drawn without any vertex reuse)
+		VertexCacheStats before;
+		if (was_indexed) {
+			before = analyze_vertex_cache(mesh, vertex_count);
+		} else {
+			before.acmr = 3.0f;
+			before.atvr = float(3 * triangles) / float(vertex_count);
+		}
+
+		std::vector< glm::vec3 > positions;
+		positions.reserve(vertex_count);
+		for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) positions.emplace_back(data[v].Position);
+
+		optimize_vertex_cache(&mesh, vertex_count);
+		optimize_overdraw(&mesh, positions, threshold);
+		std::vector< uint32_t > remap = optimize_vertex_fetch(&mesh, vertex_count);
+		for (uint32_t v = 0; v < vertex_count; ++v) {
+			out_data[entry.vertex_begin + remap[v]] = data[entry.vertex_begin + v];
+		}
+		std::copy(mesh.begin(), mesh.end(), indices.begin() + entry.index_begin);
+
+		VertexCacheStats after = analyze_vertex_cache(mesh, vertex_count);
+		std::cout << entry.name << ": " << triangles << " triangles, ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		triangles_total += triangles;
+		misses_before += double(before.acmr) * triangles;
+		misses_after += double(after.acmr) * triangles;
+	}
+	if (triangles_total != 0) {
+		std::cout << "Overall ACMR " << misses_before / triangles_total << " -> " << misses_after / triangles_total
+			<< " over " << triangles_total << " triangles." << std::endl;
+	}
+
+	//write:
+	pnct.index_size = pnct.smallest_index_size();
+	write_pnct(out_file, pnct);
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -0,0 +1,289 @@
+#include "optimize_mesh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//FIFO post-transform cache simulation: how many of each triangle's vertices miss the cache?
+// (a vertex is in the cache if fewer than cache_size misses happened since it was last loaded)
+static std::vector< uint8_t > simulate_cache(std::vector< uint32_t > const &indices, uint32_t begin, uint32_t end, uint32_t vertex_count, uint32_t cache_size) {
+	std::vector< uint8_t > misses;
+	misses.reserve((end - begin) / 3);
+	std::vector< uint32_t > loaded_at(vertex_count, 0); //miss counter value just after the vertex was loaded (0 = never)
+	uint32_t counter = 0;
+	for (uint32_t i = begin; i + 2 < end; i += 3) {
+		uint8_t m = 0;
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = indices[i + c];
+			if (loaded_at[v] == 0 || counter - loaded_at[v] >= cache_size) {
+				counter += 1;
+				loaded_at[v] = counter;
+				m += 1;
+			}
+		}
+		misses.emplace_back(m);
+	}
+	return misses;
+}
+
+VertexCacheStats analyze_vertex_cache(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size) {
+	VertexCacheStats stats;
+	uint32_t triangles = uint32_t(indices.size() / 3);
+	if (triangles == 0) return stats;
+
+	std::vector< uint8_t > misses = simulate_cache(indices, 0, triangles * 3, vertex_count, cache_size);
+	uint32_t total = 0;
+	for (uint8_t m : misses) total += m;
+
+	std::vector< bool > used(vertex_count, false);
+	uint32_t used_count = 0;
+	for (uint32_t i = 0; i < triangles * 3; ++i) {
+		if (!used[indices[i]]) {
+			used[indices[i]] = true;
+			used_count += 1;
+		}
+	}
+
+	stats.acmr = float(total) / float(triangles);
+	stats.atvr = float(total) / float(used_count);
+	return stats;
+}
+
+//-------------------------
+//Forsyth's vertex cache optimization: greedily emit the triangle whose vertices score highest, where a vertex
+// scores for being recently used (in a simulated LRU cache) and for having few triangles left (so that
+// vertices get finished off instead of left dangling):
+
+static constexpr uint32_t ScoreCacheSize = 32;
+
+static float vertex_score(int32_t cache_position, uint32_t live_triangles) {
+	if (live_triangles == 0) return -1.0f; //(no triangles left to draw)
+	float score = 0.0f;
+	if (cache_position >= 0) {
+		if (cache_position < 3) {
+			//the last triangle's vertices score a bit lower, so the order doesn't just strip along one edge:
+			score = 0.75f;
+		} else {
+			score = std::pow(1.0f - float(cache_position - 3) / float(ScoreCacheSize - 3), 1.5f);
+		}
+	}
+	score += 2.0f / std::sqrt(float(live_triangles));
+	return score;
+}
+
+void optimize_vertex_cache(std::vector< uint32_t > *indices_, uint32_t vertex_count) {
+	assert(indices_);
+	std::vector< uint32_t > &indices = *indices_;
+	uint32_t triangles = uint32_t(indices.size() / 3);
+	if (triangles == 0) return;
+
+	//triangles around each vertex (offsets into one array; the first 'live' are still to be drawn):
+	std::vector< uint32_t > live(vertex_count, 0);
+	for (uint32_t i = 0; i < triangles * 3; ++i) live[indices[i]] += 1;
+	std::vector< uint32_t > first(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; ++v) first[v + 1] = first[v] + live[v];
+	std::vector< uint32_t > vertex_triangles(triangles * 3);
+	{
+		std::vector< uint32_t > fill(first.begin(), first.end() - 1);
+		for (uint32_t i = 0; i < triangles * 3; ++i) vertex_triangles[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector< int32_t > cache_position(vertex_count, -1);
+	std::vector< float > scores(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v) scores[v] = vertex_score(-1, live[v]);
+
+	std::vector< float > triangle_scores(triangles);
+	std::vector< bool > emitted(triangles, false);
+	uint32_t best = 0;
+	for (uint32_t t = 0; t < triangles; ++t) {
+		triangle_scores[t] = scores[indices[3*t+0]] + scores[indices[3*t+1]] + scores[indices[3*t+2]];
+		if (triangle_scores[t] > triangle_scores[best]) best = t;
+	}
+
+	std::vector< uint32_t > out;
+	out.reserve(triangles * 3);
+	std::vector< uint32_t > cache, next_cache;
+	cache.reserve(ScoreCacheSize + 3);
+	next_cache.reserve(ScoreCacheSize + 3);
+	uint32_t cursor = 0; //(triangles before this are all emitted)
+
+	while (true) {
+		if (best == -1U) {
+			//nothing in the cache has triangles left, so start anywhere:
+			while (cursor < triangles && emitted[cursor]) ++cursor;
+			if (cursor == triangles) break;
+			best = cursor;
+		}
+
+		//emit the best triangle:
+		uint32_t const *tri = &indices[3*best];
+		out.insert(out.end(), tri, tri + 3);
+		emitted[best] = true;
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = tri[c];
+			uint32_t *list = &vertex_triangles[first[v]];
+			uint32_t *found = std::find(list, list + live[v], best);
+			assert(found != list + live[v]);
+			std::swap(*found, list[live[v] - 1]);
+			live[v] -= 1;
+		}
+
+		//its vertices move to the front of the cache:
+		next_cache.assign(tri, tri + 3);
+		for (uint32_t v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) next_cache.emplace_back(v);
+		}
+		for (uint32_t i = ScoreCacheSize; i < next_cache.size(); ++i) {
+			uint32_t v = next_cache[i];
+			cache_position[v] = -1;
+			scores[v] = vertex_score(-1, live[v]);
+		}
+		if (next_cache.size() > ScoreCacheSize) next_cache.resize(ScoreCacheSize);
+		std::swap(cache, next_cache);
+
+		//rescore the cache and the triangles around it, and pick the next triangle from those:
+		for (uint32_t i = 0; i < cache.size(); ++i) {
+			cache_position[cache[i]] = int32_t(i);
+			scores[cache[i]] = vertex_score(int32_t(i), live[cache[i]]);
+		}
+		best = -1U;
+		float best_score = -1.0f;
+		for (uint32_t v : cache) {
+			for (uint32_t j = first[v]; j < first[v] + live[v]; ++j) {
+				uint32_t t = vertex_triangles[j];
+				triangle_scores[t] = scores[indices[3*t+0]] + scores[indices[3*t+1]] + scores[indices[3*t+2]];
+				if (triangle_scores[t] > best_score) {
+					best_score = triangle_scores[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	assert(out.size() == triangles * 3);
+	std::copy(out.begin(), out.end(), indices.begin());
+}
+
+//-------------------------
+
+void optimize_overdraw(std::vector< uint32_t > *indices_, std::vector< glm::vec3 > const &positions, float threshold) {
+	assert(indices_);
+	std::vector< uint32_t > &indices = *indices_;
+	uint32_t triangles = uint32_t(indices.size() / 3);
+	if (triangles == 0) return;
+	uint32_t vertex_count = uint32_t(positions.size());
+
+	//split into runs ("clusters") of triangles that can be moved around without hurting the cache much:
+	std::vector< uint32_t > clusters; //first triangle of each cluster
+	{
+		//triangles that miss on every vertex are where the cache order already starts over ("hard" boundaries):
+		std::vector< uint8_t > misses = simulate_cache(indices, 0, triangles * 3, vertex_count, VertexCacheSize);
+		std::vector< uint32_t > hard;
+		for (uint32_t t = 0; t < triangles; ++t) {
+			if (t == 0 || misses[t] == 3) hard.emplace_back(t);
+		}
+		hard.emplace_back(triangles);
+
+		//within each of those, also split wherever the run so far -- drawn from a cold cache -- is already
+		// within 'threshold' of the ACMR of the whole hard cluster ("soft" boundaries):
+		std::vector< uint32_t > loaded_at(vertex_count, 0); //(as in simulate_cache)
+		uint32_t counter = 0;
+		for (uint32_t h = 0; h + 1 < hard.size(); ++h) {
+			uint32_t begin = hard[h], end = hard[h+1];
+			uint32_t total = 0;
+			for (uint32_t t = begin; t < end; ++t) total += misses[t];
+			float limit = threshold * float(total) / float(end - begin);
+
+			uint32_t t = begin;
+			while (t < end) {
+				clusters.emplace_back(t);
+				counter += VertexCacheSize + 1; //(empties the cache)
+				uint32_t start = t;
+				uint32_t run = 0;
+				while (t < end) {
+					for (uint32_t c = 0; c < 3; ++c) {
+						uint32_t v = indices[3*t + c];
+						if (loaded_at[v] == 0 || counter - loaded_at[v] >= VertexCacheSize) {
+							counter += 1;
+							loaded_at[v] = counter;
+							run += 1;
+						}
+					}
+					t += 1;
+					if (float(run) / float(t - start) <= limit) break;
+				}
+			}
+		}
+	}
+	clusters.emplace_back(triangles);
+
+	//draw clusters that face out from the middle of the mesh first (they are the most likely to hide others):
+	glm::vec3 center = glm::vec3(0.0f);
+	{
+		std::vector< bool > used(vertex_count, false);
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < triangles * 3; ++i) {
+			if (used[indices[i]]) continue;
+			used[indices[i]] = true;
+			center += positions[indices[i]];
+			count += 1;
+		}
+		center /= float(count);
+	}
+
+	struct Sort {
+		float key;
+		uint32_t cluster;
+	};
+	std::vector< Sort > sorted;
+	sorted.reserve(clusters.size() - 1);
+	for (uint32_t c = 0; c + 1 < clusters.size(); ++c) {
+		glm::vec3 centroid = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f); //(area-weighted)
+		float area = 0.0f;
+		for (uint32_t t = clusters[c]; t < clusters[c+1]; ++t) {
+			glm::vec3 const &a = positions[indices[3*t+0]];
+			glm::vec3 const &b = positions[indices[3*t+1]];
+			glm::vec3 const &d = positions[indices[3*t+2]];
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float len = glm::length(n);
+			centroid += (a + b + d) * (len / 3.0f);
+			normal += n;
+			area += len;
+		}
+		float key = 0.0f;
+		if (area > 0.0f && glm::length(normal) > 0.0f) {
+			key = glm::dot(centroid / area - center, glm::normalize(normal));
+		}
+		sorted.emplace_back(Sort{ key, c });
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](Sort const &a, Sort const &b) {
+		return a.key > b.key;
+	});
+
+	std::vector< uint32_t > out;
+	out.reserve(triangles * 3);
+	for (auto const &s : sorted) {
+		out.insert(out.end(), indices.begin() + 3 * clusters[s.cluster], indices.begin() + 3 * clusters[s.cluster + 1]);
+	}
+	std::copy(out.begin(), out.end(), indices.begin());
+}
+
+//-------------------------
+
+std::vector< uint32_t > optimize_vertex_fetch(std::vector< uint32_t > *indices_, uint32_t vertex_count) {
+	assert(indices_);
+	std::vector< uint32_t > &indices = *indices_;
+
+	std::vector< uint32_t > remap(vertex_count, -1U);
+	uint32_t next = 0;
+	for (uint32_t &i : indices) {
+		if (remap[i] == -1U) remap[i] = next++;
+		i = remap[i];
+	}
+	for (uint32_t &r : remap) {
+		if (r == -1U) r = next++;
+	}
+	assert(next == vertex_count);
+	return remap;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * Triangle and vertex reordering for indexed meshes, to make them cheaper
+ *  to draw without changing what they look like.
+ *
+ * 'indices' are a triangle list counting from the mesh's first vertex, as
+ *  in indexed .pnct files (see Mesh.hpp). Run the steps in this order:
+ *  - optimize_vertex_cache() orders triangles so that recently-transformed
+ *    vertices get reused (Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006)
+ *  - optimize_overdraw() then moves whole runs of those triangles so that
+ *    outward-facing parts of the mesh draw first and hide the rest, without
+ *    undoing much of the cache order (after Sander, Nehab, and Barczak, "Fast
+ *    Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007)
+ *  - optimize_vertex_fetch() renumbers vertices in the order triangles first
+ *    use them, so vertex reads walk forward through memory
+ *
+ * analyze_vertex_cache() measures the result by simulating a FIFO cache:
+ *  ACMR (average cache miss ratio) is vertices transformed per triangle --
+ *  from 3 (no reuse) down to about 0.5 (a perfect grid) -- and ATVR (average
+ *  transform to vertex ratio) is vertices transformed per vertex, where 1 is
+ *  ideal.
+ *
+ * Used by scenes/optimize-meshes and MeshBuffer::optimize(); nothing here
+ *  touches OpenGL.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats {
+	float acmr = 0.0f; //vertex transforms per triangle
+	float atvr = 0.0f; //vertex transforms per vertex used
+};
+
+//size of the cache analyze_vertex_cache() simulates by default (post-transform caches hold 16-32 vertices):
+constexpr uint32_t VertexCacheSize = 16;
+
+VertexCacheStats analyze_vertex_cache(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size = VertexCacheSize);
+
+//reorder triangles for the post-transform vertex cache:
+void optimize_vertex_cache(std::vector< uint32_t > *indices, uint32_t vertex_count);
+
+//reorder runs of triangles to reduce overdraw, giving up at most 'threshold' times the ACMR within each run:
+// (positions[i] is the object-space position of vertex i)
+void optimize_overdraw(std::vector< uint32_t > *indices, std::vector< glm::vec3 > const &positions, float threshold = 1.05f);
+
+//renumber vertices in order of first use (unused vertices go last):
+// returns the new number of each old vertex; move vertex data to match
+std::vector< uint32_t > optimize_vertex_fetch(std::vector< uint32_t > *indices, uint32_t vertex_count);
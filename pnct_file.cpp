@@ -0,0 +1,230 @@
+#include "pnct_file.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+//index entries of triangle soup (idx0) and indexed (idx1) files:
+struct SoupEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+};
+static_assert(sizeof(SoupEntry) == 16, "Index entry should be packed");
+
+struct IndexedEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+	uint32_t index_begin, index_end;
+};
+static_assert(sizeof(IndexedEntry) == 24, "Index entry should be packed");
+
+//per-mesh position offset and scale of quantized files (qbx0):
+struct Dequantize {
+	glm::vec3 offset;
+	glm::vec3 scale;
+};
+static_assert(sizeof(Dequantize) == 6*4, "Dequantize entry should be packed");
+
+void read_pnct(std::string const &filename, PnctFile *pnct_) {
+	assert(pnct_);
+	PnctFile &pnct = *pnct_;
+	pnct = PnctFile();
+
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "'.");
+
+	if (peek_chunk_magic(file) == "pnq0") {
+		read_chunk(file, "pnq0", &pnct.quantized_vertices);
+		pnct.quantized = true;
+	} else {
+		read_chunk(file, "pnct", &pnct.vertices);
+	}
+
+	std::string index_magic = peek_chunk_magic(file);
+	if (index_magic == "ix16") {
+		std::vector< uint16_t > indices16;
+		read_chunk(file, "ix16", &indices16);
+		pnct.indices.assign(indices16.begin(), indices16.end());
+		pnct.index_size = 2;
+	} else if (index_magic == "ix32") {
+		read_chunk(file, "ix32", &pnct.indices);
+		pnct.index_size = 4;
+	}
+
+	std::vector< char > strings;
+	read_chunk(file, "str0", &strings);
+
+	std::vector< IndexedEntry > index;
+	if (pnct.indexed()) {
+		read_chunk(file, "idx1", &index);
+	} else {
+		std::vector< SoupEntry > soup;
+		read_chunk(file, "idx0", &soup);
+		index.reserve(soup.size());
+		for (auto const &entry : soup) {
+			index.emplace_back(IndexedEntry{ entry.name_begin, entry.name_end, entry.vertex_begin, entry.vertex_end, 0, 0 });
+		}
+	}
+
+	std::vector< Dequantize > dequantize;
+	if (pnct.quantized) {
+		read_chunk(file, "qbx0", &dequantize);
+		if (dequantize.size() != index.size()) {
+			throw std::runtime_error("quantized mesh file has " + std::to_string(dequantize.size()) + " position scales for " + std::to_string(index.size()) + " meshes");
+		}
+	}
+
+	size_t vertex_count = pnct.vertex_count();
+	pnct.meshes.reserve(index.size());
+	for (uint32_t e = 0; e < uint32_t(index.size()); ++e) {
+		IndexedEntry const &entry = index[e];
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+			throw std::runtime_error("index entry has out-of-range name begin/end");
+		}
+		if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= vertex_count)) {
+			throw std::runtime_error("index entry has out-of-range vertex start/count");
+		}
+		if (!(entry.index_begin <= entry.index_end && entry.index_end <= pnct.indices.size())) {
+			throw std::runtime_error("index entry has out-of-range index start/count");
+		}
+		for (uint32_t i = entry.index_begin; i < entry.index_end; ++i) {
+			if (pnct.indices[i] >= entry.vertex_end - entry.vertex_begin) {
+				throw std::runtime_error("mesh has an index past its last vertex");
+			}
+		}
+
+		pnct.meshes.emplace_back();
+		PnctFile::Entry &mesh = pnct.meshes.back();
+		mesh.name = std::string(strings.data() + entry.name_begin, strings.data() + entry.name_end);
+		mesh.vertex_begin = entry.vertex_begin;
+		mesh.vertex_end = entry.vertex_end;
+		mesh.index_begin = entry.index_begin;
+		mesh.index_end = entry.index_end;
+		if (pnct.quantized) {
+			mesh.position_offset = dequantize[e].offset;
+			mesh.position_scale = dequantize[e].scale;
+		}
+	}
+
+	if (file.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+	}
+}
+
+void write_pnct(std::string const &filename, PnctFile const &pnct) {
+	if (pnct.indexed() && pnct.index_size == 2 && pnct.smallest_index_size() != 2) {
+		throw std::runtime_error("Writing '" + filename + "': a mesh has too many vertices for 16-bit indices.");
+	}
+
+	std::vector< char > strings;
+	std::vector< IndexedEntry > index;
+	index.reserve(pnct.meshes.size());
+	for (auto const &mesh : pnct.meshes) {
+		IndexedEntry entry;
+		entry.name_begin = uint32_t(strings.size());
+		strings.insert(strings.end(), mesh.name.begin(), mesh.name.end());
+		entry.name_end = uint32_t(strings.size());
+		entry.vertex_begin = mesh.vertex_begin;
+		entry.vertex_end = mesh.vertex_end;
+		entry.index_begin = mesh.index_begin;
+		entry.index_end = mesh.index_end;
+		index.emplace_back(entry);
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	if (pnct.quantized) {
+		write_chunk("pnq0", pnct.quantized_vertices, &file);
+	} else {
+		write_chunk("pnct", pnct.vertices, &file);
+	}
+	if (pnct.index_size == 2) {
+		write_chunk("ix16", std::vector< uint16_t >(pnct.indices.begin(), pnct.indices.end()), &file);
+	} else if (pnct.index_size == 4) {
+		write_chunk("ix32", pnct.indices, &file);
+	}
+	write_chunk("str0", strings, &file);
+	if (pnct.indexed()) {
+		write_chunk("idx1", index, &file);
+	} else {
+		std::vector< SoupEntry > soup;
+		soup.reserve(index.size());
+		for (auto const &entry : index) {
+			soup.emplace_back(SoupEntry{ entry.name_begin, entry.name_end, entry.vertex_begin, entry.vertex_end });
+		}
+		write_chunk("idx0", soup, &file);
+	}
+	if (pnct.quantized) {
+		std::vector< Dequantize > dequantize;
+		dequantize.reserve(pnct.meshes.size());
+		for (auto const &mesh : pnct.meshes) {
+			dequantize.emplace_back(Dequantize{ mesh.position_offset, mesh.position_scale });
+		}
+		write_chunk("qbx0", dequantize, &file);
+	}
+	if (!file) throw std::runtime_error("Failed to write '" + filename + "'.");
+}
+
+uint32_t PnctFile::smallest_index_size() const {
+	uint32_t max_mesh_vertices = 0;
+	for (auto const &mesh : meshes) max_mesh_vertices = std::max(max_mesh_vertices, mesh.vertex_end - mesh.vertex_begin);
+	return (max_mesh_vertices <= 65536 ? 2 : 4);
+}
+
+void PnctFile::weld() {
+	if (indexed()) return;
+	if (quantized) throw std::runtime_error("PnctFile::weld: quantized meshes can't be welded.");
+
+	std::vector< PnctVertex > welded_vertices;
+	indices.clear();
+	for (auto &mesh : meshes) {
+		uint32_t vertex_begin = uint32_t(welded_vertices.size());
+		uint32_t index_begin = uint32_t(indices.size());
+		std::unordered_map< std::string, uint32_t > welded;
+		for (uint32_t v = mesh.vertex_begin; v < mesh.vertex_end; ++v) {
+			std::string key(reinterpret_cast< char const * >(&vertices[v]), sizeof(PnctVertex));
+			auto ret = welded.emplace(key, uint32_t(welded.size()));
+			if (ret.second) welded_vertices.emplace_back(vertices[v]);
+			indices.emplace_back(ret.first->second);
+		}
+		mesh.vertex_begin = vertex_begin;
+		mesh.vertex_end = uint32_t(welded_vertices.size());
+		mesh.index_begin = index_begin;
+		mesh.index_end = uint32_t(indices.size());
+	}
+	vertices = std::move(welded_vertices);
+	index_size = smallest_index_size();
+}
+
+void PnctFile::expand() {
+	if (!indexed()) return;
+
+	auto expand_vertices = [this](auto const &from, auto *to_) {
+		auto &to = *to_;
+		to.clear();
+		for (auto &mesh : meshes) {
+			uint32_t vertex_begin = uint32_t(to.size());
+			for (uint32_t i = mesh.index_begin; i < mesh.index_end; ++i) {
+				to.emplace_back(from[mesh.vertex_begin + indices[i]]);
+			}
+			mesh.vertex_begin = vertex_begin;
+			mesh.vertex_end = uint32_t(to.size());
+			mesh.index_begin = mesh.index_end = 0;
+		}
+	};
+	if (quantized) {
+		std::vector< PnctQuantizedVertex > expanded;
+		expand_vertices(quantized_vertices, &expanded);
+		quantized_vertices = std::move(expanded);
+	} else {
+		std::vector< PnctVertex > expanded;
+		expand_vertices(vertices, &expanded);
+		vertices = std::move(expanded);
+	}
+	indices.clear();
+	index_size = 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * Reading and writing .pnct mesh files (the format is described in Mesh.hpp)
+ *  without OpenGL, so that MeshBuffer, OccluderMeshes, and the command-line
+ *  tools in scenes/ all read (and check) files the same way.
+ *
+ * A PnctFile holds the file's vertices -- plain or quantized -- and, for
+ *  indexed files, its indices, along with one Entry per mesh.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//vertices as stored in the pnct chunk:
+struct PnctVertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(PnctVertex) == 3*4+3*4+4*1+2*4, "PnctVertex is packed.");
+
+//..and as stored in the pnq0 chunk of quantized files:
+struct PnctQuantizedVertex {
+	glm::u16vec4 Position; //fraction of the mesh's bounds (xyz); zero (w)
+	glm::i16vec2 Normal; //octahedral encoding
+	glm::u8vec4 Color;
+	glm::u16vec2 TexCoord; //half-floats
+};
+static_assert(sizeof(PnctQuantizedVertex) == 4*2+2*2+4*1+2*2, "PnctQuantizedVertex is packed.");
+
+struct PnctFile {
+	//vertex data (only one of these is used, depending on 'quantized'):
+	bool quantized = false;
+	std::vector< PnctVertex > vertices;
+	std::vector< PnctQuantizedVertex > quantized_vertices;
+	size_t vertex_count() const { return quantized ? quantized_vertices.size() : vertices.size(); }
+
+	//indexed files keep a triangle list per mesh, counting from the mesh's first vertex:
+	// (index_size is 2 or 4 bytes in the file -- an ix16 or ix32 chunk -- or 0 for triangle soup)
+	uint32_t index_size = 0;
+	std::vector< uint32_t > indices;
+	bool indexed() const { return index_size != 0; }
+
+	struct Entry {
+		std::string name;
+		uint32_t vertex_begin = 0, vertex_end = 0;
+		uint32_t index_begin = 0, index_end = 0; //(indexed files only)
+		//quantized files store positions as 'position_offset + position_scale * Position':
+		glm::vec3 position_offset = glm::vec3(0.0f);
+		glm::vec3 position_scale = glm::vec3(1.0f);
+	};
+	std::vector< Entry > meshes; //(in file order)
+
+	//object-space position of a mesh's vertex 'v' (an index into the vertex data, not into the mesh):
+	glm::vec3 position(Entry const &entry, uint32_t v) const {
+		if (quantized) return entry.position_offset + entry.position_scale * (glm::vec3(quantized_vertices[v].Position) / 65535.0f);
+		return vertices[v].Position;
+	}
+
+	//smallest index size that can hold every mesh's indices (2 unless a mesh has more than 65536 vertices):
+	uint32_t smallest_index_size() const;
+
+	//turn triangle soup into an indexed file by welding identical vertices within each mesh:
+	// (unquantized files only; indexed files are left as they are)
+	void weld();
+	//..or an indexed file back into triangle soup, with each mesh's triangles expanded into its own vertices:
+	void expand();
+};
+
+//read a .pnct file, checking that every mesh's name, vertex, and index ranges (and indices) are in range:
+// note: throws on a malformed file; warns about trailing data
+void read_pnct(std::string const &filename, PnctFile *pnct);
+
+//write a .pnct file (indexed with pnct.index_size-byte indices, and/or quantized, as pnct says):
+// note: throws if the file can't be written
+void write_pnct(std::string const &filename, PnctFile const &pnct);
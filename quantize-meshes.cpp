@@ -0,0 +1,165 @@
+//quantize-meshes rewrites a .pnct file with compact vertices:
+// quantize-meshes <in.pnct> <out.pnct>
+//
+//Each 36-byte vertex becomes 20 bytes (see Mesh.hpp for the format MeshBuffer reads back):
+// - positions are 16-bit fractions of the mesh's bounding box, which is stored once per mesh (qbx0 chunk)
+// - normals are octahedral-encoded in two 16-bit snorms
+// - colors are unchanged
+// - texture coordinates are half-floats
+//
+//Levels of detail of one mesh ("<name>.LOD<n>") share one bounding box, since they are drawn with the
+// same matrices.
+//
+//Both plain and indexed files work; the index is copied unchanged. Quantize last -- simplify-meshes
+// (and other tools that edit vertices) only read unquantized files.
+
+#include "pnct_file.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//octahedral encoding: project onto the octahedron |x|+|y|+|z| = 1, then fold the lower half out to the corners:
+static glm::i16vec2 encode_normal(glm::vec3 n) {
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (!(l1 > 0.0f)) return glm::i16vec2(0, 0); //(decodes to +z)
+	n /= l1;
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f) {
+		e = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x)))
+		  * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	e = glm::clamp(e, glm::vec2(-1.0f), glm::vec2(1.0f));
+	return glm::i16vec2(glm::round(e * 32767.0f));
+}
+
+//(same as MeshBuffer::VertexGLSL's mesh_normal, for error reporting)
+static glm::vec3 decode_normal(glm::i16vec2 q) {
+	glm::vec2 e = glm::max(glm::vec2(q) / 32767.0f, glm::vec2(-1.0f));
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f) {
+		glm::vec2 xy = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x)))
+		  * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		n.x = xy.x;
+		n.y = xy.y;
+	}
+	return glm::normalize(n);
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	if (argc != 3) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <in.pnct> <out.pnct>\n"
+			"Rewrites a mesh file with 16-bit positions and normals and half-float texture coordinates." << std::endl;
+		return 1;
+	}
+	std::string in_file = argv[1];
+	std::string out_file = argv[2];
+
+	//read:
+	PnctFile pnct;
+	read_pnct(in_file, &pnct);
+	if (pnct.quantized) {
+		throw std::runtime_error("'" + in_file + "' is already quantized.");
+	}
+
+	//bounds of each mesh, shared between levels of detail:
+	std::vector< std::string > groups; //group name of each entry
+	std::map< std::string, std::pair< glm::vec3, glm::vec3 > > group_bounds;
+	for (auto const &entry : pnct.meshes) {
+		std::string name = entry.name;
+		std::string::size_type lod = name.rfind(".LOD");
+		if (lod != std::string::npos) name = name.substr(0, lod);
+		groups.emplace_back(name);
+
+		auto ret = group_bounds.emplace(name, std::make_pair(
+			glm::vec3( std::numeric_limits< float >::infinity()),
+			glm::vec3(-std::numeric_limits< float >::infinity())
+		));
+		glm::vec3 &min = ret.first->second.first;
+		glm::vec3 &max = ret.first->second.second;
+		for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+			min = glm::min(min, pnct.vertices[v].Position);
+			max = glm::max(max, pnct.vertices[v].Position);
+		}
+	}
+
+	//quantize each mesh's vertices (the index and mesh ranges are kept as they are):
+	// (vertices not in any mesh are left as zero)
+	std::vector< PnctVertex > const &data = pnct.vertices;
+	std::vector< PnctQuantizedVertex > &out_data = pnct.quantized_vertices;
+	out_data.assign(data.size(), PnctQuantizedVertex{ glm::u16vec4(0), glm::i16vec2(0), glm::u8vec4(0), glm::u16vec2(0) });
+	float max_position_error = 0.0f; //as a fraction of the mesh's bounding box diagonal
+	float min_normal_cos = 1.0f;
+	for (uint32_t i = 0; i < uint32_t(pnct.meshes.size()); ++i) {
+		PnctFile::Entry &entry = pnct.meshes[i];
+		auto const &bounds = group_bounds[groups[i]];
+
+		if (bounds.first.x <= bounds.second.x) {
+			entry.position_offset = bounds.first;
+			entry.position_scale = bounds.second - bounds.first; //(zero on flat axes)
+		} else { //(empty mesh)
+			entry.position_offset = glm::vec3(0.0f);
+			entry.position_scale = glm::vec3(0.0f);
+		}
+		glm::vec3 const &offset = entry.position_offset;
+		glm::vec3 const &scale = entry.position_scale;
+		float diagonal = glm::length(scale);
+
+		for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+			PnctVertex const &in = data[v];
+			PnctQuantizedVertex &out = out_data[v];
+
+			glm::vec3 f = glm::vec3(0.0f);
+			for (uint32_t c = 0; c < 3; ++c) {
+				if (scale[c] > 0.0f) f[c] = (in.Position[c] - offset[c]) / scale[c];
+			}
+			f = glm::clamp(f, glm::vec3(0.0f), glm::vec3(1.0f));
+			out.Position = glm::u16vec4(glm::u16vec3(glm::round(f * 65535.0f)), 0);
+			out.Normal = encode_normal(in.Normal);
+			out.Color = in.Color;
+			out.TexCoord = glm::u16vec2(glm::packHalf1x16(in.TexCoord.x), glm::packHalf1x16(in.TexCoord.y));
+
+			if (diagonal > 0.0f) {
+				glm::vec3 position = offset + scale * (glm::vec3(out.Position) / 65535.0f);
+				max_position_error = std::max(max_position_error, glm::length(position - in.Position) / diagonal);
+			}
+			if (glm::length(in.Normal) > 0.0f) {
+				min_normal_cos = std::min(min_normal_cos, glm::dot(decode_normal(out.Normal), glm::normalize(in.Normal)));
+			}
+		}
+	}
+
+	//write (the same file, with pnq0 for pnct and qbx0 at the end):
+	pnct.quantized = true;
+	write_pnct(out_file, pnct);
+
+	std::cout << "Quantized " << data.size() << " vertices in " << pnct.meshes.size() << " meshes: "
+		<< data.size() * sizeof(PnctVertex) << " -> " << out_data.size() * sizeof(PnctQuantizedVertex) << " bytes of vertex data." << std::endl;
+	std::cout << "Largest position error is " << max_position_error << " of a mesh's diagonal; largest normal error is "
+		<< std::acos(std::min(1.0f, min_normal_cos)) * (180.0f / 3.14159265f) << " degrees." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
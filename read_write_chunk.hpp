@@ -4,6 +4,7 @@
 #include <vector>
 #include <stdexcept>
 #include <cassert>
+#include <string>
 
 //helper function that reads an array of structures preceded by a simple header:
 //Expected format:
@@ -41,6 +42,20 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 }
 
 
+//helper function that returns the magic number of the next chunk without reading it:
+// (returns an empty string at end of file; useful for files with optional chunks)
+inline std::string peek_chunk_magic(std::istream &from) {
+	char magic[4];
+	std::streampos at = from.tellg();
+	if (!from.read(magic, 4)) {
+		from.clear();
+		from.seekg(at);
+		return "";
+	}
+	from.seekg(at);
+	return std::string(magic, 4);
+}
+
 //helper function to write a chunk of data in the same format as read_chunk:
 template< typename T >
 void write_chunk(std::string const &magic, std::vector< T > const &from, std::ostream *to_) {
@@ -3,6 +3,7 @@
 #based on 'export-sprites.py' and 'glsprite.py' from TCHOW Rainbow; code used is released into the public domain.
 #Patched for 15-466-f19 to remove non-pnct formats!
 #Patched for 15-466-f20 to merge data all at once (slightly faster)
+#Patched to weld identical vertices and write indexed meshes (pnct, ix16/ix32, str0, idx1 chunks -- see Mesh.hpp)
 
 #Note: Script meant to be executed within blender 2.9, as per:
 #blender --background --python export-meshes.py -- [...see below...]
@@ -91,13 +92,18 @@ set_visible(bpy.context.view_layer.layer_collection)
 #data contains vertex, normal, color, and texture data from the meshes:
 data = []
 
+#indices contains each mesh's triangles, as indices counting from the mesh's first vertex:
+indices = []
+
 #strings contains the mesh names:
 strings = b''
 
-#index gives offsets into the data (and names) for each mesh:
+#index gives offsets into the data, indices (and names) for each mesh:
 index = b''
 
 vertex_count = 0
+corner_count = 0 #(vertices before welding, for the summary)
+max_mesh_vertices = 0
 for obj in bpy.data.objects:
 	if obj.data in to_write:
 		to_write.remove(obj.data)
@@ -141,7 +147,7 @@ for obj in bpy.data.objects:
 	index += struct.pack('I', name_end)
 
 	index += struct.pack('I', vertex_count) #vertex_begin
-	#...count will be written below
+	#...vertex_end and index range will be written below
 
 	colors = None
 	if len(obj.data.vertex_colors) == 0:
@@ -159,15 +165,16 @@ for obj in bpy.data.objects:
 		if len(obj.data.uv_layers) != 1:
 			print("WARNING: object '" + name + "' has multiple texture coordinate layers; only exporting '" + obj.data.uv_layers.active.name + "'")
 
-	local_data = b''
-
-	#write the mesh triangles:
+	#write the mesh triangles, welding corners with identical (packed) vertex data:
+	welded = dict()
+	index_begin = len(indices)
 	for poly in mesh.polygons:
 		assert(len(poly.loop_indices) == 3)
 		for i in range(0,3):
 			assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
 			loop = mesh.loops[poly.loop_indices[i]]
 			vertex = mesh.vertices[loop.vertex_index]
+			local_data = b''
 			for x in vertex.co:
 				local_data += struct.pack('f', x)
 			for x in loop.normal:
@@ -182,35 +189,51 @@ for obj in bpy.data.objects:
 				local_data += struct.pack('ff', uv.x, uv.y)
 			else:
 				local_data += struct.pack('ff', 0, 0)
-		if len(local_data) > 1000:
-			data.append(local_data)
-			local_data = b''
-	vertex_count += len(mesh.polygons) * 3
-
-	data.append(local_data)
+			if local_data not in welded:
+				welded[local_data] = len(welded)
+				data.append(local_data)
+			indices.append(welded[local_data])
+	vertex_count += len(welded)
+	corner_count += len(mesh.polygons) * 3
+	max_mesh_vertices = max(max_mesh_vertices, len(welded))
 
 	index += struct.pack('I', vertex_count) #vertex_end
+	index += struct.pack('I', index_begin) #index_begin
+	index += struct.pack('I', len(indices)) #index_end
 
 data = b''.join(data)
 
 #check that code created as much data as anticipated:
 assert(vertex_count * (4*3+4*3+1*4+4*2) == len(data))
 
+#indices count from each mesh's first vertex, so 16 bits are enough unless some mesh has more than 65536 vertices:
+if max_mesh_vertices <= 65536:
+	index_magic = b'ix16'
+	index_data = struct.pack(str(len(indices)) + 'H', *indices)
+else:
+	index_magic = b'ix32'
+	index_data = struct.pack(str(len(indices)) + 'I', *indices)
+
 #write the data chunk and index chunk to an output blob:
 blob = open(outfile, 'wb')
 #first chunk: the data
 blob.write(struct.pack('4s',b'pnct')) #type
 blob.write(struct.pack('I', len(data))) #length
 blob.write(data)
-#second chunk: the strings
+#second chunk: the triangle indices
+blob.write(struct.pack('4s',index_magic)) #type
+blob.write(struct.pack('I', len(index_data))) #length
+blob.write(index_data)
+#third chunk: the strings
 blob.write(struct.pack('4s',b'str0')) #type
 blob.write(struct.pack('I', len(strings))) #length
 blob.write(strings)
-#third chunk: the index
-blob.write(struct.pack('4s',b'idx0')) #type
+#fourth chunk: the index
+blob.write(struct.pack('4s',b'idx1')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
 wrote = blob.tell()
 blob.close()
 
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Welded " + str(corner_count) + " triangle corners to " + str(vertex_count) + " vertices.")
+print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(index_data)+8) + " bytes of triangle indices + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
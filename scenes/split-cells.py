@@ -0,0 +1,315 @@
+#!/usr/bin/env python
+
+#Note: unlike the other scripts here, this is plain python (no blender needed), as per:
+#python3 split-cells.py <prefix> <cell size> [keep pattern]
+
+#Splits an exported level -- <prefix>.scene, <prefix>.pnct, and <prefix>.w -- into square cells (in the xy plane)
+# that can be streamed in and out as the player moves (see LevelStreamer.hpp):
+# <prefix>.cells                       list of cells
+# <prefix>-cell-<x>-<y>.{scene,pnct,w}  contents of cell (x,y), covering [x,x+1)*size by [y,y+1)*size
+# <prefix>-resident.{scene,pnct}       everything that stays loaded: objects whose name (or an ancestor's name)
+#                                      matches /keep pattern/, and transforms with nothing attached
+#
+#Meshes, cameras, and lights go to the cell holding their object's origin (along with copies of its ancestors);
+# walkmesh triangles go to the cell holding their centroid (vertices on cell borders are copied into both cells
+# and re-joined at runtime).
+
+import sys,re,struct,math
+
+args = sys.argv[1:]
+if len(args) < 2 or len(args) > 3:
+	print("\n\nUsage:\npython3 split-cells.py <prefix> <cell size> [keep pattern]\nSplits <prefix>.scene, <prefix>.pnct, and <prefix>.w into streaming cells of the given size.\n")
+	exit(1)
+
+prefix = args[0]
+cell_size = float(args[1])
+keep = re.compile(args[2] if len(args) == 3 else r'^$')
+assert cell_size > 0.0
+
+#---------------------------------------------------------------------
+#Chunk helpers (same format as read_write_chunk.hpp):
+
+def read_chunks(filename):
+	chunks = []
+	with open(filename, 'rb') as f:
+		data = f.read()
+	at = 0
+	while at < len(data):
+		magic, size = struct.unpack('4sI', data[at:at+8])
+		chunks.append((magic, data[at+8:at+8+size]))
+		at += 8 + size
+	return chunks
+
+def expect(chunks, index, magic):
+	if index >= len(chunks) or chunks[index][0] != magic:
+		print("ERROR: expected chunk '" + magic.decode('utf8') + "'.")
+		exit(1)
+	return chunks[index][1]
+
+def unpack_all(fmt, data):
+	size = struct.calcsize(fmt)
+	assert len(data) % size == 0
+	return [ struct.unpack(fmt, data[i:i+size]) for i in range(0, len(data), size) ]
+
+def write_chunks(filename, chunks):
+	with open(filename, 'wb') as blob:
+		for magic, data in chunks:
+			blob.write(struct.pack('4s', magic))
+			blob.write(struct.pack('I', len(data)))
+			blob.write(data)
+
+class Strings:
+	def __init__(self):
+		self.data = b""
+	def add(self, string):
+		begin = len(self.data)
+		self.data += string
+		return (begin, len(self.data))
+
+#---------------------------------------------------------------------
+#Read the level:
+
+scene = read_chunks(prefix + '.scene')
+names = expect(scene, 0, b'str0')
+hierarchy = unpack_all('=III3f4f3f', expect(scene, 1, b'xfh0'))
+scene_meshes = unpack_all('=III', expect(scene, 2, b'msh0'))
+scene_cameras = unpack_all('=I4sfff', expect(scene, 3, b'cam0'))
+scene_lights = unpack_all('=Ic3Bfff', expect(scene, 4, b'lmp0'))
+
+def name_of(begin, end):
+	return names[begin:end]
+
+pnct = read_chunks(prefix + '.pnct')
+#vertices are either full-size or quantized (see Mesh.hpp); quantized meshes carry their position offset + scale along:
+vertex_magic = b'pnq0' if len(pnct) > 0 and pnct[0][0] == b'pnq0' else b'pnct'
+VERTEX = 4*2+2*2+4*1+2*2 if vertex_magic == b'pnq0' else 3*4+3*4+4*1+2*4
+vertex_data = expect(pnct, 0, vertex_magic)
+#meshes are either triangle soup or indexed (see Mesh.hpp); cells are written the same way as the level:
+index_format = None
+if len(pnct) > 1 and pnct[1][0] in (b'ix16', b'ix32'):
+	index_magic = pnct[1][0]
+	index_format = '=H' if index_magic == b'ix16' else '=I'
+	index_data = pnct[1][1]
+	pnct = pnct[0:1] + pnct[2:]
+mesh_strings = expect(pnct, 1, b'str0')
+mesh_by_name = dict()
+mesh_index = unpack_all('=6I', expect(pnct, 2, b'idx1')) if index_format else unpack_all('=IIII', expect(pnct, 2, b'idx0'))
+DEQUANTIZE = 6*4
+dequantize_data = expect(pnct, 3, b'qbx0') if vertex_magic == b'pnq0' else b""
+for i, entry in enumerate(mesh_index):
+	nb, ne, vb, ve = entry[0:4]
+	indices = b""
+	if index_format:
+		INDEX = struct.calcsize(index_format)
+		indices = index_data[entry[4]*INDEX:entry[5]*INDEX]
+	mesh_by_name[mesh_strings[nb:ne]] = (vertex_data[vb*VERTEX:ve*VERTEX], indices, dequantize_data[i*DEQUANTIZE:(i+1)*DEQUANTIZE])
+
+walk = read_chunks(prefix + '.w')
+walk_vertices = unpack_all('=3f', expect(walk, 0, b'p...'))
+walk_normals = unpack_all('=3f', expect(walk, 1, b'n...'))
+walk_triangles = unpack_all('=3I', expect(walk, 2, b'tri0'))
+walk_strings = expect(walk, 3, b'str0')
+walk_index = unpack_all('=6I', expect(walk, 4, b'idxA'))
+
+#---------------------------------------------------------------------
+#World-space origins of transforms (to decide which cell things land in):
+
+def rotate(q, v):
+	x, y, z, w = q
+	#v + 2 * cross(q.xyz, cross(q.xyz, v) + w * v):
+	cx = y*v[2] - z*v[1] + w*v[0]
+	cy = z*v[0] - x*v[2] + w*v[1]
+	cz = x*v[1] - y*v[0] + w*v[2]
+	return (v[0] + 2.0*(y*cz - z*cy), v[1] + 2.0*(z*cx - x*cz), v[2] + 2.0*(x*cy - y*cx))
+
+def multiply(a, b):
+	ax, ay, az, aw = a
+	bx, by, bz, bw = b
+	return (aw*bx + ax*bw + ay*bz - az*by,
+	        aw*by - ax*bz + ay*bw + az*bx,
+	        aw*bz + ax*by - ay*bx + az*bw,
+	        aw*bw - ax*bx - ay*by - az*bz)
+
+#world transform of each entry as (position, rotation, scale) -- exact for the uniform scales levels use:
+world = []
+for h in hierarchy:
+	parent = h[0]
+	position, rotation, scale = h[3:6], h[6:10], h[10:13]
+	if parent != 0xffffffff:
+		assert parent < len(world) #(exported scenes list parents first)
+		pp, pr, ps = world[parent]
+		scaled = (position[0]*ps[0], position[1]*ps[1], position[2]*ps[2])
+		r = rotate(pr, scaled)
+		position = (pp[0]+r[0], pp[1]+r[1], pp[2]+r[2])
+		rotation = multiply(pr, rotation)
+		scale = (ps[0]*scale[0], ps[1]*scale[1], ps[2]*scale[2])
+	world.append((position, rotation, scale))
+
+def cell_of(point):
+	return (int(math.floor(point[0] / cell_size)), int(math.floor(point[1] / cell_size)))
+
+def kept(index):
+	while index != 0xffffffff:
+		h = hierarchy[index]
+		if keep.search(name_of(h[1], h[2]).decode('utf8')): return True
+		index = h[0]
+	return False
+
+#---------------------------------------------------------------------
+#Sort things into cells:
+
+RESIDENT = 'resident'
+
+class Part:
+	def __init__(self):
+		self.transforms = set() #hierarchy indices (including ancestors)
+		self.meshes = []
+		self.cameras = []
+		self.lights = []
+		self.walk = dict() #walkmesh name -> list of triangles
+
+parts = dict()
+def part(key):
+	if key not in parts: parts[key] = Part()
+	return parts[key]
+
+def place(index):
+	key = RESIDENT if kept(index) else cell_of(world[index][0])
+	p = part(key)
+	while index != 0xffffffff and index not in p.transforms:
+		p.transforms.add(index)
+		index = hierarchy[index][0]
+	return p
+
+attached = set()
+for m in scene_meshes:
+	place(m[0]).meshes.append(m)
+	attached.add(m[0])
+for c in scene_cameras:
+	place(c[0]).cameras.append(c)
+	attached.add(c[0])
+for l in scene_lights:
+	place(l[0]).lights.append(l)
+	attached.add(l[0])
+
+#bare transforms (e.g., spawn points) are cheap and looked up by name, so keep them resident:
+for i in range(0, len(hierarchy)):
+	if i not in attached:
+		p = part(RESIDENT)
+		index = i
+		while index != 0xffffffff and index not in p.transforms:
+			p.transforms.add(index)
+			index = hierarchy[index][0]
+
+for (nb, ne, vb, ve, tb, te) in walk_index:
+	walk_name = walk_strings[nb:ne]
+	for t in walk_triangles[tb:te]:
+		a, b, c = walk_vertices[t[0]], walk_vertices[t[1]], walk_vertices[t[2]]
+		centroid = ((a[0]+b[0]+c[0])/3.0, (a[1]+b[1]+c[1])/3.0, (a[2]+b[2]+c[2])/3.0)
+		part(cell_of(centroid)).walk.setdefault(walk_name, []).append(t)
+
+#make sure every cell has (a possibly empty) copy of every walkmesh:
+for (nb, ne, vb, ve, tb, te) in walk_index:
+	for key in parts:
+		if key != RESIDENT: parts[key].walk.setdefault(walk_strings[nb:ne], [])
+
+#---------------------------------------------------------------------
+#Write parts:
+
+def write_scene(filename, p):
+	strings = Strings()
+	order = sorted(p.transforms) #(keeps parents before children)
+	remap = dict()
+	xfh = b""
+	for i in order:
+		h = hierarchy[i]
+		remap[i] = len(remap)
+		parent = remap[h[0]] if h[0] != 0xffffffff else 0xffffffff
+		nb, ne = strings.add(name_of(h[1], h[2]))
+		xfh += struct.pack('=III3f4f3f', parent, nb, ne, *h[3:])
+	msh = b""
+	for m in p.meshes:
+		nb, ne = strings.add(name_of(m[1], m[2]))
+		msh += struct.pack('=III', remap[m[0]], nb, ne)
+	cam = b"".join(struct.pack('=I4sfff', remap[c[0]], *c[1:]) for c in p.cameras)
+	lmp = b"".join(struct.pack('=Ic3Bfff', remap[l[0]], *l[1:]) for l in p.lights)
+	write_chunks(filename, [(b'str0', strings.data), (b'xfh0', xfh), (b'msh0', msh), (b'cam0', cam), (b'lmp0', lmp)])
+
+def write_pnct(filename, p):
+	strings = Strings()
+	data = b""
+	indices = b""
+	index = b""
+	dequantize = b""
+	written = set()
+	for m in p.meshes:
+		name = name_of(m[1], m[2])
+		if name in written: continue
+		written.add(name)
+		if name not in mesh_by_name:
+			print("ERROR: mesh '" + name.decode('utf8') + "' is not in '" + prefix + ".pnct'.")
+			exit(1)
+		vb = len(data) // VERTEX
+		data += mesh_by_name[name][0]
+		dequantize += mesh_by_name[name][2]
+		nb, ne = strings.add(name)
+		if index_format:
+			#(indices count from the mesh's first vertex, so they copy over unchanged)
+			ib = len(indices) // INDEX
+			indices += mesh_by_name[name][1]
+			index += struct.pack('=6I', nb, ne, vb, len(data) // VERTEX, ib, len(indices) // INDEX)
+		else:
+			index += struct.pack('=IIII', nb, ne, vb, len(data) // VERTEX)
+	if index_format:
+		chunks = [(vertex_magic, data), (index_magic, indices), (b'str0', strings.data), (b'idx1', index)]
+	else:
+		chunks = [(vertex_magic, data), (b'str0', strings.data), (b'idx0', index)]
+	if vertex_magic == b'pnq0':
+		chunks.append((b'qbx0', dequantize))
+	write_chunks(filename, chunks)
+
+def write_w(filename, p):
+	strings = Strings()
+	vertices = b""
+	normals = b""
+	triangles = b""
+	index = b""
+	vertex_count = 0
+	triangle_count = 0
+	for walk_name in sorted(p.walk):
+		remap = dict()
+		vb, tb = vertex_count, triangle_count
+		for t in p.walk[walk_name]:
+			for v in t:
+				if v not in remap:
+					remap[v] = vertex_count - vb
+					vertices += struct.pack('=3f', *walk_vertices[v])
+					normals += struct.pack('=3f', *walk_normals[v])
+					vertex_count += 1
+			triangles += struct.pack('=3I', *(vb + remap[v] for v in t))
+			triangle_count += 1
+		nb, ne = strings.add(walk_name)
+		index += struct.pack('=6I', nb, ne, vb, vertex_count, tb, triangle_count)
+	write_chunks(filename, [(b'p...', vertices), (b'n...', normals), (b'tri0', triangles), (b'str0', strings.data), (b'idxA', index)])
+
+resident = part(RESIDENT)
+write_scene(prefix + '-resident.scene', resident)
+write_pnct(prefix + '-resident.pnct', resident)
+
+cells = sorted(key for key in parts if key != RESIDENT)
+for (x, y) in cells:
+	p = parts[(x, y)]
+	base = prefix + '-cell-' + str(x) + '-' + str(y)
+	write_scene(base + '.scene', p)
+	write_pnct(base + '.pnct', p)
+	write_w(base + '.w', p)
+
+#Cells file format:
+# grd0 4 < float > [cell size]
+# cel0 len < int int > * [coordinates of each cell]
+write_chunks(prefix + '.cells', [
+	(b'grd0', struct.pack('=f', cell_size)),
+	(b'cel0', b"".join(struct.pack('=ii', x, y) for (x, y) in cells)),
+])
+
+print("Wrote " + str(len(cells)) + " cells (and resident set with " + str(len(resident.transforms)) + " transforms) for '" + prefix + "'.")
@@ -0,0 +1,541 @@
+//simplify-meshes adds coarser levels of detail to every mesh in a .pnct file:
+// simplify-meshes <in.pnct> <out.pnct> [--levels N] [--ratio R] [--error E]
+//
+//Each mesh "<name>" is renamed "<name>.LOD0" and followed by "<name>.LOD1", "<name>.LOD2", ...,
+// each with about R (default 0.5) times as many triangles as the level before, up to N (default 3)
+// extra levels. MeshBuffer gathers these back into Mesh::lods (and still finds the mesh as "<name>"),
+// so scenes don't need to change.
+//
+//Levels are made by quadric-error edge collapse (Garland & Heckbert, "Surface Simplification Using
+// Quadric Error Metrics", 1997), using half-edge collapses -- a vertex moves onto a neighbor -- so
+// no new vertex attributes are ever invented:
+// - color and UV seams and hard creases (places where one position has several different vertices) only
+//   collapse along the seam, so a seam can get coarser but never moves off its line or tears open
+// - normals are averaged where vertices are welded (flat-shaded meshes get fresh face normals instead)
+// - open borders likewise only collapse along the border
+// - collapses that would flip a triangle over, or pinch the surface into a non-manifold shape, are skipped
+// - a level stops early if the next collapse would move the surface more than E (default 0.02) times the
+//   mesh's bounding box diagonal, on average, doubling with each level; levels that barely remove
+//   anything end the chain
+//
+//Meshes that already have levels of detail (named "*.LOD<n>") are copied as-is.
+//
+//Indexed files (see Mesh.hpp) are written back indexed, with each mesh's vertices welded again.
+
+#include "pnct_file.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//(vertices as read by pnct_file.hpp)
+typedef PnctVertex Vertex;
+
+//meshes with fewer triangles than this aren't worth simplifying:
+static constexpr uint32_t MinTriangles = 16;
+//a level that keeps more than this fraction of the level before it isn't worth having:
+static constexpr float MinReduction = 0.85f;
+//border and seam edges are held in place by planes through them, weighted this much more than faces:
+static constexpr double EdgeWeight = 10.0;
+//vertices whose normals are further apart than this (as cosine) are on either side of a hard crease:
+static constexpr float CreaseCos = 0.5f;
+//collapses that turn a triangle's normal by more than this (as cosine) are skipped:
+static constexpr float MaxTurnCos = 0.2f;
+
+//---------------------------------------------------------------------
+//Quadric error: sum of (weighted) squared distances to a set of planes, stored as a symmetric 4x4 matrix:
+
+struct Quadric {
+	double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+	double b2 = 0.0, bc = 0.0, bd = 0.0;
+	double c2 = 0.0, cd = 0.0;
+	double d2 = 0.0;
+	double weight = 0.0; //total weight of planes (so error / weight is a mean squared distance)
+
+	//plane dot(n, x) + d = 0 (n unit length):
+	static Quadric plane(glm::vec3 const &n, float d, double w) {
+		Quadric q;
+		q.a2 = w * n.x * n.x; q.ab = w * n.x * n.y; q.ac = w * n.x * n.z; q.ad = w * n.x * d;
+		q.b2 = w * n.y * n.y; q.bc = w * n.y * n.z; q.bd = w * n.y * d;
+		q.c2 = w * n.z * n.z; q.cd = w * n.z * d;
+		q.d2 = w * double(d) * d;
+		q.weight = w;
+		return q;
+	}
+
+	Quadric &operator+=(Quadric const &o) {
+		a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+		b2 += o.b2; bc += o.bc; bd += o.bd;
+		c2 += o.c2; cd += o.cd;
+		d2 += o.d2;
+		weight += o.weight;
+		return *this;
+	}
+
+	//sum of weighted squared distances from p to the planes:
+	double error(glm::vec3 const &p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = a2*x*x + 2.0*ab*x*y + 2.0*ac*x*z + 2.0*ad*x
+		         + b2*y*y + 2.0*bc*y*z + 2.0*bd*y
+		         + c2*z*z + 2.0*cd*z
+		         + d2;
+		return std::max(e, 0.0);
+	}
+};
+
+//---------------------------------------------------------------------
+//Simplifier holds one mesh as triangles over "wedges" (distinct vertices) that share "points" (distinct positions):
+
+struct Simplifier {
+	std::vector< Vertex > wedges;
+	std::vector< uint32_t > wedge_point; //point of each wedge
+	std::vector< glm::vec3 > points;
+	std::vector< Quadric > quadrics; //per point
+	std::vector< glm::uvec3 > triangles; //wedge indices
+	std::vector< bool > alive; //per triangle
+	uint32_t live = 0; //count of alive triangles
+	bool flat = false; //was every triangle flat-shaded? (if so, output normals are face normals)
+
+	explicit Simplifier(std::vector< Vertex > const &triangle_list);
+
+	//collapse edges until at most 'target' triangles are left (or the next collapse would cost more than
+	// 'max_error', as a mean squared distance):
+	void simplify(uint32_t target, double max_error);
+
+	//current triangles as a triangle list:
+	std::vector< Vertex > triangle_list() const;
+
+	//-- working space for simplify(), rebuilt each pass --
+	std::vector< std::vector< uint32_t > > point_triangles; //alive triangles around each point
+	struct Edge {
+		uint32_t count = 0; //triangles using the edge
+		uint32_t wedge_a = -1U, wedge_b = -1U; //wedges at its ends in the first triangle found
+		bool seam = false; //do triangles disagree about the wedges at its ends?
+	};
+	std::unordered_map< uint64_t, Edge > edges; //keyed by point pair (smaller first)
+	enum PointKind : uint8_t { Interior, Border, Seam, Locked };
+	std::vector< uint8_t > point_kinds; //bitmask of (1 << PointKind)
+	void build_adjacency();
+	bool try_collapse(uint32_t u, uint32_t v, std::vector< bool > *touched);
+
+	static uint64_t edge_key(uint32_t a, uint32_t b) {
+		if (a > b) std::swap(a, b);
+		return (uint64_t(a) << 32) | uint64_t(b);
+	}
+};
+
+Simplifier::Simplifier(std::vector< Vertex > const &triangle_list) {
+	//weld vertices into wedges, and identical positions into points:
+	// vertices with the same position, color, and UV are one wedge unless their normals differ by a hard crease,
+	// so seams are where colors, UVs, or creases change -- and flat or smooth shading alone doesn't lock anything
+	std::unordered_map< std::string, std::vector< uint32_t > > wedge_index;
+	std::unordered_map< std::string, uint32_t > point_index;
+	std::vector< glm::vec3 > normal_sums;
+	auto add_wedge = [&](Vertex const &v) -> uint32_t {
+		std::string key(reinterpret_cast< char const * >(&v.Position), sizeof(v.Position));
+		key.append(reinterpret_cast< char const * >(&v.Color), sizeof(v.Color));
+		key.append(reinterpret_cast< char const * >(&v.TexCoord), sizeof(v.TexCoord));
+		std::vector< uint32_t > &candidates = wedge_index[key];
+		for (uint32_t w : candidates) {
+			if (glm::dot(wedges[w].Normal, v.Normal) >= CreaseCos) {
+				normal_sums[w] += v.Normal;
+				return w;
+			}
+		}
+		auto p = point_index.emplace(std::string(reinterpret_cast< char const * >(&v.Position), sizeof(v.Position)), uint32_t(points.size()));
+		if (p.second) points.emplace_back(v.Position);
+		candidates.emplace_back(uint32_t(wedges.size()));
+		wedges.emplace_back(v);
+		wedge_point.emplace_back(p.first->second);
+		normal_sums.emplace_back(v.Normal);
+		return candidates.back();
+	};
+	flat = true;
+	for (size_t i = 0; i + 2 < triangle_list.size(); i += 3) {
+		Vertex const &a = triangle_list[i+0], &b = triangle_list[i+1], &c = triangle_list[i+2];
+		flat = flat && (a.Normal == b.Normal && b.Normal == c.Normal);
+		glm::uvec3 tri(add_wedge(a), add_wedge(b), add_wedge(c));
+		//(drop triangles that are already degenerate)
+		if (wedge_point[tri.x] == wedge_point[tri.y] || wedge_point[tri.y] == wedge_point[tri.z] || wedge_point[tri.z] == wedge_point[tri.x]) continue;
+		triangles.emplace_back(tri);
+	}
+	for (uint32_t w = 0; w < uint32_t(wedges.size()); ++w) {
+		if (glm::length(normal_sums[w]) > 0.0f) wedges[w].Normal = glm::normalize(normal_sums[w]);
+	}
+	alive.assign(triangles.size(), true);
+	live = uint32_t(triangles.size());
+
+	//face planes, weighted by area:
+	quadrics.assign(points.size(), Quadric());
+	for (auto const &tri : triangles) {
+		glm::vec3 const &a = points[wedge_point[tri.x]];
+		glm::vec3 const &b = points[wedge_point[tri.y]];
+		glm::vec3 const &c = points[wedge_point[tri.z]];
+		glm::vec3 n = glm::cross(b - a, c - a);
+		float len = glm::length(n);
+		if (len == 0.0f) continue;
+		n /= len;
+		Quadric q = Quadric::plane(n, -glm::dot(n, a), 0.5 * len);
+		quadrics[wedge_point[tri.x]] += q;
+		quadrics[wedge_point[tri.y]] += q;
+		quadrics[wedge_point[tri.z]] += q;
+	}
+
+	//planes through border and seam edges (perpendicular to the face), so those edges keep their shape:
+	build_adjacency();
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		glm::uvec3 const &tri = triangles[t];
+		glm::vec3 const &a = points[wedge_point[tri.x]];
+		glm::vec3 const &b = points[wedge_point[tri.y]];
+		glm::vec3 const &c = points[wedge_point[tri.z]];
+		glm::vec3 face_n = glm::cross(b - a, c - a);
+		if (glm::length(face_n) == 0.0f) continue;
+		face_n = glm::normalize(face_n);
+		for (uint32_t e = 0; e < 3; ++e) {
+			uint32_t p0 = wedge_point[tri[e]], p1 = wedge_point[tri[(e+1)%3]];
+			Edge const &edge = edges[edge_key(p0, p1)];
+			if (edge.count != 1 && !edge.seam) continue;
+			glm::vec3 along = points[p1] - points[p0];
+			float len = glm::length(along);
+			if (len == 0.0f) continue;
+			glm::vec3 n = glm::normalize(glm::cross(along / len, face_n));
+			//(seam edges get a plane from each side, so each side counts half)
+			double w = EdgeWeight * double(len) * len * (edge.count == 1 ? 1.0 : 0.5);
+			Quadric q = Quadric::plane(n, -glm::dot(n, points[p0]), w);
+			quadrics[p0] += q;
+			quadrics[p1] += q;
+		}
+	}
+}
+
+void Simplifier::build_adjacency() {
+	point_triangles.assign(points.size(), std::vector< uint32_t >());
+	edges.clear();
+	for (uint32_t t = 0; t < uint32_t(triangles.size()); ++t) {
+		if (!alive[t]) continue;
+		glm::uvec3 const &tri = triangles[t];
+		for (uint32_t c = 0; c < 3; ++c) {
+			point_triangles[wedge_point[tri[c]]].emplace_back(t);
+
+			uint32_t wa = tri[c], wb = tri[(c+1)%3];
+			if (wedge_point[wa] > wedge_point[wb]) std::swap(wa, wb);
+			Edge &edge = edges[edge_key(wedge_point[wa], wedge_point[wb])];
+			edge.count += 1;
+			if (edge.count == 1) {
+				edge.wedge_a = wa;
+				edge.wedge_b = wb;
+			} else if (edge.wedge_a != wa || edge.wedge_b != wb) {
+				edge.seam = true;
+			}
+		}
+	}
+
+	point_kinds.assign(points.size(), 0);
+	for (auto const &ke : edges) {
+		uint32_t a = uint32_t(ke.first >> 32), b = uint32_t(ke.first & 0xffffffff);
+		Edge const &edge = ke.second;
+		uint8_t kind = 0;
+		if (edge.count == 1) kind = (1 << Border);
+		else if (edge.count > 2) kind = (1 << Locked); //(non-manifold; leave it alone)
+		else if (edge.seam) kind = (1 << Seam);
+		point_kinds[a] |= kind;
+		point_kinds[b] |= kind;
+	}
+	//a seam may also end at a point (e.g., where a UV island comes to a corner), so check wedges directly, too:
+	for (uint32_t p = 0; p < uint32_t(points.size()); ++p) {
+		uint32_t first = -1U;
+		for (uint32_t t : point_triangles[p]) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t w = triangles[t][c];
+				if (wedge_point[w] != p) continue;
+				if (first == -1U) first = w;
+				else if (w != first) point_kinds[p] |= (1 << Seam);
+			}
+		}
+	}
+}
+
+bool Simplifier::try_collapse(uint32_t u, uint32_t v, std::vector< bool > *touched_) {
+	auto &touched = *touched_;
+
+	//each wedge of u moves to the wedge of v it shares a triangle with -- which must be exactly one:
+	std::unordered_map< uint32_t, uint32_t > wedge_map;
+	std::unordered_set< uint32_t > u_wedges;
+	uint32_t shared = 0; //triangles using edge u-v
+	for (uint32_t t : point_triangles[u]) {
+		glm::uvec3 const &tri = triangles[t];
+		uint32_t wu = -1U, wv = -1U;
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (wedge_point[tri[c]] == u) wu = tri[c];
+			if (wedge_point[tri[c]] == v) wv = tri[c];
+		}
+		assert(wu != -1U);
+		u_wedges.insert(wu);
+		if (wv == -1U) continue;
+		shared += 1;
+		auto m = wedge_map.emplace(wu, wv);
+		if (!m.second && m.first->second != wv) return false; //ambiguous: u's wedge sits on both sides of a seam through v
+	}
+	for (uint32_t wu : u_wedges) {
+		if (!wedge_map.count(wu)) return false; //part of u's surroundings has nothing of v's to move onto
+	}
+
+	//link condition: u and v should only share the neighbors across the triangles on their edge
+	// (otherwise the collapse pinches the surface into a non-manifold shape)
+	std::unordered_set< uint32_t > u_neighbors;
+	for (uint32_t t : point_triangles[u]) {
+		for (uint32_t c = 0; c < 3; ++c) u_neighbors.insert(wedge_point[triangles[t][c]]);
+	}
+	std::unordered_set< uint32_t > common;
+	for (uint32_t t : point_triangles[v]) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t p = wedge_point[triangles[t][c]];
+			if (p != u && p != v && u_neighbors.count(p)) common.insert(p);
+		}
+	}
+	if (common.size() != shared) return false;
+
+	//don't flip (or badly turn, or squash) the triangles that stay:
+	glm::vec3 const &to = points[v];
+	for (uint32_t t : point_triangles[u]) {
+		glm::uvec3 const &tri = triangles[t];
+		glm::vec3 p[3], q[3];
+		bool has_v = false;
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t pt = wedge_point[tri[c]];
+			has_v = has_v || (pt == v);
+			p[c] = points[pt];
+			q[c] = (pt == u ? to : p[c]);
+		}
+		if (has_v) continue; //(removed by the collapse)
+		glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+		glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+		float before_len = glm::length(before), after_len = glm::length(after);
+		if (after_len <= 1e-12f) return false;
+		if (before_len > 0.0f && glm::dot(before, after) < MaxTurnCos * before_len * after_len) return false;
+	}
+
+	//collapse:
+	for (uint32_t t : point_triangles[u]) {
+		glm::uvec3 &tri = triangles[t];
+		bool has_v = false;
+		for (uint32_t c = 0; c < 3; ++c) {
+			touched[wedge_point[tri[c]]] = true;
+			has_v = has_v || (wedge_point[tri[c]] == v);
+		}
+		if (has_v) {
+			alive[t] = false;
+			live -= 1;
+			continue;
+		}
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (wedge_point[tri[c]] == u) tri[c] = wedge_map[tri[c]];
+		}
+	}
+	quadrics[v] += quadrics[u];
+	touched[v] = true;
+	return true;
+}
+
+void Simplifier::simplify(uint32_t target, double max_error) {
+	//collapse in passes: each pass collapses the cheapest edges whose neighborhoods haven't changed yet this pass
+	while (live > target) {
+		build_adjacency();
+
+		struct Candidate {
+			double cost;
+			uint32_t from, to;
+		};
+		std::vector< Candidate > candidates;
+		candidates.reserve(edges.size());
+
+		//can point 'from' move onto point 'to' along an edge like 'edge'?
+		auto allowed = [&](uint32_t from, Edge const &edge) {
+			uint8_t kind = point_kinds[from];
+			if (kind & (1 << Locked)) return false;
+			if ((kind & (1 << Border)) && edge.count != 1) return false; //borders only collapse along the border
+			if ((kind & (1 << Seam)) && !edge.seam) return false; //seams only collapse along the seam
+			return true;
+		};
+
+		for (auto const &ke : edges) {
+			uint32_t a = uint32_t(ke.first >> 32), b = uint32_t(ke.first & 0xffffffff);
+			Edge const &edge = ke.second;
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+			double mean = (q.weight > 0.0 ? 1.0 / q.weight : 0.0);
+			if (allowed(a, edge)) candidates.emplace_back(Candidate{ q.error(points[b]) * mean, a, b });
+			if (allowed(b, edge)) candidates.emplace_back(Candidate{ q.error(points[a]) * mean, b, a });
+		}
+		std::sort(candidates.begin(), candidates.end(), [](Candidate const &x, Candidate const &y) {
+			if (x.cost != y.cost) return x.cost < y.cost;
+			if (x.from != y.from) return x.from < y.from;
+			return x.to < y.to;
+		});
+
+		std::vector< bool > touched(points.size(), false);
+		uint32_t collapsed = 0;
+		//(only collapse the cheaper half in each pass, so later collapses still see mostly fresh costs)
+		uint32_t pass_limit = std::max(1U, (live - target) / 2);
+		for (auto const &candidate : candidates) {
+			if (live <= target || collapsed >= pass_limit) break;
+			if (candidate.cost > max_error) break;
+			if (touched[candidate.from] || touched[candidate.to]) continue;
+			if (try_collapse(candidate.from, candidate.to, &touched)) collapsed += 1;
+		}
+		if (collapsed == 0) break;
+	}
+}
+
+std::vector< Vertex > Simplifier::triangle_list() const {
+	std::vector< Vertex > list;
+	list.reserve(live * 3);
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		if (!alive[t]) continue;
+		list.emplace_back(wedges[triangles[t].x]);
+		list.emplace_back(wedges[triangles[t].y]);
+		list.emplace_back(wedges[triangles[t].z]);
+		if (flat) { //(keep flat-shaded meshes flat-shaded)
+			Vertex *tri = &list[list.size() - 3];
+			glm::vec3 n = glm::cross(tri[1].Position - tri[0].Position, tri[2].Position - tri[0].Position);
+			if (glm::length(n) > 0.0f) n = glm::normalize(n);
+			tri[0].Normal = tri[1].Normal = tri[2].Normal = n;
+		}
+	}
+	return list;
+}
+
+//---------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::string in_file, out_file;
+	uint32_t levels = 3;
+	float ratio = 0.5f;
+	float error = 0.02f;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--levels" && argi + 1 < argc) {
+			levels = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--ratio" && argi + 1 < argc) {
+			ratio = std::stof(argv[++argi]);
+		} else if (arg == "--error" && argi + 1 < argc) {
+			error = std::stof(argv[++argi]);
+		} else if (in_file == "") {
+			in_file = arg;
+		} else if (out_file == "") {
+			out_file = arg;
+		} else {
+			in_file = "";
+			break;
+		}
+	}
+	if (in_file == "" || out_file == "" || !(ratio > 0.0f && ratio < 1.0f) || !(error > 0.0f)) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <in.pnct> <out.pnct> [--levels N] [--ratio R] [--error E]\n"
+			"Adds up to N (default 3) levels of detail to each mesh, each with about R (default 0.5) times the\n"
+			"triangles of the last, moving the surface by at most about E (default 0.02) times the mesh's size." << std::endl;
+		return 1;
+	}
+
+	//read (indexed files are expanded into triangle lists, since the simplifier welds things its own way):
+	PnctFile pnct;
+	read_pnct(in_file, &pnct);
+	if (pnct.quantized) {
+		throw std::runtime_error("'" + in_file + "' is quantized; simplify meshes before quantizing them.");
+	}
+	bool write_indexed = pnct.indexed();
+	pnct.expand();
+	std::vector< Vertex > const &data = pnct.vertices;
+
+	//simplify each mesh, appending its levels after the existing vertex data:
+	PnctFile out;
+	std::vector< Vertex > &out_data = out.vertices;
+	out_data = data;
+	auto add_entry = [&](std::string const &name, uint32_t begin, uint32_t end) {
+		out.meshes.emplace_back();
+		out.meshes.back().name = name;
+		out.meshes.back().vertex_begin = begin;
+		out.meshes.back().vertex_end = end;
+	};
+
+	uint32_t total_before = 0, total_after = 0;
+	for (auto const &entry : pnct.meshes) {
+		std::string const &name = entry.name;
+		uint32_t triangles = (entry.vertex_end - entry.vertex_begin) / 3;
+
+		//already has levels of detail (or too small to bother)? copy as-is:
+		if (name.find(".LOD") != std::string::npos || triangles < MinTriangles) {
+			add_entry(name, entry.vertex_begin, entry.vertex_end);
+			continue;
+		}
+
+		std::vector< Vertex > mesh(data.begin() + entry.vertex_begin, data.begin() + entry.vertex_end);
+		glm::vec3 min = glm::vec3(std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+		for (auto const &v : mesh) {
+			min = glm::min(min, v.Position);
+			max = glm::max(max, v.Position);
+		}
+		double diagonal = glm::length(max - min);
+
+		add_entry(name + ".LOD0", entry.vertex_begin, entry.vertex_end);
+		std::cout << name << ": " << triangles;
+
+		Simplifier simplifier(mesh);
+		uint32_t previous = simplifier.live;
+		uint32_t coarsest = triangles;
+		double level_error = error;
+		for (uint32_t level = 1; level <= levels; ++level) {
+			uint32_t target = uint32_t(previous * ratio);
+			simplifier.simplify(target, (level_error * diagonal) * (level_error * diagonal));
+			level_error *= 2.0;
+			if (simplifier.live > previous * MinReduction) break;
+			previous = simplifier.live;
+
+			std::vector< Vertex > list = simplifier.triangle_list();
+			uint32_t begin = uint32_t(out_data.size());
+			out_data.insert(out_data.end(), list.begin(), list.end());
+			add_entry(name + ".LOD" + std::to_string(level), begin, uint32_t(out_data.size()));
+			std::cout << " -> " << simplifier.live;
+			coarsest = simplifier.live;
+		}
+		std::cout << " triangles" << std::endl;
+		total_before += triangles;
+		total_after += coarsest;
+	}
+	std::cout << "Simplified " << total_before << " triangles to " << total_after << " at the coarsest levels." << std::endl;
+
+	//write (indexed files are welded again, indexing from each mesh's first vertex):
+	if (write_indexed) {
+		size_t corners = out_data.size();
+		out.weld();
+		std::cout << "Welded " << corners << " triangle corners to " << out_data.size() << " vertices." << std::endl;
+	}
+	write_pnct(out_file, out);
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}